@@ -0,0 +1,198 @@
+#ifndef PCM_ADPCM_HPP_
+#define PCM_ADPCM_HPP_     1   /* Version 1 */
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+
+// IMA ADPCM as stored in wave files (WAVE_FORMAT_IMA_ADPCM, 0x0011).
+// A block of c channels starts with a header per channel
+//   { int16_t sample; uint8_t step_index; uint8_t reserved; }
+// whose sample is the first frame. Then come groups of 8 samples, 4 bytes
+// per channel in channel order, low nibble first. The state of a channel
+// is reset by every block header, so the blocks decode independently.
+
+#define PCM_ADPCM_BATCH     64      // blocks coded in parallel
+
+static constexpr int16_t pcm_ima_steps[89] =
+{
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17,
+    19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118,
+    130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+    337, 371, 408, 449, 494, 544, 598, 658, 724, 796,
+    876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+    2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358,
+    5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+static constexpr int8_t pcm_ima_index_delta[16] =
+{
+    -1, -1, -1, -1, 2, 4, 6, 8,
+    -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+struct PcmImaState
+{
+    int predictor;      // the last sample
+    int index;          // into pcm_ima_steps
+};
+
+// the usual block sizes: 256 bytes per channel up to 11 kHz, 512 up to
+// 22 kHz and 1024 above
+inline size_t pcm_ima_block_align(int channels, uint32_t rate)
+{
+    size_t size = (rate <= 11025) ? 256 : (rate <= 22050) ? 512 : 1024;
+    return size * channels;
+}
+
+// the frames of a block of size bytes, which may be a short last block
+inline size_t pcm_ima_block_units(size_t size, int channels)
+{
+    size_t head = 4 * size_t(channels);
+    if (size < head)
+        return 0;
+    return 1 + (size - head) / head * 8;
+}
+
+inline int pcm_ima_decode_nibble(PcmImaState& state, int nibble)
+{
+    int step = pcm_ima_steps[state.index];
+    int diff = step >> 3;
+    if (nibble & 1)
+        diff += step >> 2;
+    if (nibble & 2)
+        diff += step >> 1;
+    if (nibble & 4)
+        diff += step;
+
+    int value = (nibble & 8) ? state.predictor - diff : state.predictor + diff;
+    if (value < -32768)
+        value = -32768;
+    if (value > 32767)
+        value = 32767;
+    state.predictor = value;
+
+    int index = state.index + pcm_ima_index_delta[nibble];
+    state.index = (index < 0) ? 0 : (index > 88) ? 88 : index;
+    return value;
+}
+
+inline int pcm_ima_encode_sample(PcmImaState& state, int sample)
+{
+    int step = pcm_ima_steps[state.index];
+    int diff = sample - state.predictor;
+    int nibble = 0;
+    if (diff < 0)
+    {
+        nibble = 8;
+        diff = -diff;
+    }
+    for (int bit = 4; bit; bit >>= 1)
+    {
+        if (diff >= step)
+        {
+            nibble |= bit;
+            diff -= step;
+        }
+        step >>= 1;
+    }
+
+    // the encoder tracks what the decoder will see
+    pcm_ima_decode_nibble(state, nibble);
+    return nibble;
+}
+
+// The first step index of a block, from the size of its first differences.
+// The encoder of each block starts afresh, so blocks can be encoded in any
+// order.
+inline int pcm_ima_initial_index(const int16_t *pcm, size_t frames, int channels)
+{
+    size_t n = (frames < 9) ? frames : 9;
+    long sum = 0;
+    for (size_t i = 1; i < n; ++i)
+        sum += std::labs(long(pcm[i * channels]) - pcm[(i - 1) * channels]);
+    long mean = (n > 1) ? sum / long(n - 1) : 0;
+
+    int index = 0;
+    while (index < 88 && pcm_ima_steps[index] < mean)
+        ++index;
+    return index;
+}
+
+// Encodes frames (<= pcm_ima_block_units(size, channels)) of interleaved
+// samples into a block of size bytes. The rest is padded with the last frame.
+inline void pcm_ima_encode_block(const int16_t *pcm, size_t frames, int channels,
+                                 uint8_t *block, size_t size)
+{
+    const size_t units = pcm_ima_block_units(size, channels);
+    if (frames == 0)
+        return;
+
+    for (int ch = 0; ch < channels; ++ch)
+    {
+        PcmImaState state;
+        state.predictor = pcm[ch];
+        state.index = pcm_ima_initial_index(pcm + ch, frames, channels);
+
+        uint8_t *head = block + 4 * ch;
+        head[0] = uint8_t(state.predictor & 0xFF);
+        head[1] = uint8_t((state.predictor >> 8) & 0xFF);
+        head[2] = uint8_t(state.index);
+        head[3] = 0;
+
+        // frame 1 + 8 * group + k is in byte k / 2 of the channel's 4 bytes
+        for (size_t group = 0; 1 + group * 8 < units; ++group)
+        {
+            uint8_t *dest = block + 4 * channels * (group + 1) + 4 * ch;
+            for (int k = 0; k < 8; ++k)
+            {
+                size_t i = 1 + group * 8 + k;
+                if (i >= frames)
+                    i = frames - 1;
+                int nibble = pcm_ima_encode_sample(state, pcm[i * channels + ch]);
+                if (k & 1)
+                    dest[k / 2] |= uint8_t(nibble << 4);
+                else
+                    dest[k / 2] = uint8_t(nibble);
+            }
+        }
+    }
+}
+
+// decodes frames (<= pcm_ima_block_units(size, channels)) of a block
+inline bool pcm_ima_decode_block(const uint8_t *block, size_t size, int channels,
+                                 int16_t *pcm, size_t frames)
+{
+    if (frames == 0)
+        return true;
+    if (frames > pcm_ima_block_units(size, channels))
+        return false;
+
+    for (int ch = 0; ch < channels; ++ch)
+    {
+        const uint8_t *head = block + 4 * ch;
+        PcmImaState state;
+        state.predictor = int16_t(head[0] | (head[1] << 8));
+        state.index = head[2];
+        if (state.index > 88)
+            return false;
+
+        pcm[ch] = int16_t(state.predictor);
+        for (size_t group = 0; 1 + group * 8 < frames; ++group)
+        {
+            const uint8_t *src = block + 4 * channels * (group + 1) + 4 * ch;
+            size_t base = 1 + group * 8;
+            size_t count = (frames - base < 8) ? frames - base : 8;
+            for (size_t k = 0; k < count; ++k)
+            {
+                int nibble = (k & 1) ? (src[k / 2] >> 4) : (src[k / 2] & 0x0F);
+                pcm[(base + k) * channels + ch] = int16_t(pcm_ima_decode_nibble(state, nibble));
+            }
+        }
+    }
+    return true;
+}
+
+#endif  // ndef PCM_ADPCM_HPP_
@@ -0,0 +1,178 @@
+#ifndef PCM_FFT_HPP_
+#define PCM_FFT_HPP_     1   /* Version 1 */
+
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <complex>
+#include <vector>
+#include <cassert>
+
+// Real-input FFT of a power-of-two size n. It runs an n/2-point complex
+// radix-2 FFT on the even/odd samples packed as (re, im) and splits the
+// result into the n/2 + 1 bins of the real spectrum. Twiddles are
+// precomputed, and each stage reads its own contiguous slice of the table.
+// A PcmRealFft is immutable after construction and can be shared by threads.
+class PcmRealFft
+{
+public:
+    typedef std::complex<float> complex_type;
+
+    explicit PcmRealFft(size_t n);
+
+    size_t size() const { return m_n; }
+    size_t num_bins() const { return m_half + 1; }
+
+    // n reals --> n/2 + 1 bins. out is also the work area.
+    void forward(const float *in, complex_type *out) const;
+    // n/2 + 1 bins --> n reals; inverse(forward(x)) == x. work needs n/2 items.
+    void inverse(const complex_type *in, float *out, complex_type *work) const;
+
+    static bool is_valid_size(size_t n)
+    {
+        return n >= 4 && (n & (n - 1)) == 0;
+    }
+
+protected:
+    size_t m_n;
+    size_t m_half;
+    std::vector<uint32_t> m_rev;                // bit reversal of n/2
+    std::vector<complex_type> m_twiddles;       // stage len at [len/2 - 1]
+    std::vector<complex_type> m_split;          // exp(-2 pi i k / n)
+
+    void transform(complex_type *data) const;   // in-place, forward
+};
+
+inline PcmRealFft::complex_type
+pcm_fft_mul(const PcmRealFft::complex_type& a, const PcmRealFft::complex_type& b)
+{
+    // std::complex multiplication checks for NaN; this does not
+    return PcmRealFft::complex_type(a.real() * b.real() - a.imag() * b.imag(),
+                                    a.real() * b.imag() + a.imag() * b.real());
+}
+
+inline PcmRealFft::PcmRealFft(size_t n) : m_n(n), m_half(n / 2)
+{
+    assert(is_valid_size(n));
+    const double pi = 3.14159265358979323846;
+
+    int bits = 0;
+    while ((size_t(1) << bits) < m_half)
+        ++bits;
+
+    m_rev.resize(m_half);
+    for (size_t i = 0; i < m_half; ++i)
+    {
+        uint32_t r = 0;
+        for (int b = 0; b < bits; ++b)
+        {
+            if (i & (size_t(1) << b))
+                r |= uint32_t(1) << (bits - 1 - b);
+        }
+        m_rev[i] = r;
+    }
+
+    m_twiddles.resize(m_half ? m_half - 1 : 0);
+    for (size_t len = 2; len <= m_half; len *= 2)
+    {
+        complex_type *w = &m_twiddles[len / 2 - 1];
+        for (size_t j = 0; j < len / 2; ++j)
+        {
+            double a = -2 * pi * double(j) / double(len);
+            w[j] = complex_type(float(std::cos(a)), float(std::sin(a)));
+        }
+    }
+
+    m_split.resize(m_half);
+    for (size_t k = 0; k < m_half; ++k)
+    {
+        double a = -2 * pi * double(k) / double(n);
+        m_split[k] = complex_type(float(std::cos(a)), float(std::sin(a)));
+    }
+}
+
+inline void PcmRealFft::transform(complex_type *data) const
+{
+    for (size_t i = 0; i < m_half; ++i)
+    {
+        size_t r = m_rev[i];
+        if (i < r)
+            std::swap(data[i], data[r]);
+    }
+
+    for (size_t len = 2; len <= m_half; len *= 2)
+    {
+        const size_t h = len / 2;
+        const complex_type *w = &m_twiddles[h - 1];
+        for (size_t i = 0; i < m_half; i += len)
+        {
+            complex_type *a = data + i;
+            complex_type *b = a + h;
+            for (size_t j = 0; j < h; ++j)
+            {
+                complex_type t = pcm_fft_mul(b[j], w[j]);
+                b[j] = a[j] - t;
+                a[j] += t;
+            }
+        }
+    }
+}
+
+inline void PcmRealFft::forward(const float *in, complex_type *out) const
+{
+    for (size_t i = 0; i < m_half; ++i)
+    {
+        out[i] = complex_type(in[2 * i], in[2 * i + 1]);
+    }
+
+    transform(out);
+
+    // X[k] = Fe[k] + W^k Fo[k], with Fe/Fo from Z[k] and conj(Z[M - k])
+    complex_type z0 = out[0];
+    out[0] = complex_type(z0.real() + z0.imag(), 0);
+    out[m_half] = complex_type(z0.real() - z0.imag(), 0);
+    for (size_t k = 1; k <= m_half / 2; ++k)
+    {
+        size_t m = m_half - k;
+        complex_type zk = out[k], zm = std::conj(out[m]);
+
+        complex_type fe = (zk + zm) * 0.5f;
+        complex_type fo = pcm_fft_mul(zk - zm, complex_type(0, -0.5f));
+        complex_type xk = fe + pcm_fft_mul(m_split[k], fo);
+
+        // the mirrored bin, from conj(Z[k]) and Z[M - k]
+        complex_type fe2 = std::conj(fe);
+        complex_type fo2 = std::conj(fo);
+        complex_type xm = fe2 + pcm_fft_mul(m_split[m], fo2);
+
+        out[k] = xk;
+        out[m] = xm;
+    }
+}
+
+inline void
+PcmRealFft::inverse(const complex_type *in, float *out, complex_type *work) const
+{
+    // Z[k] = Fe[k] + i Fo[k]; Fe = (X[k] + conj(X[M - k])) / 2,
+    // Fo = (X[k] - conj(X[M - k])) / (2 W^k)
+    for (size_t k = 0; k < m_half; ++k)
+    {
+        complex_type xk = in[k], xm = std::conj(in[m_half - k]);
+        complex_type fe = (xk + xm) * 0.5f;
+        complex_type fo = pcm_fft_mul((xk - xm) * 0.5f, std::conj(m_split[k]));
+        // conjugate for the inverse by the forward transform
+        work[k] = std::conj(fe + pcm_fft_mul(complex_type(0, 1), fo));
+    }
+
+    transform(work);
+
+    const float scale = 1.0f / float(m_half);
+    for (size_t i = 0; i < m_half; ++i)
+    {
+        complex_type z = std::conj(work[i]) * scale;
+        out[2 * i] = z.real();
+        out[2 * i + 1] = z.imag();
+    }
+}
+
+#endif  // ndef PCM_FFT_HPP_
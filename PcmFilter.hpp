@@ -0,0 +1,539 @@
+#ifndef PCM_FILTER_HPP_
+#define PCM_FILTER_HPP_     1   /* Version 1 */
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <memory>
+#include "PcmFft.hpp"
+#include "PcmSimd.hpp"
+
+// Filters of one channel of float samples. They work in place, block by
+// block, and keep their state from one block to the next, so a stream can
+// be cut into blocks of any sizes and gives the same output.
+//
+// FIR kernels up to PCM_FILTER_FFT_TAPS taps are run directly, with an SSE2
+// dot product; longer ones by FFT overlap-add, with the FFT size at least
+// PCM_FILTER_FFT_FACTOR times the kernel. Both give the causal convolution,
+// with no latency of their own. IIR filters are cascades of biquads.
+
+#define PCM_FILTER_FFT_TAPS         96              // direct FIR up to this (measured crossover)
+#define PCM_FILTER_FFT_FACTOR       4               // FFT size per kernel size
+#define PCM_FILTER_MAX_TAPS         (1024 * 1024)
+#define PCM_FILTER_DEFAULT_TAPS     511             // of the designed FIR kernels
+#define PCM_FILTER_DEFAULT_ORDER    4               // of the Butterworth filters
+#define PCM_FILTER_MAX_ORDER        16
+#define PCM_FILTER_DCBLOCK_HZ       10.0            // default corner of dcblock
+
+class PcmFilter
+{
+public:
+    virtual ~PcmFilter() { }
+    virtual PcmFilter *clone() const = 0;
+
+    virtual void process(float *data, size_t count) = 0;
+    virtual void reset() = 0;
+
+    // the delay of a linear-phase filter, in samples; zero for the others
+    virtual size_t delay() const
+    {
+        return 0;
+    }
+};
+
+// sum of a[i] * b[i]; n is a multiple of 4
+inline float pcm_filter_dot(const float *a, const float *b, size_t n)
+{
+#ifdef PCM_SIMD_SSE2
+    __m128 s0 = _mm_setzero_ps(), s1 = _mm_setzero_ps();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        s0 = _mm_add_ps(s0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        s1 = _mm_add_ps(s1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+    }
+    if (i < n)
+        s0 = _mm_add_ps(s0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+    float sum[4];
+    _mm_storeu_ps(sum, _mm_add_ps(s0, s1));
+    return (sum[0] + sum[2]) + (sum[1] + sum[3]);
+#else
+    float sum = 0;
+    for (size_t i = 0; i < n; ++i)
+        sum += a[i] * b[i];
+    return sum;
+#endif
+}
+
+// direct-form FIR: y[n] = sum h[k] x[n - k]
+class PcmFirFilter : public PcmFilter
+{
+public:
+    PcmFirFilter(const std::vector<float>& taps, size_t delay = 0)
+        : m_taps(taps.size()), m_delay(delay)
+    {
+        // reversed and padded with zeros to a multiple of 4
+        m_reversed.assign((m_taps + 3) & ~size_t(3), 0.0f);
+        for (size_t k = 0; k < m_taps; ++k)
+            m_reversed[k] = taps[m_taps - 1 - k];
+        reset();
+    }
+
+    PcmFilter *clone() const
+    {
+        return new PcmFirFilter(*this);
+    }
+
+    void reset()
+    {
+        m_history.assign(m_taps - 1, 0.0f);
+    }
+
+    void process(float *data, size_t count)
+    {
+        // the history, the block and the padding, in a row
+        const size_t keep = m_taps - 1;
+        m_work.resize(keep + count + (m_reversed.size() - m_taps));
+        std::copy(m_history.begin(), m_history.end(), m_work.begin());
+        std::copy(data, data + count, m_work.begin() + keep);
+        std::fill(m_work.begin() + keep + count, m_work.end(), 0.0f);
+
+        for (size_t n = 0; n < count; ++n)
+            data[n] = pcm_filter_dot(&m_reversed[0], &m_work[n], m_reversed.size());
+
+        std::copy(m_work.begin() + count, m_work.begin() + count + keep, m_history.begin());
+    }
+
+    size_t delay() const
+    {
+        return m_delay;
+    }
+
+protected:
+    size_t m_taps;
+    size_t m_delay;
+    std::vector<float> m_reversed;
+    std::vector<float> m_history;   // the last m_taps - 1 inputs
+    std::vector<float> m_work;
+};
+
+// FIR by FFT overlap-add. Each segment of at most n - taps + 1 samples is
+// convolved by the FFT, and the tail of the result is added to the next.
+class PcmFftFilter : public PcmFilter
+{
+public:
+    PcmFftFilter(const std::vector<float>& taps, size_t delay = 0)
+        : m_taps(taps.size()), m_delay(delay), m_fft(fft_size(taps.size()))
+    {
+        const size_t n = m_fft.size();
+        m_segment = n - m_taps + 1;
+        m_buffer.assign(n, 0.0f);
+        std::copy(taps.begin(), taps.end(), m_buffer.begin());
+        m_kernel.resize(m_fft.num_bins());
+        m_fft.forward(&m_buffer[0], &m_kernel[0]);
+        m_bins.resize(m_fft.num_bins());
+        m_work.resize(n / 2);
+        reset();
+    }
+
+    PcmFilter *clone() const
+    {
+        return new PcmFftFilter(*this);
+    }
+
+    void reset()
+    {
+        m_overlap.assign(m_taps - 1, 0.0f);
+    }
+
+    void process(float *data, size_t count)
+    {
+        const size_t keep = m_taps - 1;
+        for (size_t pos = 0; pos < count; )
+        {
+            size_t m = (count - pos < m_segment) ? count - pos : m_segment;
+            std::copy(data + pos, data + pos + m, m_buffer.begin());
+            std::fill(m_buffer.begin() + m, m_buffer.end(), 0.0f);
+            m_fft.forward(&m_buffer[0], &m_bins[0]);
+            for (size_t k = 0; k < m_bins.size(); ++k)
+                m_bins[k] = pcm_fft_mul(m_bins[k], m_kernel[k]);
+            m_fft.inverse(&m_bins[0], &m_buffer[0], &m_work[0]);
+
+            for (size_t i = 0; i < m; ++i)
+                data[pos + i] = m_buffer[i] + (i < keep ? m_overlap[i] : 0.0f);
+            // ascending, as m_overlap[m + j] is read before it is written
+            for (size_t j = 0; j < keep; ++j)
+                m_overlap[j] = m_buffer[m + j] + (m + j < keep ? m_overlap[m + j] : 0.0f);
+            pos += m;
+        }
+    }
+
+    size_t delay() const
+    {
+        return m_delay;
+    }
+
+    static size_t fft_size(size_t taps)
+    {
+        size_t n = 4;
+        while (n < taps * PCM_FILTER_FFT_FACTOR)
+            n *= 2;
+        return n;
+    }
+
+protected:
+    size_t m_taps;
+    size_t m_delay;
+    PcmRealFft m_fft;
+    size_t m_segment;                               // inputs per FFT
+    std::vector<PcmRealFft::complex_type> m_kernel; // the spectrum of the taps
+    std::vector<PcmRealFft::complex_type> m_bins;
+    std::vector<PcmRealFft::complex_type> m_work;
+    std::vector<float> m_buffer;
+    std::vector<float> m_overlap;                   // the tail for the next samples
+};
+
+// the FIR filter for the kernel: direct if short, FFT otherwise
+inline PcmFilter *pcm_filter_fir(const std::vector<float>& taps, size_t delay = 0)
+{
+    if (taps.size() <= PCM_FILTER_FFT_TAPS)
+        return new PcmFirFilter(taps, delay);
+    return new PcmFftFilter(taps, delay);
+}
+
+// y = b0 x + b1 x[-1] + b2 x[-2] - a1 y[-1] - a2 y[-2]
+struct PcmBiquad
+{
+    double b0, b1, b2, a1, a2;
+};
+
+// a cascade of biquads in transposed direct form II, with double state
+class PcmIirFilter : public PcmFilter
+{
+public:
+    PcmFilter *clone() const
+    {
+        return new PcmIirFilter(*this);
+    }
+
+    void add(const PcmBiquad& section)
+    {
+        m_sections.push_back(section);
+        m_state.push_back(0.0);
+        m_state.push_back(0.0);
+    }
+
+    void reset()
+    {
+        std::fill(m_state.begin(), m_state.end(), 0.0);
+    }
+
+    void process(float *data, size_t count)
+    {
+        for (size_t s = 0; s < m_sections.size(); ++s)
+        {
+            const PcmBiquad& q = m_sections[s];
+            double z1 = m_state[2 * s], z2 = m_state[2 * s + 1];
+            for (size_t i = 0; i < count; ++i)
+            {
+                double x = data[i];
+                double y = q.b0 * x + z1;
+                z1 = q.b1 * x - q.a1 * y + z2;
+                z2 = q.b2 * x - q.a2 * y;
+                data[i] = float(y);
+            }
+            m_state[2 * s] = z1;
+            m_state[2 * s + 1] = z2;
+        }
+    }
+
+protected:
+    std::vector<PcmBiquad> m_sections;
+    std::vector<double> m_state;    // z1, z2 of each section
+};
+
+// Design. Frequencies are fractions of the sampling rate, below 0.5.
+
+// windowed-sinc lowpass (Blackman window), unity gain at DC; taps is odd
+inline void pcm_filter_design_lowpass(double cutoff, size_t taps, std::vector<float>& h)
+{
+    const double pi = 3.14159265358979323846;
+    const double mid = double(taps - 1) / 2;
+    std::vector<double> d(taps);
+    double sum = 0;
+    for (size_t n = 0; n < taps; ++n)
+    {
+        double t = double(n) - mid;
+        double sinc = (t == 0) ? 2 * cutoff : std::sin(2 * pi * cutoff * t) / (pi * t);
+        double w = 0.42 - 0.5 * std::cos(2 * pi * n / (taps - 1)) +
+                   0.08 * std::cos(4 * pi * n / (taps - 1));
+        d[n] = sinc * w;
+        sum += d[n];
+    }
+    h.resize(taps);
+    for (size_t n = 0; n < taps; ++n)
+        h[n] = float(d[n] / sum);
+}
+
+// a delta minus the lowpass
+inline void pcm_filter_design_highpass(double cutoff, size_t taps, std::vector<float>& h)
+{
+    pcm_filter_design_lowpass(cutoff, taps, h);
+    for (auto& value : h)
+        value = -value;
+    h[taps / 2] += 1.0f;
+}
+
+// the difference of two lowpasses
+inline void pcm_filter_design_bandpass(double low, double high, size_t taps, std::vector<float>& h)
+{
+    std::vector<float> lp;
+    pcm_filter_design_lowpass(low, taps, lp);
+    pcm_filter_design_lowpass(high, taps, h);
+    for (size_t n = 0; n < taps; ++n)
+        h[n] -= lp[n];
+}
+
+// Butterworth of an even order, as order / 2 biquads (RBJ cookbook forms)
+inline void pcm_filter_design_butterworth(PcmIirFilter& filter, double cutoff, int order,
+                                          bool highpass)
+{
+    const double pi = 3.14159265358979323846;
+    const double w0 = 2 * pi * cutoff, cw = std::cos(w0), sw = std::sin(w0);
+    for (int k = 0; k < order / 2; ++k)
+    {
+        double q = 1 / (2 * std::cos(pi * (2 * k + 1) / (2 * order)));
+        double alpha = sw / (2 * q), a0 = 1 + alpha;
+        PcmBiquad s;
+        s.b0 = (highpass ? (1 + cw) : (1 - cw)) / 2 / a0;
+        s.b1 = (highpass ? -(1 + cw) : (1 - cw)) / a0;
+        s.b2 = s.b0;
+        s.a1 = -2 * cw / a0;
+        s.a2 = (1 - alpha) / a0;
+        filter.add(s);
+    }
+}
+
+// y = x - x[-1] + r y[-1]
+inline void pcm_filter_design_dcblock(PcmIirFilter& filter, double cutoff)
+{
+    const double pi = 3.14159265358979323846;
+    PcmBiquad s = { 1, -1, 0, -std::exp(-2 * pi * cutoff), 0 };
+    filter.add(s);
+}
+
+// A series of filters for one channel, given by a spec of filters joined
+// by '+'. Frequencies are in Hz:
+//   lowpass:F[:TAPS]  highpass:F[:TAPS]  bandpass:F1:F2[:TAPS]
+//       linear-phase FIR, TAPS odd (PCM_FILTER_DEFAULT_TAPS)
+//   iir-lowpass:F[:ORDER]  iir-highpass:F[:ORDER]  iir-bandpass:F1:F2[:ORDER]
+//       Butterworth biquads, ORDER even (PCM_FILTER_DEFAULT_ORDER)
+//   dcblock[:F]     one-pole DC blocker (PCM_FILTER_DCBLOCK_HZ)
+//   fir:FILE        FIR with the taps in a text file; FILE is the rest of
+//                   the item, ':' and all
+class PcmFilterChain
+{
+public:
+    PcmFilterChain() { }
+
+    PcmFilterChain(const PcmFilterChain& other)
+    {
+        *this = other;
+    }
+
+    PcmFilterChain& operator=(const PcmFilterChain& other)
+    {
+        m_filters.clear();
+        for (auto& filter : other.m_filters)
+            m_filters.emplace_back(filter->clone());
+        return *this;
+    }
+
+    bool parse(const char *spec, uint32_t rate)
+    {
+        m_filters.clear();
+        std::string text = spec;
+        size_t pos = 0;
+        do
+        {
+            size_t plus = text.find('+', pos);
+            if (plus == std::string::npos)
+                plus = text.size();
+            if (!parse_one(text.substr(pos, plus - pos), rate))
+            {
+                m_filters.clear();
+                return false;
+            }
+            pos = plus + 1;
+        } while (pos <= text.size());
+        return true;
+    }
+
+    void add(PcmFilter *filter)
+    {
+        m_filters.emplace_back(filter);
+    }
+
+    bool empty() const
+    {
+        return m_filters.empty();
+    }
+
+    void process(float *data, size_t count)
+    {
+        for (auto& filter : m_filters)
+            filter->process(data, count);
+    }
+
+    void reset()
+    {
+        for (auto& filter : m_filters)
+            filter->reset();
+    }
+
+    size_t delay() const
+    {
+        size_t sum = 0;
+        for (auto& filter : m_filters)
+            sum += filter->delay();
+        return sum;
+    }
+
+    // the files of the fir:FILE items of spec
+    static void files(const char *spec, std::vector<std::string>& files)
+    {
+        std::string text = spec;
+        size_t pos = 0;
+        do
+        {
+            size_t plus = text.find('+', pos);
+            if (plus == std::string::npos)
+                plus = text.size();
+            if (text.compare(pos, 4, "fir:") == 0 && plus > pos + 4)
+                files.push_back(text.substr(pos + 4, plus - pos - 4));
+            pos = plus + 1;
+        } while (pos <= text.size());
+    }
+
+protected:
+    std::vector<std::unique_ptr<PcmFilter>> m_filters;
+
+    bool parse_one(const std::string& item, uint32_t rate)
+    {
+        if (item.compare(0, 4, "fir:") == 0)
+            return item.size() > 4 && load_fir(item.c_str() + 4);
+
+        std::vector<std::string> args;
+        for (size_t i = 0; ; )
+        {
+            size_t colon = item.find(':', i);
+            args.push_back(item.substr(i, (colon == std::string::npos) ? colon : colon - i));
+            if (colon == std::string::npos)
+                break;
+            i = colon + 1;
+        }
+        const std::string& name = args[0];
+
+        // the numbers after the name
+        std::vector<double> values;
+        for (size_t i = 1; i < args.size(); ++i)
+        {
+            char *endptr;
+            double value = std::strtod(args[i].c_str(), &endptr);
+            if (args[i].empty() || *endptr != 0)
+                return false;
+            values.push_back(value);
+        }
+        const double nyquist = rate / 2.0;
+        auto is_freq = [&](double f) { return f > 0 && f < nyquist; };
+
+        if (name == "dcblock")
+        {
+            double f = values.empty() ? PCM_FILTER_DCBLOCK_HZ : values[0];
+            if (values.size() > 1 || !is_freq(f))
+                return false;
+            PcmIirFilter *filter = new PcmIirFilter;
+            pcm_filter_design_dcblock(*filter, f / rate);
+            add(filter);
+            return true;
+        }
+
+        bool band = (name == "bandpass" || name == "iir-bandpass");
+        size_t nfreqs = band ? 2 : 1;
+        if (values.size() < nfreqs || values.size() > nfreqs + 1)
+            return false;
+        for (size_t i = 0; i < nfreqs; ++i)
+        {
+            if (!is_freq(values[i]))
+                return false;
+        }
+        if (band && values[0] >= values[1])
+            return false;
+
+        if (name == "lowpass" || name == "highpass" || name == "bandpass")
+        {
+            double taps = (values.size() > nfreqs) ? values[nfreqs] : PCM_FILTER_DEFAULT_TAPS;
+            if (taps < 3 || taps > PCM_FILTER_MAX_TAPS || taps != std::floor(taps) ||
+                std::fmod(taps, 2) != 1)
+            {
+                return false;
+            }
+            std::vector<float> h;
+            if (name == "lowpass")
+                pcm_filter_design_lowpass(values[0] / rate, size_t(taps), h);
+            else if (name == "highpass")
+                pcm_filter_design_highpass(values[0] / rate, size_t(taps), h);
+            else
+                pcm_filter_design_bandpass(values[0] / rate, values[1] / rate, size_t(taps), h);
+            add(pcm_filter_fir(h, size_t(taps) / 2));
+            return true;
+        }
+
+        if (name == "iir-lowpass" || name == "iir-highpass" || name == "iir-bandpass")
+        {
+            double order = (values.size() > nfreqs) ? values[nfreqs] : PCM_FILTER_DEFAULT_ORDER;
+            if (order < 2 || order > PCM_FILTER_MAX_ORDER || std::fmod(order, 2) != 0)
+                return false;
+            PcmIirFilter *filter = new PcmIirFilter;
+            if (band)
+            {
+                pcm_filter_design_butterworth(*filter, values[0] / rate, int(order), true);
+                pcm_filter_design_butterworth(*filter, values[1] / rate, int(order), false);
+            }
+            else
+            {
+                pcm_filter_design_butterworth(*filter, values[0] / rate, int(order),
+                                              name == "iir-highpass");
+            }
+            add(filter);
+            return true;
+        }
+
+        return false;
+    }
+
+    // whitespace-separated numbers
+    bool load_fir(const char *file)
+    {
+        std::FILE *fp = std::fopen(file, "r");
+        if (!fp)
+            return false;
+        std::vector<float> h;
+        double value;
+        while (h.size() < PCM_FILTER_MAX_TAPS && std::fscanf(fp, "%lf", &value) == 1)
+            h.push_back(float(value));
+        bool ok = !h.empty() && std::feof(fp);
+        std::fclose(fp);
+        if (ok)
+            add(pcm_filter_fir(h));
+        return ok;
+    }
+}; // class PcmFilterChain
+
+#endif  // ndef PCM_FILTER_HPP_
@@ -0,0 +1,137 @@
+#ifndef PCM_G711_HPP_
+#define PCM_G711_HPP_     1   /* Version 1 */
+
+#include <cstdint>
+#include <cstddef>
+
+// G.711 mu-law (WAVE_FORMAT_MULAW, 7) and A-law (WAVE_FORMAT_ALAW, 6).
+// A byte expands to a 16-bit sample through a 256-entry table built at
+// compile time. A 16-bit sample compresses through a 64K-entry table
+// (64 KB per law) built from the segment search on first use. Both bulk
+// loops are a single load per sample. The algorithms are those of the Sun
+// reference implementation, as used by most other codecs.
+
+// mu-law: bits are inverted; sign, 3-bit segment, 4-bit quantization
+constexpr int pcm_ulaw_magnitude(unsigned u)
+{
+    return (int(((u & 0x0F) << 3) + 0x84) << ((u & 0x70) >> 4)) - 0x84;
+}
+
+constexpr int16_t pcm_ulaw_to_linear(uint8_t code)
+{
+    return int16_t((~code & 0x80) ? -pcm_ulaw_magnitude(~code & 0xFFu)
+                                  : pcm_ulaw_magnitude(~code & 0xFFu));
+}
+
+// A-law: even bits are inverted; sign set means positive
+constexpr int pcm_alaw_magnitude(unsigned a)
+{
+    return ((a & 0x70) == 0) ? int((a & 0x0F) << 4) + 8
+                             : (int((a & 0x0F) << 4) + 0x108) << (((a & 0x70) >> 4) - 1);
+}
+
+constexpr int16_t pcm_alaw_to_linear(uint8_t code)
+{
+    return int16_t(((code ^ 0x55) & 0x80) ? pcm_alaw_magnitude(code ^ 0x55u)
+                                          : -pcm_alaw_magnitude(code ^ 0x55u));
+}
+
+#define PCM_G711_ROW(f, i) \
+    f(i + 0), f(i + 1), f(i + 2), f(i + 3), f(i + 4), f(i + 5), f(i + 6), f(i + 7), \
+    f(i + 8), f(i + 9), f(i + 10), f(i + 11), f(i + 12), f(i + 13), f(i + 14), f(i + 15)
+#define PCM_G711_TABLE(f) \
+    PCM_G711_ROW(f, 0x00), PCM_G711_ROW(f, 0x10), PCM_G711_ROW(f, 0x20), PCM_G711_ROW(f, 0x30), \
+    PCM_G711_ROW(f, 0x40), PCM_G711_ROW(f, 0x50), PCM_G711_ROW(f, 0x60), PCM_G711_ROW(f, 0x70), \
+    PCM_G711_ROW(f, 0x80), PCM_G711_ROW(f, 0x90), PCM_G711_ROW(f, 0xA0), PCM_G711_ROW(f, 0xB0), \
+    PCM_G711_ROW(f, 0xC0), PCM_G711_ROW(f, 0xD0), PCM_G711_ROW(f, 0xE0), PCM_G711_ROW(f, 0xF0)
+
+static constexpr int16_t pcm_ulaw_table[256] = { PCM_G711_TABLE(pcm_ulaw_to_linear) };
+static constexpr int16_t pcm_alaw_table[256] = { PCM_G711_TABLE(pcm_alaw_to_linear) };
+
+#undef PCM_G711_TABLE
+#undef PCM_G711_ROW
+
+// the segment of a magnitude: the first end that is not below it, or 8
+inline int pcm_g711_segment(int value, int first_end)
+{
+    int seg = 0;
+    for (int end = first_end; seg < 8 && value > end; end = end * 2 + 1)
+        ++seg;
+    return seg;
+}
+
+inline uint8_t pcm_linear_to_ulaw(int16_t sample)
+{
+    int value = sample >> 2;
+    int mask = 0xFF;
+    if (value < 0)
+    {
+        value = -value;
+        mask = 0x7F;
+    }
+    if (value > 8159)
+        value = 8159;
+    value += 0x84 >> 2;
+
+    int seg = pcm_g711_segment(value, 0x3F);
+    if (seg >= 8)
+        return uint8_t(0x7F ^ mask);
+    return uint8_t(((seg << 4) | ((value >> (seg + 1)) & 0x0F)) ^ mask);
+}
+
+inline uint8_t pcm_linear_to_alaw(int16_t sample)
+{
+    int value = sample >> 3;
+    int mask = 0xD5;
+    if (value < 0)
+    {
+        value = -value - 1;
+        mask = 0x55;
+    }
+
+    int seg = pcm_g711_segment(value, 0x1F);
+    if (seg >= 8)
+        return uint8_t(0x7F ^ mask);
+    int code = seg << 4;
+    code |= (value >> ((seg < 2) ? 1 : seg)) & 0x0F;
+    return uint8_t(code ^ mask);
+}
+
+// the 64K encoding table of a law, indexed by uint16_t(sample)
+struct PcmG711EncodeTable
+{
+    uint8_t codes[65536];
+
+    explicit PcmG711EncodeTable(bool ulaw)
+    {
+        for (int i = 0; i < 65536; ++i)
+        {
+            int16_t sample = int16_t(uint16_t(i));
+            codes[i] = ulaw ? pcm_linear_to_ulaw(sample) : pcm_linear_to_alaw(sample);
+        }
+    }
+};
+
+inline const uint8_t *pcm_g711_encode_table(bool ulaw)
+{
+    // C++11 makes the initialization of local statics thread-safe
+    static const PcmG711EncodeTable ulaw_table(true);
+    static const PcmG711EncodeTable alaw_table(false);
+    return ulaw ? ulaw_table.codes : alaw_table.codes;
+}
+
+inline void pcm_g711_decode(const uint8_t *src, int16_t *dest, size_t count, bool ulaw)
+{
+    const int16_t *table = ulaw ? pcm_ulaw_table : pcm_alaw_table;
+    for (size_t i = 0; i < count; ++i)
+        dest[i] = table[src[i]];
+}
+
+inline void pcm_g711_encode(const int16_t *src, uint8_t *dest, size_t count, bool ulaw)
+{
+    const uint8_t *table = pcm_g711_encode_table(ulaw);
+    for (size_t i = 0; i < count; ++i)
+        dest[i] = table[uint16_t(src[i])];
+}
+
+#endif  // ndef PCM_G711_HPP_
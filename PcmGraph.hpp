@@ -0,0 +1,278 @@
+#ifndef PCM_GRAPH_HPP_
+#define PCM_GRAPH_HPP_     2   /* Version 2 */
+
+#include "PcmWave.hpp"
+#include <vector>
+#include <memory>
+
+// A processing graph over blocks of frames. Each node takes the block of
+// its parent, or of the source, and gives a block to its children; a node
+// with several children is a branch. The nodes check their input formats
+// once, in configure(), before the first block. The buffers of the nodes
+// live as long as the graph, so the blocks after the first reuse them.
+// A node that holds frames back, such as a filter that makes up for its
+// delay, gives them in drain() after the last block.
+
+struct PcmFormat
+{
+    uint16_t channels;
+    uint16_t bits;
+    uint32_t rate;
+};
+
+class PcmNode
+{
+public:
+    virtual ~PcmNode() { }
+
+    // checks the input format and gives the output format
+    virtual bool configure(const PcmFormat& in, PcmFormat& out) = 0;
+
+    // Processes a block. The node may change in, which nobody reads after
+    // it, and return it, or fill out, its own buffer, and return that.
+    // NULL on failure.
+    virtual PcmWave *process(PcmWave& in, PcmWave& out) = 0;
+
+    // Gives the frames held back after the last block, in out, or NULL if
+    // there are none.
+    virtual PcmWave *drain(PcmWave& out)
+    {
+        (void)out;
+        return NULL;
+    }
+
+    // called after the last block
+    virtual bool finish()
+    {
+        return true;
+    }
+};
+
+// the end of a branch; writes the blocks to a file
+class PcmWriterNode : public PcmNode
+{
+public:
+    // name is for messages; flags are those of PcmWaveWriter::open; frames
+    // is the length of the source, if known
+    PcmWriterNode(std::FILE *fp, const char *name, int flags = 0,
+                  uint64_t frames = PCM_WAVE_SIZE_UNKNOWN)
+        : m_fp(fp), m_name(name), m_flags(flags), m_frames(frames)
+    {
+    }
+
+    bool configure(const PcmFormat& in, PcmFormat& out)
+    {
+        out = in;
+        // The length spares a file the JUNK chunk. A pipe keeps streaming
+        // sizes, as the source may be shorter than its header says.
+        uint64_t size = PCM_WAVE_SIZE_UNKNOWN;
+        if (m_frames != PCM_WAVE_SIZE_UNKNOWN && pcm_wave_is_seekable(m_fp))
+            size = m_frames * in.channels * (in.bits / 8);
+        if (!m_writer.open(m_fp, in.channels, in.bits, in.rate, size, m_flags))
+        {
+            pcm_wave_message("ERROR: %s: Unable to write.\n", m_name);
+            return false;
+        }
+        return true;
+    }
+
+    PcmWave *process(PcmWave& in, PcmWave&)
+    {
+        if (!m_writer.write(in))
+        {
+            pcm_wave_message("ERROR: %s: Unable to write.\n", m_name);
+            return NULL;
+        }
+        return &in;
+    }
+
+    bool finish()
+    {
+        if (!m_writer.close())
+        {
+            pcm_wave_message("ERROR: %s: Unable to write.\n", m_name);
+            return false;
+        }
+        return true;
+    }
+
+    const char *name() const
+    {
+        return m_name;
+    }
+
+    const PcmWave& header() const
+    {
+        return m_writer.header();
+    }
+
+protected:
+    std::FILE *m_fp;
+    const char *m_name;
+    int m_flags;
+    uint64_t m_frames;
+    PcmWaveWriter m_writer;
+};
+
+class PcmGraph
+{
+public:
+    // Adds a node after parent, or after the source if parent is negative,
+    // and takes it over. Returns the id of the node. A parent comes before
+    // its children, so the nodes run in the order they were added.
+    int add(PcmNode *node, int parent = -1)
+    {
+        assert(parent < int(m_nodes.size()));
+        m_nodes.emplace_back(node);
+        m_parents.push_back(parent);
+        return int(m_nodes.size()) - 1;
+    }
+
+    size_t size() const
+    {
+        return m_nodes.size();
+    }
+
+    PcmNode *node(int id) const
+    {
+        return m_nodes[id].get();
+    }
+
+    int parent(int id) const
+    {
+        return m_parents[id];
+    }
+
+    // the output format of a node, after configure()
+    const PcmFormat& format(int id) const
+    {
+        return m_formats[id];
+    }
+
+    bool configure(const PcmFormat& source)
+    {
+        size_t count = m_nodes.size();
+        m_formats.resize(count);
+        m_buffers.resize(count);
+        m_copies.resize(count);
+        m_results.assign(count, NULL);
+
+        // The last child of a node gets the block itself; its other children
+        // get copies, as a child may change its input.
+        std::vector<int> last(count + 1, -1);
+        for (size_t i = 0; i < count; ++i)
+        {
+            last[m_parents[i] + 1] = int(i);
+        }
+        m_owner.resize(count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            m_owner[i] = (last[m_parents[i] + 1] == int(i));
+        }
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            const PcmFormat& in = (m_parents[i] < 0) ? source : m_formats[m_parents[i]];
+            if (!m_nodes[i]->configure(in, m_formats[i]))
+                return false;
+        }
+        return true;
+    }
+
+    // runs a block of the source through the graph; block may be changed
+    bool push(PcmWave& block)
+    {
+        return push_from(-1, block);
+    }
+
+    // runs a block given by node source, or by the source of the graph if
+    // negative, through the nodes after it
+    bool push_from(int source, PcmWave& block)
+    {
+        for (size_t i = source + 1; i < m_nodes.size(); ++i)
+        {
+            int parent = m_parents[i];
+            PcmWave *in;
+            if (parent == source)
+                in = &block;
+            else if (parent > source && m_results[parent])
+                in = m_results[parent];
+            else
+            {
+                m_results[i] = NULL;
+                continue;
+            }
+            if (!m_owner[i])
+            {
+                copy_block(*in, m_copies[i]);
+                in = &m_copies[i];
+            }
+
+            m_results[i] = m_nodes[i]->process(*in, m_buffers[i]);
+            if (!m_results[i])
+                return false;
+        }
+        return true;
+    }
+
+    // runs the frames held back by the nodes through the nodes after them;
+    // called after the last block
+    bool flush()
+    {
+        for (size_t i = 0; i < m_nodes.size(); ++i)
+        {
+            PcmWave *tail = m_nodes[i]->drain(m_buffers[i]);
+            if (tail && !push_from(int(i), *tail))
+                return false;
+        }
+        return true;
+    }
+
+    // finishes every node, even after a failure of one
+    bool finish()
+    {
+        bool ok = true;
+        for (auto& node : m_nodes)
+        {
+            if (!node->finish())
+                ok = false;
+        }
+        return ok;
+    }
+
+    // runs the rest of reader through the graph, block_units frames at a time
+    bool run(PcmWaveReader& reader, size_t block_units)
+    {
+        PcmWave block;
+        while (reader.read(block, block_units) > 0)
+        {
+            if (!push(block))
+            {
+                finish();
+                return false;
+            }
+        }
+        bool ok = flush();
+        return finish() && ok;
+    }
+
+protected:
+    std::vector<std::unique_ptr<PcmNode>> m_nodes;
+    std::vector<int> m_parents;
+    std::vector<PcmFormat> m_formats;
+    std::vector<PcmWave> m_buffers;     // the outputs of the nodes
+    std::vector<PcmWave> m_copies;      // the inputs of the children that share one
+    std::vector<PcmWave *> m_results;
+    std::vector<bool> m_owner;
+
+    static void copy_block(const PcmWave& src, PcmWave& dest)
+    {
+        dest.set_info(src.num_channels(), src.mode(), src.sample_rate());
+        if (src.data_size() > 0)
+            dest.set_data(&src.data_8bit(0), size_t(src.data_size()));
+        else
+            dest.set_data(NULL, 0);
+    }
+}; // class PcmGraph
+
+#endif  // ndef PCM_GRAPH_HPP_
@@ -0,0 +1,199 @@
+#ifndef PCM_HASH_HPP_
+#define PCM_HASH_HPP_     1   /* Version 1 */
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define PCM_HASH_SSE2
+#endif
+
+// A streaming 64-bit non-cryptographic hash for cache keys, not for
+// security. The input is consumed in stripes of 64 bytes by 8 64-bit lanes
+// as in XXH3:
+//   acc[i] += lo32(x[i] ^ k[i]) * hi32(x[i] ^ k[i]);  acc[i ^ 1] += x[i];
+// The lanes are scrambled every PCM_HASH_SCRAMBLE stripes and merged with
+// the xxHash64 rounds and avalanche. The SSE2 loop and the scalar loop give
+// the same values. Words are read in the native byte order.
+
+#define PCM_HASH_STRIPE     64      // bytes per stripe
+#define PCM_HASH_SCRAMBLE   16      // stripes between scrambles
+
+static const uint64_t pcm_hash_keys[16] =
+{
+    // accumulation
+    0xCC153627A7C96E8CULL, 0x8BEC49D6A891D0C1ULL, 0x747DBAD1B6A4B9C3ULL, 0x468E364002D1A1ADULL,
+    0x60A3F0C8658322EBULL, 0x7551904DCD9F6101ULL, 0x3710BCCFFA347A99ULL, 0xCBBC71DB4129A6CDULL,
+    // scrambling
+    0xF2BE76219DE331E5ULL, 0x727EE46D42FED2B6ULL, 0x60E293F4C7C2D090ULL, 0xBE13CB6403522D30ULL,
+    0x4080C85F7060BA7CULL, 0x5C30B0FD0385E217ULL, 0x596DBD07461B3B82ULL, 0x2E64A2FD0CAFF66CULL
+};
+
+#define PCM_HASH_PRIME32_1  0x9E3779B1U
+#define PCM_HASH_PRIME64_1  0x9E3779B185EBCA87ULL
+#define PCM_HASH_PRIME64_2  0xC2B2AE3D27D4EB4FULL
+#define PCM_HASH_PRIME64_3  0x165667B19E3779F9ULL
+#define PCM_HASH_PRIME64_4  0x85EBCA77C2B2AE63ULL
+
+inline uint64_t pcm_hash_rotl(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+inline void pcm_hash_accumulate(uint64_t *acc, const uint8_t *stripe)
+{
+#ifdef PCM_HASH_SSE2
+    for (int i = 0; i < 8; i += 2)
+    {
+        __m128i x = _mm_loadu_si128((const __m128i *)(stripe + 8 * i));
+        __m128i k = _mm_loadu_si128((const __m128i *)(pcm_hash_keys + i));
+        __m128i dk = _mm_xor_si128(x, k);
+        __m128i hi = _mm_shuffle_epi32(dk, _MM_SHUFFLE(0, 3, 0, 1));
+        __m128i a = _mm_loadu_si128((const __m128i *)(acc + i));
+        a = _mm_add_epi64(a, _mm_shuffle_epi32(x, _MM_SHUFFLE(1, 0, 3, 2)));
+        a = _mm_add_epi64(a, _mm_mul_epu32(dk, hi));
+        _mm_storeu_si128((__m128i *)(acc + i), a);
+    }
+#else
+    for (int i = 0; i < 8; ++i)
+    {
+        uint64_t x;
+        std::memcpy(&x, stripe + 8 * i, 8);
+        uint64_t dk = x ^ pcm_hash_keys[i];
+        acc[i ^ 1] += x;
+        acc[i] += (dk & 0xFFFFFFFF) * (dk >> 32);
+    }
+#endif
+}
+
+inline void pcm_hash_scramble(uint64_t *acc)
+{
+#ifdef PCM_HASH_SSE2
+    const __m128i prime = _mm_set1_epi32(int(PCM_HASH_PRIME32_1));
+    for (int i = 0; i < 8; i += 2)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i *)(acc + i));
+        __m128i k = _mm_loadu_si128((const __m128i *)(pcm_hash_keys + 8 + i));
+        a = _mm_xor_si128(a, _mm_srli_epi64(a, 47));
+        a = _mm_xor_si128(a, k);
+        // 64 x 32-bit multiplication from two 32 x 32 -> 64-bit ones
+        __m128i lo = _mm_mul_epu32(a, prime);
+        __m128i hi = _mm_mul_epu32(_mm_shuffle_epi32(a, _MM_SHUFFLE(0, 3, 0, 1)), prime);
+        a = _mm_add_epi64(lo, _mm_slli_epi64(hi, 32));
+        _mm_storeu_si128((__m128i *)(acc + i), a);
+    }
+#else
+    for (int i = 0; i < 8; ++i)
+    {
+        uint64_t a = acc[i];
+        a ^= a >> 47;
+        a ^= pcm_hash_keys[8 + i];
+        acc[i] = a * PCM_HASH_PRIME32_1;
+    }
+#endif
+}
+
+class PcmHash64
+{
+public:
+    PcmHash64()
+    {
+        reset();
+    }
+
+    void reset()
+    {
+        static const uint64_t init[8] =
+        {
+            PCM_HASH_PRIME64_3, PCM_HASH_PRIME64_1, PCM_HASH_PRIME64_2, PCM_HASH_PRIME64_3,
+            PCM_HASH_PRIME64_4, PCM_HASH_PRIME64_2, PCM_HASH_PRIME64_4, PCM_HASH_PRIME64_1
+        };
+        std::memcpy(m_acc, init, sizeof(m_acc));
+        m_total = 0;
+        m_stripes = 0;
+        m_buffered = 0;
+    }
+
+    void update(const void *data, size_t size)
+    {
+        const uint8_t *p = static_cast<const uint8_t *>(data);
+        m_total += size;
+
+        if (m_buffered)
+        {
+            size_t n = PCM_HASH_STRIPE - m_buffered;
+            if (n > size)
+                n = size;
+            std::memcpy(m_buffer + m_buffered, p, n);
+            m_buffered += n;
+            p += n;
+            size -= n;
+            if (m_buffered < PCM_HASH_STRIPE)
+                return;
+            consume(m_acc, m_stripes, m_buffer);
+            m_buffered = 0;
+        }
+
+        for (; size >= PCM_HASH_STRIPE; size -= PCM_HASH_STRIPE, p += PCM_HASH_STRIPE)
+            consume(m_acc, m_stripes, p);
+
+        std::memcpy(m_buffer, p, size);
+        m_buffered = size;
+    }
+
+    template <typename T>
+    void update_value(const T& value)
+    {
+        update(&value, sizeof(value));
+    }
+
+    // the hash of the bytes so far; more can be added after it
+    uint64_t digest() const
+    {
+        uint64_t acc[8];
+        size_t stripes = m_stripes;
+        std::memcpy(acc, m_acc, sizeof(acc));
+        if (m_buffered)
+        {
+            uint8_t last[PCM_HASH_STRIPE] = { 0 };
+            std::memcpy(last, m_buffer, m_buffered);
+            consume(acc, stripes, last);
+        }
+        pcm_hash_scramble(acc);
+
+        uint64_t h = m_total * PCM_HASH_PRIME64_1;
+        for (int i = 0; i < 8; ++i)
+        {
+            uint64_t k = pcm_hash_rotl(acc[i] * PCM_HASH_PRIME64_2, 31) * PCM_HASH_PRIME64_1;
+            h = pcm_hash_rotl(h ^ k, 27) * PCM_HASH_PRIME64_1 + PCM_HASH_PRIME64_4;
+        }
+
+        h ^= h >> 33;
+        h *= PCM_HASH_PRIME64_2;
+        h ^= h >> 29;
+        h *= PCM_HASH_PRIME64_3;
+        h ^= h >> 32;
+        return h;
+    }
+
+protected:
+    uint64_t m_acc[8];
+    uint64_t m_total;           // bytes hashed
+    size_t m_stripes;           // since the last scramble
+    uint8_t m_buffer[PCM_HASH_STRIPE];
+    size_t m_buffered;
+
+    static void consume(uint64_t *acc, size_t& stripes, const uint8_t *stripe)
+    {
+        pcm_hash_accumulate(acc, stripe);
+        if (++stripes == PCM_HASH_SCRAMBLE)
+        {
+            pcm_hash_scramble(acc);
+            stripes = 0;
+        }
+    }
+}; // class PcmHash64
+
+#endif  // ndef PCM_HASH_HPP_
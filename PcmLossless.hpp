@@ -0,0 +1,793 @@
+#ifndef PCM_LOSSLESS_HPP_
+#define PCM_LOSSLESS_HPP_     1   /* Version 1 */
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+
+// A lossless block codec for 8/16-bit PCM in the spirit of FLAC. Each
+// channel of a block is predicted by a fixed polynomial (order 0-4) or by
+// quantized LPC (order up to PCM_LOSSLESS_MAX_ORDER), and the residuals are
+// zigzag Rice-coded in partitions with their own parameter. Stereo blocks
+// pick the cheapest of left/right, left/side, side/right and mid/side.
+// 8-bit samples are centered at zero before prediction.
+//
+// The "PCMZ" container (little-endian):
+//   PCM_LOSSLESS_HEADER
+//   blocks: { uint32_t size; uint32_t frames; uint8_t payload[size]; } ...
+//   end marker: { 0, 0 }
+//   seek table: { uint32_t count; uint64_t offset[count]; }
+// The offsets of the seek table count from the start of the header. Every
+// block but the last holds BlockUnits frames, so block i starts at frame
+// i * BlockUnits. A streamed file has 0xFFFFFFFF frames and no table offset
+// in its header; a reader then walks the blocks. BlockUnits frames of PCM
+// may not exceed PCM_LOSSLESS_MAX_BLOCK_SIZE bytes.
+
+#define PCM_LOSSLESS_MAGIC          0x5A4D4350  /* "PCMZ" */
+#define PCM_LOSSLESS_VERSION        1
+#define PCM_LOSSLESS_BLOCK_UNITS    4096    // frames per block
+#define PCM_LOSSLESS_BATCH          64      // blocks coded in parallel
+#define PCM_LOSSLESS_MAX_BLOCK_SIZE (1 << 20)   // bytes of PCM in a block
+#define PCM_LOSSLESS_MAX_ORDER      12      // of LPC
+#define PCM_LOSSLESS_PRECISION      13      // bits of an LPC coefficient
+#define PCM_LOSSLESS_PARTITION      256     // residuals per Rice parameter
+#define PCM_LOSSLESS_ESCAPE         31      // Rice parameter of raw 32-bit values
+
+typedef struct PCM_LOSSLESS_HEADER
+{
+    uint32_t Magic;             /* "PCMZ" 0x5A4D4350 */
+    uint16_t Version;           /* 1 */
+    uint16_t NumChannels;
+    uint16_t BitsPerSample;     /* 8 or 16 */
+    uint16_t Reserved;          /* 0 */
+    uint32_t SampleRate;
+    uint32_t BlockUnits;        /* frames per block */
+    uint32_t FramesLow;         /* 0xFFFFFFFF both if unknown */
+    uint32_t FramesHigh;
+    uint32_t TableLow;          /* offset of the seek table; 0 if none */
+    uint32_t TableHigh;
+} PCM_LOSSLESS_HEADER;
+
+enum PCM_LOSSLESS_SUBFRAME
+{
+    PCM_LOSSLESS_CONSTANT = 0,
+    PCM_LOSSLESS_VERBATIM = 1,
+    PCM_LOSSLESS_FIXED = 2,
+    PCM_LOSSLESS_LPC = 3
+};
+
+enum PCM_LOSSLESS_STEREO
+{
+    PCM_LOSSLESS_LEFT_RIGHT = 0,
+    PCM_LOSSLESS_LEFT_SIDE = 1,
+    PCM_LOSSLESS_SIDE_RIGHT = 2,
+    PCM_LOSSLESS_MID_SIDE = 3
+};
+
+// MSB-first bit writer
+class PcmBitWriter
+{
+public:
+    explicit PcmBitWriter(std::vector<uint8_t>& out) : m_out(out), m_acc(0), m_bits(0)
+    {
+    }
+
+    // the low n bits of value; n <= 32
+    void put(uint32_t value, int n)
+    {
+        if (n == 0)
+            return;
+        m_acc = (m_acc << n) | (value & (0xFFFFFFFFu >> (32 - n)));
+        m_bits += n;
+        while (m_bits >= 8)
+        {
+            m_bits -= 8;
+            m_out.push_back(uint8_t(m_acc >> m_bits));
+        }
+    }
+
+    void put_signed(int32_t value, int n)
+    {
+        put(uint32_t(value), n);
+    }
+
+    // q zeros and a one
+    void put_unary(uint32_t q)
+    {
+        for (; q >= 32; q -= 32)
+            put(0, 32);
+        put(1, int(q) + 1);
+    }
+
+    // pads the last byte with zeros
+    void flush()
+    {
+        if (m_bits > 0)
+            put(0, 8 - m_bits);
+    }
+
+protected:
+    std::vector<uint8_t>& m_out;
+    uint64_t m_acc;
+    int m_bits;
+};
+
+// MSB-first bit reader. Reading past the end sets error() and returns zeros.
+class PcmBitReader
+{
+public:
+    PcmBitReader(const uint8_t *data, size_t size)
+        : m_p(data), m_end(data + size), m_acc(0), m_bits(0), m_error(false)
+    {
+    }
+
+    bool error() const { return m_error; }
+
+    uint32_t get(int n)
+    {
+        if (n == 0)
+            return 0;
+        if (m_bits < n)
+        {
+            refill();
+            if (m_bits < n)
+            {
+                m_error = true;
+                return 0;
+            }
+        }
+        uint32_t value = uint32_t(m_acc >> (64 - n));
+        m_acc <<= n;
+        m_bits -= n;
+        return value;
+    }
+
+    // sign-extends n bits
+    int32_t get_signed(int n)
+    {
+        uint32_t value = get(n);
+        if (n < 32 && (value & (1u << (n - 1))))
+            value |= ~0u << n;
+        return int32_t(value);
+    }
+
+    uint32_t get_unary()
+    {
+        uint32_t q = 0;
+        for (;;)
+        {
+            if (m_bits == 0)
+            {
+                refill();
+                if (m_bits == 0)
+                {
+                    m_error = true;
+                    return 0;
+                }
+            }
+            if (m_acc == 0)
+            {
+                // the valid bits are all zeros
+                q += m_bits;
+                m_bits = 0;
+                continue;
+            }
+            int zeros = count_leading_zeros(m_acc);
+            if (zeros >= m_bits)
+            {
+                q += m_bits;
+                m_acc = 0;
+                m_bits = 0;
+                continue;
+            }
+            q += zeros;
+            m_acc <<= zeros + 1;
+            m_bits -= zeros + 1;
+            return q;
+        }
+    }
+
+protected:
+    const uint8_t *m_p;
+    const uint8_t *m_end;
+    uint64_t m_acc;         // the next bit is bit 63
+    int m_bits;
+    bool m_error;
+
+    void refill()
+    {
+        while (m_bits <= 56 && m_p < m_end)
+        {
+            m_acc |= uint64_t(*m_p++) << (56 - m_bits);
+            m_bits += 8;
+        }
+    }
+
+    static int count_leading_zeros(uint64_t x)
+    {
+    #if defined(__GNUC__) || defined(__clang__)
+        return __builtin_clzll(x);
+    #else
+        int n = 0;
+        for (; !(x & (uint64_t(1) << 63)); x <<= 1)
+            ++n;
+        return n;
+    #endif
+    }
+};
+
+inline uint32_t pcm_lossless_zigzag(int32_t value)
+{
+    return (uint32_t(value) << 1) ^ uint32_t(value >> 31);
+}
+
+inline int32_t pcm_lossless_unzigzag(uint32_t value)
+{
+    return int32_t(value >> 1) ^ -int32_t(value & 1);
+}
+
+// the Rice parameter of a partition and its cost in bits
+inline int pcm_lossless_rice_param(const uint32_t *u, size_t count, uint64_t *cost)
+{
+    uint64_t sum = 0;
+    for (size_t i = 0; i < count; ++i)
+        sum += u[i];
+
+    int best = PCM_LOSSLESS_ESCAPE;
+    uint64_t best_cost = uint64_t(count) * 32;
+    for (int k = 0; k < PCM_LOSSLESS_ESCAPE; ++k)
+    {
+        uint64_t bits = uint64_t(count) * (k + 1) + (sum >> k);
+        if (bits < best_cost)
+        {
+            best = k;
+            best_cost = bits;
+        }
+        if ((sum >> k) == 0)
+            break;
+    }
+    *cost = best_cost + 5;
+    return best;
+}
+
+// the estimated bits of the Rice-coded residuals
+inline uint64_t pcm_lossless_rice_cost(const int32_t *res, size_t count,
+                                       std::vector<uint32_t>& work)
+{
+    work.resize(count);
+    for (size_t i = 0; i < count; ++i)
+        work[i] = pcm_lossless_zigzag(res[i]);
+
+    uint64_t total = 0;
+    for (size_t i = 0; i < count; i += PCM_LOSSLESS_PARTITION)
+    {
+        size_t len = (count - i < PCM_LOSSLESS_PARTITION) ? count - i : PCM_LOSSLESS_PARTITION;
+        uint64_t cost;
+        pcm_lossless_rice_param(&work[i], len, &cost);
+        total += cost;
+    }
+    return total;
+}
+
+inline void pcm_lossless_put_rice(PcmBitWriter& bw, const int32_t *res, size_t count,
+                                  std::vector<uint32_t>& work)
+{
+    work.resize(count);
+    for (size_t i = 0; i < count; ++i)
+        work[i] = pcm_lossless_zigzag(res[i]);
+
+    for (size_t i = 0; i < count; i += PCM_LOSSLESS_PARTITION)
+    {
+        size_t len = (count - i < PCM_LOSSLESS_PARTITION) ? count - i : PCM_LOSSLESS_PARTITION;
+        uint64_t cost;
+        int k = pcm_lossless_rice_param(&work[i], len, &cost);
+        bw.put(k, 5);
+        if (k == PCM_LOSSLESS_ESCAPE)
+        {
+            for (size_t j = 0; j < len; ++j)
+                bw.put(work[i + j], 32);
+            continue;
+        }
+        for (size_t j = 0; j < len; ++j)
+        {
+            bw.put_unary(work[i + j] >> k);
+            bw.put(work[i + j], k);
+        }
+    }
+}
+
+inline bool pcm_lossless_get_rice(PcmBitReader& br, int32_t *res, size_t count)
+{
+    for (size_t i = 0; i < count; i += PCM_LOSSLESS_PARTITION)
+    {
+        size_t len = (count - i < PCM_LOSSLESS_PARTITION) ? count - i : PCM_LOSSLESS_PARTITION;
+        int k = int(br.get(5));
+        if (k == PCM_LOSSLESS_ESCAPE)
+        {
+            for (size_t j = 0; j < len; ++j)
+                res[i + j] = pcm_lossless_unzigzag(br.get(32));
+            continue;
+        }
+        for (size_t j = 0; j < len; ++j)
+        {
+            uint32_t q = br.get_unary();
+            res[i + j] = pcm_lossless_unzigzag((q << k) | br.get(k));
+        }
+        if (br.error())
+            return false;
+    }
+    return !br.error();
+}
+
+// residuals of the fixed polynomial predictor of the order (0-4)
+inline void pcm_lossless_fixed_residual(const int32_t *x, size_t n, int order, int32_t *res)
+{
+    for (size_t i = order; i < n; ++i)
+    {
+        int32_t e;
+        switch (order)
+        {
+        case 0: e = x[i]; break;
+        case 1: e = x[i] - x[i - 1]; break;
+        case 2: e = x[i] - 2 * x[i - 1] + x[i - 2]; break;
+        case 3: e = x[i] - 3 * x[i - 1] + 3 * x[i - 2] - x[i - 3]; break;
+        default: e = x[i] - 4 * x[i - 1] + 6 * x[i - 2] - 4 * x[i - 3] + x[i - 4]; break;
+        }
+        res[i - order] = e;
+    }
+}
+
+inline void pcm_lossless_fixed_restore(int32_t *x, size_t n, int order, const int32_t *res)
+{
+    for (size_t i = order; i < n; ++i)
+    {
+        int32_t e = res[i - order];
+        switch (order)
+        {
+        case 0: x[i] = e; break;
+        case 1: x[i] = e + x[i - 1]; break;
+        case 2: x[i] = e + 2 * x[i - 1] - x[i - 2]; break;
+        case 3: x[i] = e + 3 * x[i - 1] - 3 * x[i - 2] + x[i - 3]; break;
+        default: x[i] = e + 4 * x[i - 1] - 6 * x[i - 2] + 4 * x[i - 3] - x[i - 4]; break;
+        }
+    }
+}
+
+// the order of the fixed predictor with the smallest residuals
+inline int pcm_lossless_fixed_order(const int32_t *x, size_t n)
+{
+    uint64_t sum[5] = { 0, 0, 0, 0, 0 };
+    for (size_t i = 4; i < n; ++i)
+    {
+        int64_t e0 = x[i];
+        int64_t e1 = e0 - x[i - 1];
+        int64_t e2 = e1 - (int64_t(x[i - 1]) - x[i - 2]);
+        int64_t e3 = e2 - (int64_t(x[i - 1]) - 2 * int64_t(x[i - 2]) + x[i - 3]);
+        int64_t e4 = e3 - (int64_t(x[i - 1]) - 3 * int64_t(x[i - 2]) +
+                           3 * int64_t(x[i - 3]) - x[i - 4]);
+        sum[0] += std::llabs(e0);
+        sum[1] += std::llabs(e1);
+        sum[2] += std::llabs(e2);
+        sum[3] += std::llabs(e3);
+        sum[4] += std::llabs(e4);
+    }
+
+    int order = 0;
+    for (int i = 1; i <= 4; ++i)
+    {
+        if (sum[i] < sum[order])
+            order = i;
+    }
+    if (n <= size_t(order))
+        order = 0;
+    return order;
+}
+
+// LPC residuals; false if a residual is out of range
+inline bool pcm_lossless_lpc_residual(const int32_t *x, size_t n, const int32_t *coef,
+                                      int order, int shift, int32_t *res)
+{
+    for (size_t i = order; i < n; ++i)
+    {
+        int64_t sum = 0;
+        for (int j = 0; j < order; ++j)
+            sum += int64_t(coef[j]) * x[i - 1 - j];
+        int64_t e = x[i] - (sum >> shift);
+        if (e < -(int64_t(1) << 30) || e >= (int64_t(1) << 30))
+            return false;
+        res[i - order] = int32_t(e);
+    }
+    return true;
+}
+
+inline void pcm_lossless_lpc_restore(int32_t *x, size_t n, const int32_t *coef,
+                                     int order, int shift, const int32_t *res)
+{
+    for (size_t i = order; i < n; ++i)
+    {
+        int64_t sum = 0;
+        for (int j = 0; j < order; ++j)
+            sum += int64_t(coef[j]) * x[i - 1 - j];
+        x[i] = int32_t(res[i - order] + (sum >> shift));
+    }
+}
+
+// lpc[(order - 1) * MAX_ORDER + j] for each order; returns the highest
+// order solved
+inline int pcm_lossless_lpc_analyze(const int32_t *x, size_t n, double *lpc)
+{
+    const int max_order = PCM_LOSSLESS_MAX_ORDER;
+    if (n <= size_t(max_order) * 2)
+        return 0;
+
+    // autocorrelation of the Welch-windowed block
+    std::vector<double> w(n);
+    const double half = (n - 1) / 2.0;
+    for (size_t i = 0; i < n; ++i)
+    {
+        double t = (i - half) / half;
+        w[i] = x[i] * (1.0 - t * t);
+    }
+    double r[PCM_LOSSLESS_MAX_ORDER + 1];
+    for (int lag = 0; lag <= max_order; ++lag)
+    {
+        double sum = 0;
+        for (size_t i = lag; i < n; ++i)
+            sum += w[i] * w[i - lag];
+        r[lag] = sum;
+    }
+    if (r[0] <= 0)
+        return 0;
+    r[0] *= 1.0 + 1e-9;
+
+    // Levinson-Durbin
+    double a[PCM_LOSSLESS_MAX_ORDER], prev[PCM_LOSSLESS_MAX_ORDER];
+    double err = r[0];
+    for (int m = 0; m < max_order; ++m)
+    {
+        double acc = r[m + 1];
+        for (int j = 0; j < m; ++j)
+            acc -= a[j] * r[m - j];
+        double k = acc / err;
+
+        std::memcpy(prev, a, sizeof(double) * m);
+        for (int j = 0; j < m; ++j)
+            a[j] = prev[j] - k * prev[m - 1 - j];
+        a[m] = k;
+
+        err *= 1.0 - k * k;
+        for (int j = 0; j <= m; ++j)
+            lpc[m * max_order + j] = a[j];
+        if (err <= 0)
+            return m + 1;
+    }
+    return max_order;
+}
+
+// quantizes the coefficients; false if they are too large
+inline bool pcm_lossless_lpc_quantize(const double *lpc, int order, int32_t *coef, int *shift)
+{
+    double cmax = 0;
+    for (int j = 0; j < order; ++j)
+    {
+        if (cmax < std::fabs(lpc[j]))
+            cmax = std::fabs(lpc[j]);
+    }
+    if (cmax <= 0)
+        return false;
+
+    int exponent;
+    std::frexp(cmax, &exponent);    // cmax < 2 ** exponent
+    int s = PCM_LOSSLESS_PRECISION - 1 - exponent;
+    if (s < 0)
+        return false;
+    if (s > 15)
+        s = 15;
+
+    const int32_t qmax = (1 << (PCM_LOSSLESS_PRECISION - 1)) - 1;
+    double error = 0;
+    for (int j = 0; j < order; ++j)
+    {
+        double value = lpc[j] * (1 << s) + error;
+        long q = std::lround(value);
+        if (q > qmax)
+            q = qmax;
+        if (q < -qmax - 1)
+            q = -qmax - 1;
+        error = value - q;
+        coef[j] = int32_t(q);
+    }
+    *shift = s;
+    return true;
+}
+
+// writes a channel of width bits
+inline void pcm_lossless_encode_subframe(PcmBitWriter& bw, const int32_t *x, size_t n, int width)
+{
+    size_t i;
+    for (i = 1; i < n; ++i)
+    {
+        if (x[i] != x[0])
+            break;
+    }
+    if (i >= n)
+    {
+        bw.put(PCM_LOSSLESS_CONSTANT, 2);
+        bw.put_signed(x[0], width);
+        return;
+    }
+
+    std::vector<uint32_t> work;
+    std::vector<int32_t> res(n), best_res;
+
+    // the fixed predictor
+    int fixed = pcm_lossless_fixed_order(x, n);
+    pcm_lossless_fixed_residual(x, n, fixed, &res[0]);
+    uint64_t best_cost = 3 + uint64_t(fixed) * width +
+                         pcm_lossless_rice_cost(&res[0], n - fixed, work);
+    int type = PCM_LOSSLESS_FIXED;
+    int order = fixed;
+    best_res.swap(res);
+    res.resize(n);
+
+    // LPC of some orders
+    double lpc[PCM_LOSSLESS_MAX_ORDER * PCM_LOSSLESS_MAX_ORDER];
+    int32_t coef[PCM_LOSSLESS_MAX_ORDER], best_coef[PCM_LOSSLESS_MAX_ORDER];
+    int shift = 0;
+    int solved = pcm_lossless_lpc_analyze(x, n, lpc);
+    static const int orders[] = { 2, 4, 8, PCM_LOSSLESS_MAX_ORDER };
+    for (int m : orders)
+    {
+        if (m > solved)
+            break;
+        int s;
+        if (!pcm_lossless_lpc_quantize(&lpc[(m - 1) * PCM_LOSSLESS_MAX_ORDER], m, coef, &s))
+            continue;
+        if (!pcm_lossless_lpc_residual(x, n, coef, m, s, &res[0]))
+            continue;
+        uint64_t cost = 8 + uint64_t(m) * (PCM_LOSSLESS_PRECISION + width) +
+                        pcm_lossless_rice_cost(&res[0], n - m, work);
+        if (cost < best_cost)
+        {
+            best_cost = cost;
+            type = PCM_LOSSLESS_LPC;
+            order = m;
+            shift = s;
+            std::memcpy(best_coef, coef, sizeof(coef));
+            best_res.swap(res);
+        }
+    }
+
+    if (uint64_t(n) * width <= best_cost)
+    {
+        bw.put(PCM_LOSSLESS_VERBATIM, 2);
+        for (i = 0; i < n; ++i)
+            bw.put_signed(x[i], width);
+        return;
+    }
+
+    bw.put(type, 2);
+    if (type == PCM_LOSSLESS_FIXED)
+    {
+        bw.put(order, 3);
+    }
+    else
+    {
+        bw.put(order - 1, 4);
+        bw.put(shift, 4);
+        for (int j = 0; j < order; ++j)
+            bw.put_signed(best_coef[j], PCM_LOSSLESS_PRECISION);
+    }
+    for (int j = 0; j < order; ++j)
+        bw.put_signed(x[j], width);
+    pcm_lossless_put_rice(bw, &best_res[0], n - order, work);
+}
+
+inline bool pcm_lossless_decode_subframe(PcmBitReader& br, int32_t *x, size_t n, int width)
+{
+    std::vector<int32_t> res;
+    int32_t coef[PCM_LOSSLESS_MAX_ORDER];
+    int order, shift = 0;
+
+    int type = int(br.get(2));
+    switch (type)
+    {
+    case PCM_LOSSLESS_CONSTANT:
+        x[0] = br.get_signed(width);
+        for (size_t i = 1; i < n; ++i)
+            x[i] = x[0];
+        return !br.error();
+    case PCM_LOSSLESS_VERBATIM:
+        for (size_t i = 0; i < n; ++i)
+            x[i] = br.get_signed(width);
+        return !br.error();
+    case PCM_LOSSLESS_FIXED:
+        order = int(br.get(3));
+        if (order > 4)
+            return false;
+        break;
+    default:
+        order = int(br.get(4)) + 1;
+        shift = int(br.get(4));
+        if (order > PCM_LOSSLESS_MAX_ORDER)
+            return false;
+        for (int j = 0; j < order; ++j)
+            coef[j] = br.get_signed(PCM_LOSSLESS_PRECISION);
+        break;
+    }
+
+    if (size_t(order) > n)
+        return false;
+    for (int j = 0; j < order; ++j)
+        x[j] = br.get_signed(width);
+    res.resize(n - order + 1);
+    if (!pcm_lossless_get_rice(br, &res[0], n - order))
+        return false;
+
+    if (type == PCM_LOSSLESS_FIXED)
+        pcm_lossless_fixed_restore(x, n, order, &res[0]);
+    else
+        pcm_lossless_lpc_restore(x, n, coef, order, shift, &res[0]);
+    return true;
+}
+
+// the sum of the second-order residuals, to choose a stereo mode
+inline uint64_t pcm_lossless_stereo_cost(const int32_t *x, size_t n)
+{
+    uint64_t sum = 0;
+    for (size_t i = 2; i < n; ++i)
+        sum += std::llabs(int64_t(x[i]) - 2 * int64_t(x[i - 1]) + x[i - 2]);
+    return sum;
+}
+
+// appends the payload of a block of interleaved samples
+inline void pcm_lossless_encode_block(const uint8_t *pcm, size_t frames, int channels,
+                                      int bits, std::vector<uint8_t>& out)
+{
+    const int width = bits;
+    std::vector<int32_t> x(frames * channels);
+    for (int ch = 0; ch < channels; ++ch)
+    {
+        int32_t *dest = &x[ch * frames];
+        if (bits == 8)
+        {
+            for (size_t i = 0; i < frames; ++i)
+                dest[i] = int32_t(pcm[i * channels + ch]) - 128;
+        }
+        else
+        {
+            const int16_t *src = reinterpret_cast<const int16_t *>(pcm);
+            for (size_t i = 0; i < frames; ++i)
+                dest[i] = src[i * channels + ch];
+        }
+    }
+
+    PcmBitWriter bw(out);
+    if (channels != 2)
+    {
+        for (int ch = 0; ch < channels; ++ch)
+            pcm_lossless_encode_subframe(bw, &x[ch * frames], frames, width);
+        bw.flush();
+        return;
+    }
+
+    const int32_t *left = &x[0], *right = &x[frames];
+    std::vector<int32_t> mid(frames), side(frames);
+    for (size_t i = 0; i < frames; ++i)
+    {
+        mid[i] = (left[i] + right[i]) >> 1;
+        side[i] = left[i] - right[i];
+    }
+
+    uint64_t l = pcm_lossless_stereo_cost(left, frames);
+    uint64_t r = pcm_lossless_stereo_cost(right, frames);
+    uint64_t m = pcm_lossless_stereo_cost(&mid[0], frames);
+    uint64_t s = pcm_lossless_stereo_cost(&side[0], frames);
+    uint64_t costs[4] = { l + r, l + s, s + r, m + s };
+    int mode = PCM_LOSSLESS_LEFT_RIGHT;
+    for (int i = 1; i < 4; ++i)
+    {
+        if (costs[i] < costs[mode])
+            mode = i;
+    }
+
+    bw.put(mode, 2);
+    switch (mode)
+    {
+    case PCM_LOSSLESS_LEFT_RIGHT:
+        pcm_lossless_encode_subframe(bw, left, frames, width);
+        pcm_lossless_encode_subframe(bw, right, frames, width);
+        break;
+    case PCM_LOSSLESS_LEFT_SIDE:
+        pcm_lossless_encode_subframe(bw, left, frames, width);
+        pcm_lossless_encode_subframe(bw, &side[0], frames, width + 1);
+        break;
+    case PCM_LOSSLESS_SIDE_RIGHT:
+        pcm_lossless_encode_subframe(bw, &side[0], frames, width + 1);
+        pcm_lossless_encode_subframe(bw, right, frames, width);
+        break;
+    default:
+        pcm_lossless_encode_subframe(bw, &mid[0], frames, width);
+        pcm_lossless_encode_subframe(bw, &side[0], frames, width + 1);
+        break;
+    }
+    bw.flush();
+}
+
+// decodes a payload into frames of interleaved samples
+inline bool pcm_lossless_decode_block(const uint8_t *payload, size_t size, size_t frames,
+                                      int channels, int bits, uint8_t *pcm)
+{
+    const int width = bits;
+    std::vector<int32_t> x(frames * channels);
+    PcmBitReader br(payload, size);
+
+    if (channels != 2)
+    {
+        for (int ch = 0; ch < channels; ++ch)
+        {
+            if (!pcm_lossless_decode_subframe(br, &x[ch * frames], frames, width))
+                return false;
+        }
+    }
+    else
+    {
+        int32_t *a = &x[0], *b = &x[frames];
+        int mode = int(br.get(2));
+        int wa = (mode == PCM_LOSSLESS_SIDE_RIGHT) ? width + 1 : width;
+        int wb = (mode == PCM_LOSSLESS_LEFT_RIGHT || mode == PCM_LOSSLESS_SIDE_RIGHT) ? width : width + 1;
+        if (!pcm_lossless_decode_subframe(br, a, frames, wa) ||
+            !pcm_lossless_decode_subframe(br, b, frames, wb))
+        {
+            return false;
+        }
+
+        for (size_t i = 0; i < frames; ++i)
+        {
+            int32_t left, right;
+            switch (mode)
+            {
+            case PCM_LOSSLESS_LEFT_RIGHT:
+                left = a[i];
+                right = b[i];
+                break;
+            case PCM_LOSSLESS_LEFT_SIDE:
+                left = a[i];
+                right = a[i] - b[i];
+                break;
+            case PCM_LOSSLESS_SIDE_RIGHT:
+                left = a[i] + b[i];
+                right = b[i];
+                break;
+            default:
+                left = (a[i] * 2 + (b[i] & 1) + b[i]) >> 1;
+                right = left - b[i];
+                break;
+            }
+            a[i] = left;
+            b[i] = right;
+        }
+    }
+
+    for (int ch = 0; ch < channels; ++ch)
+    {
+        const int32_t *src = &x[ch * frames];
+        if (bits == 8)
+        {
+            for (size_t i = 0; i < frames; ++i)
+                pcm[i * channels + ch] = uint8_t(src[i] + 128);
+        }
+        else
+        {
+            int16_t *dest = reinterpret_cast<int16_t *>(pcm);
+            for (size_t i = 0; i < frames; ++i)
+                dest[i * channels + ch] = int16_t(src[i]);
+        }
+    }
+    return true;
+}
+
+#endif  // ndef PCM_LOSSLESS_HPP_
@@ -0,0 +1,220 @@
+#ifndef PCM_PARALLEL_HPP_
+#define PCM_PARALLEL_HPP_     2   /* Version 2 */
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+#include "PcmTrace.hpp"
+
+// The work [0, count) is cut into chunks of grain items. The chunking does
+// not depend on the number of threads, so a reduction that combines the
+// per-chunk results in chunk order gives the same result on any machine.
+// The threads come from a pool that lives as long as the process, so a
+// call costs a wake-up rather than thread creation.
+
+inline size_t pcm_parallel_num_chunks(size_t count, size_t grain)
+{
+    if (grain == 0)
+        grain = 1;
+    return (count + grain - 1) / grain;
+}
+
+inline size_t pcm_parallel_num_threads()
+{
+    size_t n = std::thread::hardware_concurrency();
+    return n ? n : 1;
+}
+
+// true on a thread that runs a task of the pool, where a nested parallel
+// loop runs serially
+inline bool& pcm_parallel_nested()
+{
+    static thread_local bool nested = false;
+    return nested;
+}
+
+// The helper threads of pcm_parallel_for. run() lends up to helpers of them
+// to a task, which the calling thread runs too, and returns when every
+// copy of the task has returned. The task hands out the work itself, so a
+// helper that wakes up late finds nothing left and is not waited for.
+// An exception thrown by a copy of the task is rethrown by run(), after
+// every copy has returned.
+class PcmThreadPool
+{
+public:
+    explicit PcmThreadPool(size_t helpers)
+        : m_task(NULL), m_wanted(0), m_running(0), m_generation(0), m_quit(false), m_error()
+    {
+        m_threads.reserve(helpers);
+        for (size_t i = 0; i < helpers; ++i)
+        {
+            m_threads.emplace_back([this]() { loop(); });
+        }
+    }
+
+    ~PcmThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_quit = true;
+        }
+        m_wake.notify_all();
+        for (auto& th : m_threads)
+        {
+            th.join();
+        }
+    }
+
+    size_t num_helpers() const
+    {
+        return m_threads.size();
+    }
+
+    void run(size_t helpers, const std::function<void()>& task)
+    {
+        // one task at a time; another caller waits for its turn
+        std::lock_guard<std::mutex> turn(m_turn);
+        if (helpers > m_threads.size())
+            helpers = m_threads.size();
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_task = &task;
+            m_wanted = helpers;
+            ++m_generation;
+        }
+        m_wake.notify_all();
+
+        pcm_parallel_nested() = true;
+        std::exception_ptr error = call(task);
+        pcm_parallel_nested() = false;
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_wanted = 0;   // the work is done; cancel the helpers not yet started
+        m_done.wait(lock, [this]() { return m_running == 0; });
+        m_task = NULL;
+        if (!error)
+            error = m_error;
+        m_error = std::exception_ptr();
+        lock.unlock();
+
+        if (error)
+            std::rethrow_exception(error);
+    }
+
+protected:
+    std::vector<std::thread> m_threads;
+    std::mutex m_turn;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_done;
+    const std::function<void()> *m_task;
+    size_t m_wanted;        // helpers still to start
+    size_t m_running;       // helpers in the task
+    uint64_t m_generation;
+    bool m_quit;
+    std::exception_ptr m_error;     // the first exception of a helper
+
+    static std::exception_ptr call(const std::function<void()>& task)
+    {
+        try
+        {
+            task();
+        }
+        catch (...)
+        {
+            return std::current_exception();
+        }
+        return std::exception_ptr();
+    }
+
+    void loop()
+    {
+        pcm_parallel_nested() = true;
+        uint64_t seen = 0;
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (;;)
+        {
+            m_wake.wait(lock, [&]() { return m_quit || (m_wanted > 0 && m_generation != seen); });
+            if (m_quit)
+                break;
+            seen = m_generation;
+            --m_wanted;
+            ++m_running;
+            const std::function<void()> *task = m_task;
+
+            lock.unlock();
+            std::exception_ptr error = call(*task);
+            lock.lock();
+
+            if (error && !m_error)
+                m_error = error;
+            if (--m_running == 0)
+                m_done.notify_all();
+        }
+    }
+}; // class PcmThreadPool
+
+// the pool of the process, started on first use
+inline PcmThreadPool& pcm_thread_pool()
+{
+    static PcmThreadPool pool(pcm_parallel_num_threads() - 1);
+    return pool;
+}
+
+// Calls fn(chunk, begin, end) for each chunk, on as many threads as useful.
+template <typename FN>
+inline void pcm_parallel_for(size_t count, size_t grain, FN fn)
+{
+    if (grain == 0)
+        grain = 1;
+
+    size_t chunks = pcm_parallel_num_chunks(count, grain);
+    size_t threads = pcm_parallel_num_threads();
+    if (threads > chunks)
+        threads = chunks;
+
+    if (threads <= 1 || pcm_parallel_nested())
+    {
+        for (size_t i = 0; i < chunks; ++i)
+        {
+            size_t begin = i * grain;
+            size_t end = (begin + grain < count) ? begin + grain : count;
+            fn(i, begin, end);
+        }
+        return;
+    }
+
+    std::atomic<size_t> next(0);
+    std::function<void()> worker = [&]()
+    {
+        PCM_TRACE_SCOPE("pcm_parallel_for");
+        for (;;)
+        {
+            size_t i = next++;
+            if (i >= chunks)
+                break;
+            size_t begin = i * grain;
+            size_t end = (begin + grain < count) ? begin + grain : count;
+            try
+            {
+                fn(i, begin, end);
+            }
+            catch (...)
+            {
+                next = chunks;  // the other threads stop at their next chunk
+                throw;
+            }
+        }
+    };
+
+    pcm_thread_pool().run(threads - 1, worker);
+}
+
+#endif  // ndef PCM_PARALLEL_HPP_
@@ -0,0 +1,414 @@
+#ifndef PCM_PLAY_HPP_
+#define PCM_PLAY_HPP_     1   /* Version 1 */
+
+#include "PcmWave.hpp"
+#include <cstddef>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#ifdef PCM_PLAY_ALSA
+    #include <alsa/asoundlib.h>
+#endif
+
+// Single-producer/single-consumer lock-free ring buffer of bytes. The
+// capacity is a power of two; the head and the tail count bytes forever
+// and are masked on access, so full and empty are told apart without a
+// spare slot. Each index sits on its own cache line.
+class PcmRingBuffer
+{
+public:
+    explicit PcmRingBuffer(size_t capacity)
+    {
+        size_t n = 1;
+        while (n < capacity)
+            n *= 2;
+        m_data.resize(n);
+        m_mask = n - 1;
+        m_head = 0;
+        m_tail = 0;
+    }
+
+    size_t capacity() const { return m_mask + 1; }
+    size_t size() const
+    {
+        return m_head.load(std::memory_order_acquire) -
+               m_tail.load(std::memory_order_acquire);
+    }
+    size_t space() const { return capacity() - size(); }
+
+    // producer only; returns the bytes written
+    size_t write(const void *data, size_t size)
+    {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        size_t tail = m_tail.load(std::memory_order_acquire);
+        size_t n = capacity() - (head - tail);
+        if (size > n)
+            size = n;
+        copy_in(head & m_mask, static_cast<const uint8_t *>(data), size);
+        m_head.store(head + size, std::memory_order_release);
+        return size;
+    }
+
+    // consumer only; returns the bytes read
+    size_t read(void *data, size_t size)
+    {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        size_t head = m_head.load(std::memory_order_acquire);
+        size_t n = head - tail;
+        if (size > n)
+            size = n;
+        copy_out(tail & m_mask, static_cast<uint8_t *>(data), size);
+        m_tail.store(tail + size, std::memory_order_release);
+        return size;
+    }
+
+protected:
+    std::vector<uint8_t> m_data;
+    size_t m_mask;
+    alignas(64) std::atomic<size_t> m_head;     // written by the producer
+    alignas(64) std::atomic<size_t> m_tail;     // written by the consumer
+
+    void copy_in(size_t pos, const uint8_t *data, size_t size)
+    {
+        size_t first = capacity() - pos;
+        if (first > size)
+            first = size;
+        std::memcpy(&m_data[pos], data, first);
+        std::memcpy(&m_data[0], data + first, size - first);
+    }
+    void copy_out(size_t pos, uint8_t *data, size_t size) const
+    {
+        size_t first = capacity() - pos;
+        if (first > size)
+            first = size;
+        std::memcpy(data, &m_data[pos], first);
+        std::memcpy(data + first, &m_data[0], size - first);
+    }
+};
+
+// Sleeps so that the frames written so far take their real time.
+class PcmPacer
+{
+public:
+    typedef std::chrono::steady_clock clock_type;
+
+    void start(uint32_t rate)
+    {
+        m_rate = rate;
+        m_units = 0;
+        m_start = clock_type::now();
+    }
+    void wait(size_t units)
+    {
+        m_units += units;
+        std::this_thread::sleep_until(m_start +
+            std::chrono::microseconds(m_units * 1000000 / m_rate));
+    }
+
+protected:
+    uint32_t m_rate = 1;
+    uint64_t m_units = 0;
+    clock_type::time_point m_start;
+};
+
+// The output of PcmPlayer. write() blocks while the sink cannot take more.
+class PcmSink
+{
+public:
+    virtual ~PcmSink() { }
+
+    virtual bool open(const PcmWave& format) = 0;
+    virtual bool write(const void *data, size_t size) = 0;
+    virtual bool close() = 0;
+
+    // true if it consumes at the sampling rate; false if it takes all it gets
+    virtual bool is_realtime() const = 0;
+    // frames written but not played yet
+    virtual uint64_t delay_units() const { return 0; }
+    // underruns the device reported itself
+    virtual uint64_t xruns() const { return 0; }
+};
+
+// Discards the samples, in real time unless realtime is false.
+class PcmNullSink : public PcmSink
+{
+public:
+    explicit PcmNullSink(bool realtime = true) : m_realtime(realtime), m_unit(1) { }
+
+    bool open(const PcmWave& format)
+    {
+        m_unit = format.data_unit();
+        m_pacer.start(format.sample_rate());
+        return true;
+    }
+    bool write(const void *data, size_t size)
+    {
+        (void)data;
+        if (m_realtime)
+            m_pacer.wait(size / m_unit);
+        return true;
+    }
+    bool close() { return true; }
+    bool is_realtime() const { return m_realtime; }
+
+protected:
+    bool m_realtime;
+    uint16_t m_unit;
+    PcmPacer m_pacer;
+};
+
+// Writes what would be played to a wave file, to check the output.
+class PcmFileSink : public PcmSink
+{
+public:
+    explicit PcmFileSink(std::FILE *fp, bool realtime = false)
+        : m_fp(fp), m_realtime(realtime), m_unit(1) { }
+
+    bool open(const PcmWave& format)
+    {
+        m_unit = format.data_unit();
+        m_pacer.start(format.sample_rate());
+        return m_writer.open(m_fp, format.num_channels(), format.mode(),
+                             format.sample_rate());
+    }
+    bool write(const void *data, size_t size)
+    {
+        if (!m_writer.write(data, size))
+            return false;
+        if (m_realtime)
+            m_pacer.wait(size / m_unit);
+        return true;
+    }
+    bool close() { return m_writer.close(); }
+    bool is_realtime() const { return m_realtime; }
+
+protected:
+    std::FILE *m_fp;
+    bool m_realtime;
+    uint16_t m_unit;
+    PcmPacer m_pacer;
+    PcmWaveWriter m_writer;
+};
+
+#ifdef PCM_PLAY_ALSA
+    // Plays on an ALSA device ("default" etc.); latency is in microseconds.
+    class PcmAlsaSink : public PcmSink
+    {
+    public:
+        explicit PcmAlsaSink(const char *device = "default", unsigned latency = 50000)
+            : m_device(device), m_latency(latency), m_pcm(NULL), m_unit(1), m_xruns(0) { }
+        ~PcmAlsaSink() { close(); }
+
+        bool open(const PcmWave& format)
+        {
+            if (!format.mode_8bit() && !format.mode_16bit())
+                return false;
+            if (snd_pcm_open(&m_pcm, m_device, SND_PCM_STREAM_PLAYBACK, 0) < 0)
+            {
+                m_pcm = NULL;
+                return false;
+            }
+            snd_pcm_format_t type = format.mode_8bit() ? SND_PCM_FORMAT_U8
+                                                       : SND_PCM_FORMAT_S16_LE;
+            m_unit = format.data_unit();
+            return snd_pcm_set_params(m_pcm, type, SND_PCM_ACCESS_RW_INTERLEAVED,
+                                      format.num_channels(), format.sample_rate(),
+                                      1, m_latency) == 0;
+        }
+        bool write(const void *data, size_t size)
+        {
+            const uint8_t *p = static_cast<const uint8_t *>(data);
+            snd_pcm_uframes_t left = size / m_unit;
+            while (left > 0)
+            {
+                snd_pcm_sframes_t n = snd_pcm_writei(m_pcm, p, left);
+                if (n < 0)
+                {
+                    if (n == -EPIPE)
+                        ++m_xruns;
+                    if (snd_pcm_recover(m_pcm, int(n), 1) < 0)
+                        return false;
+                    continue;
+                }
+                p += n * m_unit;
+                left -= n;
+            }
+            return true;
+        }
+        bool close()
+        {
+            if (!m_pcm)
+                return true;
+            snd_pcm_drain(m_pcm);
+            bool ok = snd_pcm_close(m_pcm) == 0;
+            m_pcm = NULL;
+            return ok;
+        }
+        bool is_realtime() const { return true; }
+        uint64_t delay_units() const
+        {
+            snd_pcm_sframes_t delay;
+            if (!m_pcm || snd_pcm_delay(m_pcm, &delay) < 0 || delay < 0)
+                return 0;
+            return uint64_t(delay);
+        }
+        uint64_t xruns() const { return m_xruns; }
+
+    protected:
+        const char *m_device;
+        unsigned m_latency;
+        snd_pcm_t *m_pcm;
+        uint16_t m_unit;
+        uint64_t m_xruns;
+    };
+#endif  // def PCM_PLAY_ALSA
+
+struct PcmPlayStats
+{
+    uint64_t units = 0;             // frames given to the sink, with silence
+    uint64_t periods = 0;
+    uint64_t underruns = 0;         // periods the ring buffer could not fill
+    uint64_t silence_units = 0;     // frames of silence for the underruns
+    uint64_t xruns = 0;             // underruns reported by the sink
+    double latency_min = 0;         // in seconds, from the ring buffer to
+    double latency_max = 0;         // the speaker, measured per period
+    double latency_sum = 0;
+
+    double latency_avg() const
+    {
+        return periods ? latency_sum / double(periods) : 0;
+    }
+};
+
+// Reads a PcmWaveReader on the calling thread into a ring buffer that a
+// playback thread drains into the sink, period by period. A real-time
+// sink that finds less than a period gets the rest as silence, which is
+// counted as an underrun.
+class PcmPlayer
+{
+public:
+    PcmPlayer(PcmSink& sink, size_t buffer_units, size_t period_units)
+        : m_sink(sink), m_buffer_units(buffer_units), m_period_units(period_units)
+    {
+        assert(period_units > 0 && period_units <= buffer_units);
+    }
+
+    bool play(PcmWaveReader& reader);
+    const PcmPlayStats& stats() const { return m_stats; }
+
+protected:
+    PcmSink& m_sink;
+    size_t m_buffer_units;
+    size_t m_period_units;
+    PcmPlayStats m_stats;
+
+    bool consume(PcmRingBuffer& ring, const PcmWave& format,
+                 const std::atomic<bool>& done);
+};
+
+inline bool PcmPlayer::play(PcmWaveReader& reader)
+{
+    const PcmWave& format = reader.header();
+    const size_t unit = format.data_unit();
+    m_stats = PcmPlayStats();
+
+    // the ring buffer is a power of two; fill it up to the buffer size only
+    const size_t limit = m_buffer_units * unit;
+    PcmRingBuffer ring(limit);
+    PcmWave block;
+
+    // prefill, so that the playback does not start with an underrun
+    while (limit - ring.size() >= m_period_units * unit &&
+           reader.read(block, m_period_units) > 0)
+    {
+        ring.write(&block.data_8bit(0), block.size());
+    }
+
+    if (!m_sink.open(format))
+        return false;
+
+    std::atomic<bool> done(reader.eof());
+    std::atomic<bool> ok(true);
+    std::thread consumer([&]()
+    {
+        ok = consume(ring, format, done);
+    });
+
+    const auto nap = std::chrono::microseconds(
+        uint64_t(m_period_units) * 1000000 / format.sample_rate() / 4 + 1);
+    while (!done && ok && reader.read(block, m_period_units) > 0)
+    {
+        const uint8_t *p = &block.data_8bit(0);
+        size_t left = block.size();
+        while (left > 0 && ok)
+        {
+            size_t room = limit - ring.size();
+            size_t n = ring.write(p, (left < room) ? left : room);
+            p += n;
+            left -= n;
+            if (left > 0)
+                std::this_thread::sleep_for(nap);
+        }
+    }
+    done = true;
+    consumer.join();
+
+    m_stats.xruns = m_sink.xruns();
+    return m_sink.close() && ok;
+}
+
+inline bool PcmPlayer::consume(PcmRingBuffer& ring, const PcmWave& format,
+                               const std::atomic<bool>& done)
+{
+    const size_t unit = format.data_unit();
+    const size_t period = m_period_units * unit;
+    const double rate = format.sample_rate();
+    const uint8_t silence = format.mode_8bit() ? 0x80 : 0;
+    std::vector<uint8_t> buf(period);
+
+    for (;;)
+    {
+        size_t avail = ring.size();
+        if (avail < period && !m_sink.is_realtime())
+        {
+            // a file does not starve; wait for the producer
+            while ((avail = ring.size()) < period && !done)
+                std::this_thread::yield();
+        }
+
+        bool finished = done;
+        avail = ring.size();
+        if (avail == 0 && finished)
+            return true;
+
+        // the newest frame waits for the ring buffer and the sink's queue
+        double latency = (double(avail / unit) + double(m_sink.delay_units())) / rate;
+        if (m_stats.periods == 0 || latency < m_stats.latency_min)
+            m_stats.latency_min = latency;
+        if (latency > m_stats.latency_max)
+            m_stats.latency_max = latency;
+        m_stats.latency_sum += latency;
+
+        // the producer may have written a part of a frame
+        size_t got = avail - avail % unit;
+        if (got > period)
+            got = period;
+        got = ring.read(&buf[0], got);
+        size_t size = got;
+        if (got < period && !finished)
+        {
+            std::memset(&buf[got], silence, period - got);
+            size = period;
+            ++m_stats.underruns;
+            m_stats.silence_units += (period - got) / unit;
+        }
+
+        if (!m_sink.write(&buf[0], size))
+            return false;
+        ++m_stats.periods;
+        m_stats.units += size / unit;
+    }
+}
+
+#endif  // ndef PCM_PLAY_HPP_
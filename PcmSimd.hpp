@@ -0,0 +1,368 @@
+#ifndef PCM_SIMD_HPP_
+#define PCM_SIMD_HPP_     2   /* Version 2 */
+
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define PCM_SIMD_SSE2
+    #include <emmintrin.h>
+#endif
+
+// Sample kernels for 8-bit unsigned and 16-bit signed PCM. They use SSE2
+// where available, and a scalar loop for the rest of the buffer.
+// 8-bit samples are centered at 128.
+
+struct PcmLevel
+{
+    uint32_t peak = 0;      // max. absolute value
+    uint64_t sum2 = 0;      // sum of squares
+    uint64_t count = 0;     // number of samples
+
+    void add(const PcmLevel& other)
+    {
+        if (peak < other.peak)
+            peak = other.peak;
+        sum2 += other.sum2;
+        count += other.count;
+    }
+
+    // relative to full scale (1.0)
+    double peak_ratio(uint16_t bits) const
+    {
+        return double(peak) / (bits == 8 ? 128 : 32768);
+    }
+    double rms_ratio(uint16_t bits) const
+    {
+        if (count == 0)
+            return 0;
+        return std::sqrt(double(sum2) / double(count)) / (bits == 8 ? 128 : 32768);
+    }
+};
+
+inline void pcm_scan_sample(int value, PcmLevel& level)
+{
+    uint32_t a = (value < 0) ? -value : value;
+    if (level.peak < a)
+        level.peak = a;
+    level.sum2 += uint32_t(value * value);
+}
+
+#ifdef PCM_SIMD_SSE2
+    // v: 8 x int16
+    inline void pcm_scan_8x16(__m128i v, __m128i& vmin, __m128i& vmax, __m128i& sum2)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        vmin = _mm_min_epi16(vmin, v);
+        vmax = _mm_max_epi16(vmax, v);
+        // each 32-bit lane is at most 2 * 32768^2, which fits into uint32
+        __m128i sq = _mm_madd_epi16(v, v);
+        sum2 = _mm_add_epi64(sum2, _mm_unpacklo_epi32(sq, zero));
+        sum2 = _mm_add_epi64(sum2, _mm_unpackhi_epi32(sq, zero));
+    }
+
+    inline void pcm_scan_finish(__m128i vmin, __m128i vmax, __m128i sum2, size_t count,
+                                PcmLevel& level)
+    {
+        int16_t mins[8], maxs[8];
+        uint64_t sums[2];
+        _mm_storeu_si128((__m128i *)mins, vmin);
+        _mm_storeu_si128((__m128i *)maxs, vmax);
+        _mm_storeu_si128((__m128i *)sums, sum2);
+        for (int k = 0; k < 8; ++k)
+        {
+            // vmin <= 0 <= vmax
+            uint32_t a = uint32_t(-int(mins[k]));
+            uint32_t b = uint32_t(maxs[k]);
+            if (level.peak < a)
+                level.peak = a;
+            if (level.peak < b)
+                level.peak = b;
+        }
+        level.sum2 += sums[0] + sums[1];
+        level.count += count;
+    }
+#endif
+
+inline void pcm_scan_8bit(const uint8_t *data, size_t count, PcmLevel& level)
+{
+    PcmLevel local;
+    size_t i = 0;
+#ifdef PCM_SIMD_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i bias = _mm_set1_epi16(128);
+    __m128i vmin = zero, vmax = zero, sum2 = zero;
+    for (; i + 16 <= count; i += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(data + i));
+        pcm_scan_8x16(_mm_sub_epi16(_mm_unpacklo_epi8(v, zero), bias), vmin, vmax, sum2);
+        pcm_scan_8x16(_mm_sub_epi16(_mm_unpackhi_epi8(v, zero), bias), vmin, vmax, sum2);
+    }
+    pcm_scan_finish(vmin, vmax, sum2, i, local);
+#endif
+    for (; i < count; ++i)
+    {
+        pcm_scan_sample(int(data[i]) - 128, local);
+        ++local.count;
+    }
+    level.add(local);
+}
+
+inline void pcm_scan_16bit(const int16_t *data, size_t count, PcmLevel& level)
+{
+    PcmLevel local;
+    size_t i = 0;
+#ifdef PCM_SIMD_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    __m128i vmin = zero, vmax = zero, sum2 = zero;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(data + i));
+        pcm_scan_8x16(v, vmin, vmax, sum2);
+    }
+    pcm_scan_finish(vmin, vmax, sum2, i, local);
+#endif
+    for (; i < count; ++i)
+    {
+        pcm_scan_sample(data[i], local);
+        ++local.count;
+    }
+    level.add(local);
+}
+
+// Multiplies samples by gain, rounding to nearest and saturating.
+
+inline int pcm_gain_sample(int value, float gain, float lo, float hi)
+{
+    float x = value * gain;
+    if (x < lo)
+        x = lo;
+    if (x > hi)
+        x = hi;
+    return int(std::nearbyint(x));
+}
+
+#ifdef PCM_SIMD_SSE2
+    // v: 8 x int16 --> 8 x int16 clamped to [lo, hi]
+    inline __m128i pcm_gain_8x16(__m128i v, __m128 g, __m128 lo, __m128 hi)
+    {
+        __m128i a = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        __m128i b = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+        __m128 fa = _mm_mul_ps(_mm_cvtepi32_ps(a), g);
+        __m128 fb = _mm_mul_ps(_mm_cvtepi32_ps(b), g);
+        fa = _mm_min_ps(_mm_max_ps(fa, lo), hi);
+        fb = _mm_min_ps(_mm_max_ps(fb, lo), hi);
+        return _mm_packs_epi32(_mm_cvtps_epi32(fa), _mm_cvtps_epi32(fb));
+    }
+#endif
+
+inline void pcm_gain_8bit(uint8_t *data, size_t count, float gain)
+{
+    size_t i = 0;
+#ifdef PCM_SIMD_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i bias = _mm_set1_epi16(128);
+    const __m128 g = _mm_set1_ps(gain);
+    const __m128 lo = _mm_set1_ps(-128.0f), hi = _mm_set1_ps(127.0f);
+    for (; i + 16 <= count; i += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(data + i));
+        __m128i a = _mm_sub_epi16(_mm_unpacklo_epi8(v, zero), bias);
+        __m128i b = _mm_sub_epi16(_mm_unpackhi_epi8(v, zero), bias);
+        a = _mm_add_epi16(pcm_gain_8x16(a, g, lo, hi), bias);
+        b = _mm_add_epi16(pcm_gain_8x16(b, g, lo, hi), bias);
+        _mm_storeu_si128((__m128i *)(data + i), _mm_packus_epi16(a, b));
+    }
+#endif
+    for (; i < count; ++i)
+    {
+        data[i] = uint8_t(pcm_gain_sample(int(data[i]) - 128, gain, -128.0f, 127.0f) + 128);
+    }
+}
+
+inline void pcm_gain_16bit(int16_t *data, size_t count, float gain)
+{
+    size_t i = 0;
+#ifdef PCM_SIMD_SSE2
+    const __m128 g = _mm_set1_ps(gain);
+    const __m128 lo = _mm_set1_ps(-32768.0f), hi = _mm_set1_ps(32767.0f);
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(data + i));
+        _mm_storeu_si128((__m128i *)(data + i), pcm_gain_8x16(v, g, lo, hi));
+    }
+#endif
+    for (; i < count; ++i)
+    {
+        data[i] = int16_t(pcm_gain_sample(data[i], gain, -32768.0f, 32767.0f));
+    }
+}
+
+// The min. and the max. of each channel of interleaved frames, into
+// mins[channel] and maxs[channel], which are updated. 8-bit samples give
+// centered values. SSE2 is used for 1 or 2 channels, where each lane keeps
+// to one channel.
+
+inline void pcm_minmax_sample(int value, int& vmin, int& vmax)
+{
+    if (vmin > value)
+        vmin = value;
+    if (vmax < value)
+        vmax = value;
+}
+
+inline void pcm_minmax_8bit(const uint8_t *data, size_t frames, int channels, int *mins, int *maxs)
+{
+    size_t count = frames * channels, i = 0;
+#ifdef PCM_SIMD_SSE2
+    if ((channels == 1 || channels == 2) && count >= 16)
+    {
+        __m128i vmin = _mm_set1_epi8(char(0xFF)), vmax = _mm_setzero_si128();
+        for (; i + 16 <= count; i += 16)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i *)(data + i));
+            vmin = _mm_min_epu8(vmin, v);
+            vmax = _mm_max_epu8(vmax, v);
+        }
+        uint8_t lo[16], hi[16];
+        _mm_storeu_si128((__m128i *)lo, vmin);
+        _mm_storeu_si128((__m128i *)hi, vmax);
+        for (int k = 0; k < 16; ++k)
+        {
+            pcm_minmax_sample(int(lo[k]) - 128, mins[k % channels], maxs[k % channels]);
+            pcm_minmax_sample(int(hi[k]) - 128, mins[k % channels], maxs[k % channels]);
+        }
+    }
+#endif
+    for (; i < count; ++i)
+    {
+        pcm_minmax_sample(int(data[i]) - 128, mins[i % channels], maxs[i % channels]);
+    }
+}
+
+inline void pcm_minmax_16bit(const int16_t *data, size_t frames, int channels, int *mins, int *maxs)
+{
+    size_t count = frames * channels, i = 0;
+#ifdef PCM_SIMD_SSE2
+    if ((channels == 1 || channels == 2) && count >= 8)
+    {
+        __m128i vmin = _mm_set1_epi16(32767), vmax = _mm_set1_epi16(-32768);
+        for (; i + 8 <= count; i += 8)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i *)(data + i));
+            vmin = _mm_min_epi16(vmin, v);
+            vmax = _mm_max_epi16(vmax, v);
+        }
+        int16_t lo[8], hi[8];
+        _mm_storeu_si128((__m128i *)lo, vmin);
+        _mm_storeu_si128((__m128i *)hi, vmax);
+        for (int k = 0; k < 8; ++k)
+        {
+            pcm_minmax_sample(lo[k], mins[k % channels], maxs[k % channels]);
+            pcm_minmax_sample(hi[k], mins[k % channels], maxs[k % channels]);
+        }
+    }
+#endif
+    for (; i < count; ++i)
+    {
+        pcm_minmax_sample(data[i], mins[i % channels], maxs[i % channels]);
+    }
+}
+
+// Mixing into float accumulators: acc[i] += gain * sample[i].
+// pcm_store_* rounds the accumulators back with saturation.
+
+inline void pcm_mix_8bit(float *acc, const uint8_t *data, size_t count, float gain)
+{
+    size_t i = 0;
+#ifdef PCM_SIMD_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i bias = _mm_set1_epi16(128);
+    const __m128 g = _mm_set1_ps(gain);
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128i v = _mm_loadl_epi64((const __m128i *)(data + i));
+        v = _mm_sub_epi16(_mm_unpacklo_epi8(v, zero), bias);
+        __m128i a = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        __m128i b = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+        _mm_storeu_ps(acc + i, _mm_add_ps(_mm_loadu_ps(acc + i), _mm_mul_ps(_mm_cvtepi32_ps(a), g)));
+        _mm_storeu_ps(acc + i + 4, _mm_add_ps(_mm_loadu_ps(acc + i + 4), _mm_mul_ps(_mm_cvtepi32_ps(b), g)));
+    }
+#endif
+    for (; i < count; ++i)
+    {
+        acc[i] += gain * float(int(data[i]) - 128);
+    }
+}
+
+inline void pcm_mix_16bit(float *acc, const int16_t *data, size_t count, float gain)
+{
+    size_t i = 0;
+#ifdef PCM_SIMD_SSE2
+    const __m128 g = _mm_set1_ps(gain);
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(data + i));
+        __m128i a = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        __m128i b = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+        _mm_storeu_ps(acc + i, _mm_add_ps(_mm_loadu_ps(acc + i), _mm_mul_ps(_mm_cvtepi32_ps(a), g)));
+        _mm_storeu_ps(acc + i + 4, _mm_add_ps(_mm_loadu_ps(acc + i + 4), _mm_mul_ps(_mm_cvtepi32_ps(b), g)));
+    }
+#endif
+    for (; i < count; ++i)
+    {
+        acc[i] += gain * float(data[i]);
+    }
+}
+
+inline int pcm_store_sample(float x, float lo, float hi)
+{
+    if (x < lo)
+        x = lo;
+    if (x > hi)
+        x = hi;
+    return int(std::nearbyint(x));
+}
+
+inline void pcm_store_8bit(uint8_t *data, const float *acc, size_t count)
+{
+    size_t i = 0;
+#ifdef PCM_SIMD_SSE2
+    const __m128i bias = _mm_set1_epi16(128);
+    const __m128 lo = _mm_set1_ps(-128.0f), hi = _mm_set1_ps(127.0f);
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128 a = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(acc + i), lo), hi);
+        __m128 b = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(acc + i + 4), lo), hi);
+        __m128i v = _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b));
+        v = _mm_packus_epi16(_mm_add_epi16(v, bias), v);
+        _mm_storel_epi64((__m128i *)(data + i), v);
+    }
+#endif
+    for (; i < count; ++i)
+    {
+        data[i] = uint8_t(pcm_store_sample(acc[i], -128.0f, 127.0f) + 128);
+    }
+}
+
+inline void pcm_store_16bit(int16_t *data, const float *acc, size_t count)
+{
+    size_t i = 0;
+#ifdef PCM_SIMD_SSE2
+    const __m128 lo = _mm_set1_ps(-32768.0f), hi = _mm_set1_ps(32767.0f);
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128 a = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(acc + i), lo), hi);
+        __m128 b = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(acc + i + 4), lo), hi);
+        __m128i v = _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b));
+        _mm_storeu_si128((__m128i *)(data + i), v);
+    }
+#endif
+    for (; i < count; ++i)
+    {
+        data[i] = int16_t(pcm_store_sample(acc[i], -32768.0f, 32767.0f));
+    }
+}
+
+#endif  // ndef PCM_SIMD_HPP_
@@ -0,0 +1,197 @@
+#ifndef PCM_TRACE_HPP_
+#define PCM_TRACE_HPP_     1   /* Version 1 */
+
+// Timeline spans in the Chrome trace_event format, to be viewed in Perfetto
+// or chrome://tracing. They are recorded only if PCM_TRACE is defined (the
+// CMake option PCM_TRACE); otherwise PCM_TRACE_SCOPE expands to nothing.
+//
+//   PCM_TRACE_SCOPE("name");   // a span from here to the end of the scope
+//
+// Each thread appends its spans to a buffer of its own, without locks or
+// atomics; it takes a lock once, to register the buffer. At exit the spans
+// are written to the file named by the environment variable PCM_TRACE_FILE,
+// or to PCM_TRACE_DEFAULT_FILE. The names must be string literals.
+
+#ifdef PCM_TRACE
+    #include <cstdio>
+    #include <cstdlib>
+    #include <cstdint>
+    #include <chrono>
+    #include <memory>
+    #include <mutex>
+    #include <vector>
+
+    #define PCM_TRACE_DEFAULT_FILE  "pcm_trace.json"
+    #define PCM_TRACE_CHUNK         (64 * 1024)         // spans per allocation
+    #define PCM_TRACE_MAX_SPANS     (4 * 1024 * 1024)   // per thread; more are dropped
+
+    struct PcmTraceSpan
+    {
+        const char *name;
+        int64_t begin;      // in nanoseconds from the start of the tracer
+        int64_t end;
+    };
+
+    // the spans of one thread; only that thread adds to it
+    class PcmTraceBuffer
+    {
+    public:
+        explicit PcmTraceBuffer(int tid) : m_tid(tid), m_count(0), m_dropped(0)
+        {
+        }
+
+        void add(const char *name, int64_t begin, int64_t end)
+        {
+            if (m_count == PCM_TRACE_MAX_SPANS)
+            {
+                ++m_dropped;
+                return;
+            }
+            if (m_count % PCM_TRACE_CHUNK == 0)
+                m_chunks.emplace_back(new PcmTraceSpan[PCM_TRACE_CHUNK]);
+            PcmTraceSpan& span = m_chunks.back()[m_count % PCM_TRACE_CHUNK];
+            span.name = name;
+            span.begin = begin;
+            span.end = end;
+            ++m_count;
+        }
+
+        int tid() const
+        {
+            return m_tid;
+        }
+
+        size_t size() const
+        {
+            return m_count;
+        }
+
+        size_t dropped() const
+        {
+            return m_dropped;
+        }
+
+        const PcmTraceSpan& operator[](size_t i) const
+        {
+            return m_chunks[i / PCM_TRACE_CHUNK][i % PCM_TRACE_CHUNK];
+        }
+
+    protected:
+        int m_tid;
+        size_t m_count;
+        size_t m_dropped;
+        std::vector<std::unique_ptr<PcmTraceSpan[]>> m_chunks;
+    }; // class PcmTraceBuffer
+
+    class PcmTracer
+    {
+    public:
+        PcmTracer() : m_start(std::chrono::steady_clock::now())
+        {
+        }
+
+        // writes the spans; by then the other threads are idle
+        ~PcmTracer()
+        {
+            write();
+        }
+
+        int64_t now() const
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - m_start).count();
+        }
+
+        // the buffer of the calling thread
+        PcmTraceBuffer& buffer()
+        {
+            static thread_local PcmTraceBuffer *t_buffer = NULL;
+            if (!t_buffer)
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_buffers.emplace_back(new PcmTraceBuffer(int(m_buffers.size()) + 1));
+                t_buffer = m_buffers.back().get();
+            }
+            return *t_buffer;
+        }
+
+        bool write()
+        {
+            const char *file = std::getenv("PCM_TRACE_FILE");
+            if (!file || !*file)
+                file = PCM_TRACE_DEFAULT_FILE;
+            std::FILE *fp = std::fopen(file, "w");
+            if (!fp)
+            {
+                std::fprintf(stderr, "ERROR: Unable to write trace '%s'.\n", file);
+                return false;
+            }
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            std::fprintf(fp, "{\"traceEvents\":[\n");
+            const char *sep = "";
+            for (auto& buffer : m_buffers)
+            {
+                std::fprintf(fp, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+                                 "\"args\":{\"name\":\"thread %d\"}}",
+                             sep, buffer->tid(), buffer->tid());
+                sep = ",\n";
+                for (size_t i = 0; i < buffer->size(); ++i)
+                {
+                    const PcmTraceSpan& span = (*buffer)[i];
+                    std::fprintf(fp, ",\n{\"name\":\"%s\",\"cat\":\"pcm\",\"ph\":\"X\",\"pid\":1,"
+                                     "\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                                 span.name, buffer->tid(), span.begin / 1000.0,
+                                 (span.end - span.begin) / 1000.0);
+                }
+                if (buffer->dropped())
+                {
+                    std::fprintf(stderr, "WARNING: trace: %lu spans of thread %d dropped.\n",
+                                 (unsigned long)buffer->dropped(), buffer->tid());
+                }
+            }
+            std::fprintf(fp, "\n],\"displayTimeUnit\":\"ms\"}\n");
+            bool ok = !std::ferror(fp);
+            std::fclose(fp);
+            return ok;
+        }
+
+    protected:
+        std::chrono::steady_clock::time_point m_start;
+        std::mutex m_mutex;
+        std::vector<std::unique_ptr<PcmTraceBuffer>> m_buffers;
+    }; // class PcmTracer
+
+    // the tracer of the process; created by the first span
+    inline PcmTracer& pcm_tracer()
+    {
+        static PcmTracer tracer;
+        return tracer;
+    }
+
+    class PcmTraceScope
+    {
+    public:
+        explicit PcmTraceScope(const char *name) : m_name(name), m_begin(pcm_tracer().now())
+        {
+        }
+
+        ~PcmTraceScope()
+        {
+            PcmTracer& tracer = pcm_tracer();
+            tracer.buffer().add(m_name, m_begin, tracer.now());
+        }
+
+    protected:
+        const char *m_name;
+        int64_t m_begin;
+    };
+
+    #define PCM_TRACE_CONCAT2(a, b)     a##b
+    #define PCM_TRACE_CONCAT(a, b)      PCM_TRACE_CONCAT2(a, b)
+    #define PCM_TRACE_SCOPE(name)       PcmTraceScope PCM_TRACE_CONCAT(pcm_trace_scope_, __LINE__)(name)
+#else
+    #define PCM_TRACE_SCOPE(name)       ((void)0)
+#endif
+
+#endif  // ndef PCM_TRACE_HPP_
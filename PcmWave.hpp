@@ -1,5 +1,5 @@
 #ifndef PCM_WAVE_HPP_
-#define PCM_WAVE_HPP_     8   /* Version 8 */
+#define PCM_WAVE_HPP_     11  /* Version 11 */
 
 #if __cplusplus >= 201103L  /* C++11 */
     #include <cstdint>
@@ -13,9 +13,33 @@
 
 #ifdef __cplusplus
     #include <cstdio>
+    #include <cstdarg>
     #include <cstring>
+    #include <cstdlib>
     #include <vector>
+    #include <algorithm>
+    #include <memory>
     #include <cassert>
+    #include "PcmLossless.hpp"
+    #include "PcmAdpcm.hpp"
+    #include "PcmG711.hpp"
+    #include "PcmParallel.hpp"
+    #include "PcmTrace.hpp"
+    #ifdef _WIN32
+        #include <io.h>
+        #include <fcntl.h>
+    #endif
+    #ifdef __linux__
+        #include <unistd.h>
+        #include <sys/sendfile.h>
+    #endif
+    #if !defined(PCM_SIMD_SSE2) && \
+        (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+        #define PCM_SIMD_SSE2
+    #endif
+    #ifdef PCM_SIMD_SSE2
+        #include <emmintrin.h>
+    #endif
 #else
     #include <stdio.h>
     #include <string.h>
@@ -51,6 +75,46 @@ typedef struct PCM_WAVE
     uint32_t Subchunk2Size;     /* == NumSamples * NumChannels * BitsPerSample/8 */
 } PCM_WAVE;
 
+/* RF64/BW64: ChunkSize and Subchunk2Size are 0xFFFFFFFF and the real sizes
+   are stored in the "ds64" chunk that follows "WAVE". */
+/* See also: EBU Tech 3306 */
+#define PCM_WAVE_ID_RF64        0x34364652  /* "RF64" */
+#define PCM_WAVE_ID_BW64        0x34365742  /* "BW64" */
+#define PCM_WAVE_ID_DS64        0x34367364  /* "ds64" */
+#define PCM_WAVE_ID_JUNK        0x4B4E554A  /* "JUNK" */
+#define PCM_WAVE_ID_RIFX        0x58464952  /* "RIFX": big-endian sizes and samples */
+#define PCM_WAVE_SIZE32_MAX     0xFFFFFFFF  /* "use ds64" or "unknown length" marker */
+#define PCM_WAVE_SIZE_UNKNOWN   ((uint64_t)-1)  /* streamed until EOF */
+#define PCM_WAVE_ID_FACT        0x74636166  /* "fact" */
+
+/* AudioFormat */
+#define PCM_WAVE_FORMAT_PCM         0x0001
+#define PCM_WAVE_FORMAT_ALAW        0x0006  /* G.711 A-law; see PcmG711.hpp */
+#define PCM_WAVE_FORMAT_MULAW       0x0007  /* G.711 mu-law */
+#define PCM_WAVE_FORMAT_IMA_ADPCM   0x0011  /* 4-bit; see PcmAdpcm.hpp */
+
+/* flags for PcmWave::write_header_to_fp */
+#define PCM_WAVE_HEADER_JUNK    1   /* reserve a "JUNK" chunk for a later ds64 */
+#define PCM_WAVE_HEADER_STREAM  2   /* unknown length (0xFFFFFFFF sizes) */
+#define PCM_WAVE_HEADER_RIFX    4   /* big-endian "RIFX"; not with RF64 */
+#define PCM_WAVE_HEADER_LOSSLESS 8  /* PcmWaveWriter: compressed "PCMZ" instead */
+#define PCM_WAVE_HEADER_IMA_ADPCM 16 /* IMA ADPCM of the 16-bit samples; not with RF64 */
+#define PCM_WAVE_HEADER_MULAW   32  /* G.711 mu-law of the 16-bit samples */
+#define PCM_WAVE_HEADER_ALAW    64  /* G.711 A-law of the 16-bit samples */
+
+typedef struct PCM_WAVE_DS64
+{
+    uint32_t ChunkID;           /* "ds64" 0x34367364 */
+    uint32_t ChunkSize;         /* 28 */
+    uint32_t RiffSizeLow;       /* size of the file minus 8 */
+    uint32_t RiffSizeHigh;
+    uint32_t DataSizeLow;       /* size of the "data" payload */
+    uint32_t DataSizeHigh;
+    uint32_t SampleCountLow;    /* == DataSize / BlockAlign */
+    uint32_t SampleCountHigh;
+    uint32_t TableLength;       /* 0 */
+} PCM_WAVE_DS64;
+
 #ifdef __cplusplus
     class PcmWave
     {
@@ -100,7 +164,9 @@ typedef struct PCM_WAVE
         void mode(uint16_t bits);
 
         uint16_t data_unit() const;
-        uint32_t num_units() const;
+        uint64_t num_units() const;
+        uint64_t data_size() const;
+        void data_size(uint64_t size);
 
         void get_info(uint16_t *NumChannels_ = NULL,
                       uint16_t *BitsPerSample_ = NULL,
@@ -114,6 +180,9 @@ typedef struct PCM_WAVE
         void get_data(data_type& data);
         void set_data(const void *data, size_t data_size);
         void set_data(const data_type& data);
+        // moves the payload in or out without a copy
+        void adopt_data(data_type&& data);
+        data_type release_data();
               uint8_t& data_8bit(size_t index);
         const uint8_t& data_8bit(size_t index) const;
               int16_t& data_16bit(size_t index);
@@ -121,16 +190,342 @@ typedef struct PCM_WAVE
 
         bool read_from_fp(std::FILE *fp);
         bool write_to_fp(std::FILE *fp) const;
-
-        float seconds() const;
+        bool read_header_from_fp(std::FILE *fp, PCM_LOSSLESS_HEADER *lossless = NULL);
+        bool write_header_to_fp(std::FILE *fp, int flags = 0) const;
+        bool rewrite_format_in_fp(std::FILE *fp) const;
+        bool is_rf64() const;
+        bool is_rifx() const;
+        bool is_lossless() const;
+        bool is_ima_adpcm() const;
+        bool is_g711() const;
+        bool is_ulaw() const;
+        // the header read has a "fmt " of samples this class does not read
+        bool is_unsupported_format() const;
+        uint16_t adpcm_block_align() const;
+        uint16_t adpcm_block_units() const;
+
+        double seconds() const;
 
     protected:
         PCM_WAVE m_wave;
+        uint64_t m_data_size;       // 64-bit Subchunk2Size
         std::vector<uint8_t> m_data;
+        uint16_t m_adpcm_align;     // bytes per block of an IMA ADPCM file
+        uint16_t m_adpcm_units;     // frames per block of it
     }; // class PcmWave
 
+    // A read-only view of interleaved frames that it does not own, such as
+    // a PcmWave, a mapped file or a network buffer. The memory must outlive
+    // the view.
+    class PcmWaveView
+    {
+    public:
+        PcmWaveView();
+        PcmWaveView(const PcmWave& wave);
+        PcmWaveView(uint16_t NumChannels_,
+                    uint16_t BitsPerSample_,
+                    uint32_t SampleRate_,
+                    const void *data, size_t data_size);
+
+        bool empty() const;
+        size_t size() const;
+
+        bool is_valid() const;
+        bool is_mono() const;
+        bool is_stereo() const;
+        uint16_t num_channels() const;
+        uint32_t sample_rate() const;
+        bool mode_8bit() const;
+        bool mode_16bit() const;
+        uint16_t mode() const;
+
+        uint16_t data_unit() const;
+        uint64_t num_units() const;
+        uint64_t data_size() const;
+
+        const void *data() const;
+        const uint8_t& data_8bit(size_t index) const;
+        const int16_t& data_16bit(size_t index) const;
+
+        // the frames [first, first + count), clipped to the view
+        PcmWaveView units(uint64_t first, uint64_t count) const;
+
+        double seconds() const;
+
+    protected:
+        uint16_t m_channels;
+        uint16_t m_bits;
+        uint32_t m_rate;
+        const uint8_t *m_data;
+        size_t m_size;
+    }; // class PcmWaveView
+
+    inline uint16_t pcm_wave_bswap16(uint16_t x)
+    {
+        return uint16_t((x >> 8) | (x << 8));
+    }
+
+    inline uint32_t pcm_wave_bswap32(uint32_t x)
+    {
+        return (x >> 24) | ((x >> 8) & 0xFF00) | ((x << 8) & 0xFF0000) | (x << 24);
+    }
+
+    // the byte order of the "fmt " fields, for RIFX
+    inline void pcm_wave_swap_format(PCM_WAVE& wave)
+    {
+        wave.AudioFormat = pcm_wave_bswap16(wave.AudioFormat);
+        wave.NumChannels = pcm_wave_bswap16(wave.NumChannels);
+        wave.SampleRate = pcm_wave_bswap32(wave.SampleRate);
+        wave.ByteRate = pcm_wave_bswap32(wave.ByteRate);
+        wave.BlockAlign = pcm_wave_bswap16(wave.BlockAlign);
+        wave.BitsPerSample = pcm_wave_bswap16(wave.BitsPerSample);
+    }
+
+    // swaps the byte order of the samples in place; 16-bit uses SSE2
+    inline void pcm_wave_swap_samples(void *data, size_t size, uint16_t bits)
+    {
+        uint8_t *p = static_cast<uint8_t *>(data);
+        if (bits == 16)
+        {
+            size_t i = 0;
+        #ifdef PCM_SIMD_SSE2
+            for (; i + 16 <= size; i += 16)
+            {
+                __m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+                v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+                _mm_storeu_si128((__m128i *)(p + i), v);
+            }
+        #endif
+            for (; i + 2 <= size; i += 2)
+                std::swap(p[i], p[i + 1]);
+            return;
+        }
+
+        const size_t width = bits / 8;
+        if (width <= 1)
+            return;
+        for (size_t i = 0; i + width <= size; i += width)
+            std::reverse(p + i, p + i + width);
+    }
+
+    inline int pcm_wave_fseek(std::FILE *fp, int64_t offset, int origin)
+    {
+    #ifdef _WIN32
+        return _fseeki64(fp, offset, origin);
+    #else
+        return fseeko(fp, off_t(offset), origin);
+    #endif
+    }
+
+    inline int64_t pcm_wave_ftell(std::FILE *fp)
+    {
+    #ifdef _WIN32
+        return _ftelli64(fp);
+    #else
+        return ftello(fp);
+    #endif
+    }
+
+    inline bool pcm_wave_is_seekable(std::FILE *fp)
+    {
+        return pcm_wave_ftell(fp) >= 0 && pcm_wave_fseek(fp, 0, SEEK_CUR) == 0;
+    }
+
+    // "-" means stdin or stdout
+    inline std::FILE *pcm_wave_fopen(const char *file, const char *mode)
+    {
+        using namespace std;
+        if (strcmp(file, "-") != 0)
+            return fopen(file, mode);
+
+        FILE *fp = (mode[0] == 'r') ? stdin : stdout;
+    #ifdef _WIN32
+        if (strchr(mode, 'b'))
+            _setmode(_fileno(fp), _O_BINARY);
+    #endif
+        return fp;
+    }
+
+    inline void pcm_wave_fclose(std::FILE *fp)
+    {
+        using namespace std;
+        if (fp == stdin || fp == stdout)
+            fflush(fp);
+        else
+            fclose(fp);
+    }
+
+    // skip forward; works on pipes too
+    inline bool pcm_wave_skip(std::FILE *fp, uint64_t size)
+    {
+        if (size == 0 || pcm_wave_fseek(fp, int64_t(size), SEEK_CUR) == 0)
+            return true;
+
+        char buf[512];
+        while (size > 0)
+        {
+            size_t n = (size < sizeof(buf)) ? size_t(size) : sizeof(buf);
+            if (!std::fread(buf, n, 1, fp))
+                return false;
+            size -= n;
+        }
+        return true;
+    }
+
+    // The stream of the progress and error messages of the library. It is
+    // NULL, so the library is quiet, unless a tool sets it to stderr.
+    inline std::FILE *& pcm_wave_messages()
+    {
+        static std::FILE *fp = NULL;
+        return fp;
+    }
+
+    // printf to pcm_wave_messages()
+    inline void pcm_wave_message(const char *format, ...)
+    #ifdef __GNUC__
+        __attribute__((format(printf, 1, 2)))
+    #endif
+    ;
+    inline void pcm_wave_message(const char *format, ...)
+    {
+        std::FILE *fp = pcm_wave_messages();
+        if (!fp)
+            return;
+        va_list va;
+        va_start(va, format);
+        std::vfprintf(fp, format, va);
+        va_end(va);
+    }
+
+    // the format line of the tools' messages
+    inline void pcm_wave_show_info(const char *name, const PcmWave& wave)
+    {
+        if (wave.data_size() == PCM_WAVE_SIZE_UNKNOWN)
+        {
+            pcm_wave_message("%s: %lu Hz sampling, %d-bit, %d channel (streaming)\n",
+                             name, (unsigned long)wave.sample_rate(), wave.mode(), wave.num_channels());
+            return;
+        }
+        pcm_wave_message("%s: %lu Hz sampling, %d-bit, %d channel (%.2f seconds)\n",
+                         name, (unsigned long)wave.sample_rate(),
+                         wave.mode(), wave.num_channels(), wave.seconds());
+    }
+
+    // Writes a "PCMZ" stream (see PcmLossless.hpp). Blocks are encoded in
+    // batches of PCM_LOSSLESS_BATCH on all cores. On a seekable stream,
+    // close() patches the frame count and the seek table into the header.
+    class PcmLosslessEncoder
+    {
+    public:
+        PcmLosslessEncoder();
+
+        // frames, if known, goes to the header of a pipe
+        bool open(std::FILE *fp, uint16_t NumChannels_, uint16_t BitsPerSample_,
+                  uint32_t SampleRate_, uint64_t frames = PCM_WAVE_SIZE_UNKNOWN);
+        bool write(const void *data, size_t data_size);     // whole frames
+        bool close();
+
+    protected:
+        std::FILE *m_fp;
+        PCM_LOSSLESS_HEADER m_header;
+        int64_t m_header_pos;   // -1 if not seekable
+        size_t m_unit;
+        uint64_t m_frames;      // written so far
+        uint64_t m_offset;      // bytes from the header start
+        std::vector<uint8_t> m_pending;     // PCM not encoded yet
+        std::vector<uint64_t> m_table;      // the offsets of the blocks
+
+        bool flush(bool last);
+    }; // class PcmLosslessEncoder
+
+    // Reads a "PCMZ" stream after its header. Blocks are decoded in batches
+    // on all cores. seek() uses the seek table if the stream is seekable, and
+    // skips whole blocks without decoding them otherwise.
+    class PcmLosslessDecoder
+    {
+    public:
+        PcmLosslessDecoder();
+
+        bool open(std::FILE *fp, const PCM_LOSSLESS_HEADER& header);
+        // reads up to data_size bytes of whole frames; returns the bytes read
+        size_t read(void *data, size_t data_size);
+        bool seek(uint64_t unit);
+        bool error() const;
+
+    protected:
+        std::FILE *m_fp;
+        PCM_LOSSLESS_HEADER m_header;
+        int64_t m_header_pos;   // -1 if not seekable
+        int64_t m_file_size;    // -1 if not seekable
+        size_t m_unit;
+        uint64_t m_block;       // the next block in the file
+        uint64_t m_position;    // the next frame of read()
+        bool m_end;             // after the end marker
+        bool m_error;
+        std::vector<uint8_t> m_pcm;     // the decoded batch
+        size_t m_pcm_pos;               // bytes of m_pcm already read
+        std::vector<uint64_t> m_table;
+
+        bool decode_batch();
+        bool load_table();
+    }; // class PcmLosslessDecoder
+
+    // Encodes 16-bit PCM into the IMA ADPCM blocks of a "data" payload. Full
+    // blocks are encoded in batches of PCM_ADPCM_BATCH on all cores; close()
+    // pads the last block.
+    class PcmAdpcmEncoder
+    {
+    public:
+        PcmAdpcmEncoder();
+
+        bool open(std::FILE *fp, uint16_t NumChannels_, uint32_t SampleRate_);
+        bool write(const void *data, size_t data_size);     // whole frames
+        bool close();
+
+    protected:
+        std::FILE *m_fp;
+        uint16_t m_channels;
+        size_t m_align;         // bytes per block
+        size_t m_units;         // frames per block
+        std::vector<uint8_t> m_pending;     // PCM not encoded yet
+        std::vector<uint8_t> m_coded;
+
+        bool flush(bool last);
+    }; // class PcmAdpcmEncoder
+
+    // Decodes the IMA ADPCM payload of a wave file into 16-bit PCM, a batch
+    // of blocks at a time on all cores. seek() goes straight to the block of
+    // the frame, or skips whole blocks on a pipe.
+    class PcmAdpcmDecoder
+    {
+    public:
+        PcmAdpcmDecoder();
+
+        // fp is at the payload of header
+        bool open(std::FILE *fp, const PcmWave& header);
+        // reads up to data_size bytes of whole frames; returns the bytes read
+        size_t read(void *data, size_t data_size);
+        bool seek(uint64_t unit);
+
+    protected:
+        std::FILE *m_fp;
+        uint16_t m_channels;
+        size_t m_align;         // bytes per block
+        size_t m_units;         // frames per block
+        int64_t m_data_pos;     // -1 if not seekable
+        uint64_t m_blocks;      // in the payload, or PCM_WAVE_SIZE_UNKNOWN
+        uint64_t m_block;       // the next block in the file
+        uint64_t m_position;    // the next frame of read()
+        bool m_end;
+        std::vector<uint8_t> m_coded;
+        std::vector<uint8_t> m_pcm;     // the decoded batch
+        size_t m_pcm_pos;               // bytes of m_pcm already read
+
+        bool decode_batch();
+    }; // class PcmAdpcmDecoder
+
     inline
-    PcmWave::PcmWave()
+    PcmWave::PcmWave() : m_data_size(0), m_adpcm_align(0), m_adpcm_units(0)
     {
         // no init
     }
@@ -139,6 +534,7 @@ typedef struct PCM_WAVE
     PcmWave::PcmWave(uint16_t NumChannels_,
                      uint16_t BitsPerSample_,
                      uint32_t SampleRate_)
+        : m_data_size(0), m_adpcm_align(0), m_adpcm_units(0)
     {
         set_info(NumChannels_, BitsPerSample_, SampleRate_);
     }
@@ -148,6 +544,7 @@ typedef struct PCM_WAVE
                      uint16_t BitsPerSample_,
                      uint32_t SampleRate_,
                      const void *data, size_t data_size)
+        : m_data_size(0), m_adpcm_align(0), m_adpcm_units(0)
     {
         set_info(NumChannels_, BitsPerSample_, SampleRate_);
         set_data(data, data_size);
@@ -157,148 +554,679 @@ typedef struct PCM_WAVE
     PcmWave::PcmWave(PcmWave&& wave)
     {
         m_wave = wave.m_wave;
+        m_data_size = wave.m_data_size;
         m_data = std::move(wave.m_data);
+        m_adpcm_align = wave.m_adpcm_align;
+        m_adpcm_units = wave.m_adpcm_units;
     }
 
     inline
     PcmWave& PcmWave::operator=(PcmWave&& wave)
     {
         m_wave = wave.m_wave;
+        m_data_size = wave.m_data_size;
         m_data = std::move(wave.m_data);
+        m_adpcm_align = wave.m_adpcm_align;
+        m_adpcm_units = wave.m_adpcm_units;
         return *this;
     }
 
+    // Reads the RIFF/RF64 header and stops at the beginning of the payload.
+    // Unknown chunks before "data" are skipped. A "PCMZ" header is stored
+    // into *lossless; the payload must then be read by PcmLosslessDecoder.
     inline
-    bool PcmWave::read_from_fp(std::FILE *fp)
+    bool PcmWave::read_header_from_fp(std::FILE *fp, PCM_LOSSLESS_HEADER *lossless)
     {
-        if (std::fread(&m_wave, sizeof(m_wave), 1, fp))
+        m_wave.Subchunk1ID = 0;     // no "fmt " yet
+
+        uint32_t riff[3];
+        if (!std::fread(riff, sizeof(riff), 1, fp))
+            return false;
+
+        if (riff[0] == PCM_LOSSLESS_MAGIC)
+        {
+            PCM_LOSSLESS_HEADER header;
+            memcpy(&header, riff, sizeof(riff));
+            if (!std::fread(reinterpret_cast<uint8_t *>(&header) + sizeof(riff),
+                            sizeof(header) - sizeof(riff), 1, fp) ||
+                header.Version != PCM_LOSSLESS_VERSION || header.BlockUnits == 0 ||
+                uint64_t(header.BlockUnits) * header.NumChannels * header.BitsPerSample / 8 >
+                    PCM_LOSSLESS_MAX_BLOCK_SIZE)
+            {
+                return false;
+            }
+
+            set_info(header.NumChannels, header.BitsPerSample, header.SampleRate);
+            m_wave.ChunkID = PCM_LOSSLESS_MAGIC;
+            if (header.FramesLow == PCM_WAVE_SIZE32_MAX && header.FramesHigh == PCM_WAVE_SIZE32_MAX)
+                data_size(PCM_WAVE_SIZE_UNKNOWN);
+            else
+                data_size(((uint64_t(header.FramesHigh) << 32) | header.FramesLow) * data_unit());
+            if (lossless)
+                *lossless = header;
+            return is_valid0();
+        }
+
+        const bool rifx = (riff[0] == PCM_WAVE_ID_RIFX);
+        m_wave.ChunkID = riff[0];
+        m_wave.ChunkSize = rifx ? pcm_wave_bswap32(riff[1]) : riff[1];
+        m_wave.Format = riff[2];
+        m_wave.Subchunk1ID = m_wave.Subchunk1Size = 0;
+
+        PCM_WAVE_DS64 ds64;
+        memset(&ds64, 0, sizeof(ds64));
+        uint32_t fact = PCM_WAVE_SIZE32_MAX;    // frames, if given
+
+        for (;;)
         {
-            if (is_valid0())
+            uint32_t chunk[2];
+            if (!std::fread(chunk, sizeof(chunk), 1, fp))
+                return false;
+            if (rifx)
+                chunk[1] = pcm_wave_bswap32(chunk[1]);
+
+            uint64_t skip = chunk[1] + (chunk[1] & 1);
+            switch (chunk[0])
             {
-                m_data.resize(m_wave.Subchunk2Size);
-                if (std::fread(&m_data[0], m_wave.Subchunk2Size, 1, fp))
+            case PCM_WAVE_ID_DS64:
+                ds64.ChunkID = chunk[0];
+                ds64.ChunkSize = chunk[1];
+                if (chunk[1] < sizeof(ds64) - 8 ||
+                    !std::fread(&ds64.RiffSizeLow, sizeof(ds64) - 8, 1, fp))
                 {
-                    if (uint32_t bits = m_wave.NumChannels * m_wave.BitsPerSample)
+                    return false;
+                }
+                skip -= sizeof(ds64) - 8;
+                break;
+            case 0x20746d66:    // "fmt "
+                m_wave.Subchunk1ID = chunk[0];
+                m_wave.Subchunk1Size = chunk[1];
+                if (chunk[1] < 16 || !std::fread(&m_wave.AudioFormat, 16, 1, fp))
+                    return false;
+                if (rifx)
+                    pcm_wave_swap_format(m_wave);
+                skip -= 16;
+                if (m_wave.AudioFormat == PCM_WAVE_FORMAT_IMA_ADPCM)
+                {
+                    // cbSize and wSamplesPerBlock. The payload is decoded
+                    // to 16-bit PCM, so the fields describe 16-bit samples.
+                    uint16_t extra[2];
+                    if (rifx || chunk[1] < 20 || !std::fread(extra, sizeof(extra), 1, fp) ||
+                        m_wave.BitsPerSample != 4 || m_wave.NumChannels == 0 || extra[1] == 0 ||
+                        extra[1] > pcm_ima_block_units(m_wave.BlockAlign, m_wave.NumChannels))
                     {
-                        return is_valid();
+                        return false;
+                    }
+                    skip -= sizeof(extra);
+                    m_adpcm_align = m_wave.BlockAlign;
+                    m_adpcm_units = extra[1];
+                    m_wave.BitsPerSample = 16;
+                    m_wave.BlockAlign = m_wave.NumChannels * 2;
+                    m_wave.ByteRate = m_wave.SampleRate * m_wave.BlockAlign;
+                }
+                else if (m_wave.AudioFormat == PCM_WAVE_FORMAT_MULAW ||
+                         m_wave.AudioFormat == PCM_WAVE_FORMAT_ALAW)
+                {
+                    // a byte per sample, decoded to 16-bit PCM
+                    if (m_wave.BitsPerSample != 8)
+                        return false;
+                    m_wave.BitsPerSample = 16;
+                    m_wave.BlockAlign = m_wave.NumChannels * 2;
+                    m_wave.ByteRate = m_wave.SampleRate * m_wave.BlockAlign;
+                }
+                break;
+            case PCM_WAVE_ID_FACT:
+                if (chunk[1] < 4 || !std::fread(&fact, sizeof(fact), 1, fp))
+                    return false;
+                if (rifx)
+                    fact = pcm_wave_bswap32(fact);
+                skip -= sizeof(fact);
+                break;
+            case 0x61746164:    // "data"
+                if (m_wave.Subchunk1ID == 0)
+                    return false;
+                m_wave.Subchunk2ID = chunk[0];
+                m_wave.Subchunk2Size = chunk[1];
+                m_data_size = chunk[1];
+                if (ds64.ChunkID && chunk[1] == PCM_WAVE_SIZE32_MAX)
+                {
+                    m_data_size = (uint64_t(ds64.DataSizeHigh) << 32) | ds64.DataSizeLow;
+                }
+                else if (chunk[1] == PCM_WAVE_SIZE32_MAX)
+                {
+                    // written to a pipe; the payload runs until EOF
+                    m_data_size = PCM_WAVE_SIZE_UNKNOWN;
+                    int64_t pos = pcm_wave_ftell(fp);
+                    if (pos >= 0 && pcm_wave_fseek(fp, 0, SEEK_END) == 0)
+                    {
+                        m_data_size = uint64_t(pcm_wave_ftell(fp) - pos);
+                        pcm_wave_fseek(fp, pos, SEEK_SET);
+                    }
+                }
+                if (is_g711() && m_data_size != PCM_WAVE_SIZE_UNKNOWN)
+                    m_data_size *= 2;   // the size of the decoded samples
+                if (is_ima_adpcm())
+                {
+                    // the size of the decoded samples
+                    uint64_t frames = fact;
+                    if (fact == PCM_WAVE_SIZE32_MAX && m_data_size != PCM_WAVE_SIZE_UNKNOWN)
+                    {
+                        size_t tail = pcm_ima_block_units(size_t(m_data_size % m_adpcm_align),
+                                                          m_wave.NumChannels);
+                        frames = m_data_size / m_adpcm_align * m_adpcm_units +
+                                 std::min<size_t>(tail, m_adpcm_units);
                     }
+                    m_data_size = (frames == PCM_WAVE_SIZE32_MAX) ? PCM_WAVE_SIZE_UNKNOWN
+                                                                 : frames * m_wave.BlockAlign;
                 }
+                return is_valid0();
             }
+
+            if (!pcm_wave_skip(fp, skip))
+                return false;
         }
-        clear();
-        return false;
     }
 
+    // Writes a RIFF header, or an RF64 header if the payload does not fit
+    // into 32-bit sizes. With PCM_WAVE_HEADER_JUNK, the RIFF header has the
+    // same size as the RF64 one, so it can be patched in place later.
     inline
-    bool PcmWave::write_to_fp(std::FILE *fp) const
+    bool PcmWave::write_header_to_fp(std::FILE *fp, int flags) const
     {
-        using namespace std;
-        if (!is_valid())
-            return false;
-
         PCM_WAVE wave = m_wave;
+        wave.ChunkID = 0x46464952;
+        wave.Subchunk1Size = 16;
+        wave.AudioFormat = PCM_WAVE_FORMAT_PCM;     // the samples in memory
 
-        if (std::fwrite(&wave, sizeof(wave), 1, fp) &&
-            std::fwrite(&m_data[0], wave.Subchunk2Size, 1, fp))
+        const size_t head = 3 * sizeof(uint32_t);
+        PCM_WAVE_DS64 ds64;
+
+        if (flags & PCM_WAVE_HEADER_IMA_ADPCM)
         {
-            return true;
+            // "fmt " with cbSize and wSamplesPerBlock, then "fact". The header
+            // has the same size for any length, so it needs no JUNK chunk.
+            if (wave.BitsPerSample != 16 || wave.NumChannels == 0)
+                return false;
+            const uint32_t align = uint32_t(pcm_ima_block_align(wave.NumChannels, wave.SampleRate));
+            const uint32_t units = uint32_t(pcm_ima_block_units(align, wave.NumChannels));
+            const uint64_t frames = m_data_size / wave.BlockAlign;
+            const uint64_t size = (frames + units - 1) / units * align;
+            const bool stream = (flags & PCM_WAVE_HEADER_STREAM) != 0;
+            if (!stream && size > PCM_WAVE_SIZE32_MAX - 52)
+                return false;
+
+            uint32_t header[15] =
+            {
+                0x46464952, stream ? PCM_WAVE_SIZE32_MAX : uint32_t(52 + size), 0x45564157,
+                0x20746d66, 20,
+                PCM_WAVE_FORMAT_IMA_ADPCM | (uint32_t(wave.NumChannels) << 16),
+                wave.SampleRate,
+                uint32_t(uint64_t(wave.SampleRate) * align / units),
+                align | (4 << 16),                      // nBlockAlign, wBitsPerSample
+                2 | (units << 16),                      // cbSize, wSamplesPerBlock
+                PCM_WAVE_ID_FACT, 4, stream ? PCM_WAVE_SIZE32_MAX : uint32_t(frames),
+                0x61746164, stream ? PCM_WAVE_SIZE32_MAX : uint32_t(size)
+            };
+            return std::fwrite(header, sizeof(header), 1, fp) == 1;
         }
 
-        return false;
-    }
+        // G.711 stores a byte per sample
+        uint64_t data_size = m_data_size;
+        if (flags & (PCM_WAVE_HEADER_MULAW | PCM_WAVE_HEADER_ALAW))
+        {
+            if (wave.BitsPerSample != 16)
+                return false;
+            wave.AudioFormat = (flags & PCM_WAVE_HEADER_MULAW) ? PCM_WAVE_FORMAT_MULAW
+                                                               : PCM_WAVE_FORMAT_ALAW;
+            wave.BitsPerSample = 8;
+            wave.BlockAlign = wave.NumChannels;
+            wave.ByteRate = wave.SampleRate * wave.NumChannels;
+            data_size /= 2;
+        }
+        const bool rf64 = data_size > PCM_WAVE_SIZE32_MAX - 36 - sizeof(PCM_WAVE_DS64);
 
-    inline
-    bool PcmWave::load_from_file(const char *file)
-    {
-        using namespace std;
-        clear();
+        if (flags & PCM_WAVE_HEADER_RIFX)
+        {
+            // RIFX has no ds64; the JUNK chunk only keeps the size of the header
+            const bool stream = (flags & PCM_WAVE_HEADER_STREAM) != 0;
+            const bool junk = !stream && (flags & PCM_WAVE_HEADER_JUNK);
+            if (!stream && rf64)
+                return false;
 
-        bool flag = false;
-        if (FILE *fp = fopen(file, "rb"))
+            wave.ChunkID = PCM_WAVE_ID_RIFX;
+            wave.Subchunk2Size = stream ? PCM_WAVE_SIZE32_MAX : uint32_t(data_size);
+            wave.ChunkSize = stream ? PCM_WAVE_SIZE32_MAX : 36 + wave.Subchunk2Size;
+            if (junk)
+                wave.ChunkSize += sizeof(ds64);
+            wave.ChunkSize = pcm_wave_bswap32(wave.ChunkSize);
+            wave.Subchunk1Size = pcm_wave_bswap32(wave.Subchunk1Size);
+            wave.Subchunk2Size = pcm_wave_bswap32(wave.Subchunk2Size);
+            pcm_wave_swap_format(wave);
+            if (!junk)
+                return std::fwrite(&wave, sizeof(wave), 1, fp) == 1;
+
+            memset(&ds64, 0, sizeof(ds64));
+            ds64.ChunkID = PCM_WAVE_ID_JUNK;
+            ds64.ChunkSize = pcm_wave_bswap32(sizeof(ds64) - 8);
+            return std::fwrite(&wave, head, 1, fp) &&
+                   std::fwrite(&ds64, sizeof(ds64), 1, fp) &&
+                   std::fwrite(&wave.Subchunk1ID, sizeof(wave) - head, 1, fp);
+        }
+
+        if (flags & PCM_WAVE_HEADER_STREAM)
         {
-            flag = read_from_fp(fp);
-            fclose(fp);
+            wave.ChunkSize = PCM_WAVE_SIZE32_MAX;
+            wave.Subchunk2Size = PCM_WAVE_SIZE32_MAX;
+            return std::fwrite(&wave, sizeof(wave), 1, fp) == 1;
         }
-        return flag;
+
+        if (!rf64)
+        {
+            wave.Subchunk2Size = uint32_t(data_size);
+            wave.ChunkSize = 36 + wave.Subchunk2Size;
+            if (!(flags & PCM_WAVE_HEADER_JUNK))
+                return std::fwrite(&wave, sizeof(wave), 1, fp) == 1;
+
+            memset(&ds64, 0, sizeof(ds64));
+            ds64.ChunkID = PCM_WAVE_ID_JUNK;
+            ds64.ChunkSize = sizeof(ds64) - 8;
+            wave.ChunkSize += sizeof(ds64);
+            return std::fwrite(&wave, head, 1, fp) &&
+                   std::fwrite(&ds64, sizeof(ds64), 1, fp) &&
+                   std::fwrite(&wave.Subchunk1ID, sizeof(wave) - head, 1, fp);
+        }
+
+        uint64_t riff_size = 4 + sizeof(ds64) + 8 + 16 + 8 + data_size;
+        uint64_t samples = data_size / (wave.BlockAlign ? wave.BlockAlign : 1);
+        ds64.ChunkID = PCM_WAVE_ID_DS64;
+        ds64.ChunkSize = sizeof(ds64) - 8;
+        ds64.RiffSizeLow = uint32_t(riff_size);
+        ds64.RiffSizeHigh = uint32_t(riff_size >> 32);
+        ds64.DataSizeLow = uint32_t(data_size);
+        ds64.DataSizeHigh = uint32_t(data_size >> 32);
+        ds64.SampleCountLow = uint32_t(samples);
+        ds64.SampleCountHigh = uint32_t(samples >> 32);
+        ds64.TableLength = 0;
+
+        wave.ChunkID = PCM_WAVE_ID_RF64;
+        wave.ChunkSize = PCM_WAVE_SIZE32_MAX;
+        wave.Subchunk2Size = PCM_WAVE_SIZE32_MAX;
+
+        // "RF64" <size> "WAVE", "ds64" chunk, then "fmt " and "data"
+        return std::fwrite(&wave, head, 1, fp) &&
+               std::fwrite(&ds64, sizeof(ds64), 1, fp) &&
+               std::fwrite(&wave.Subchunk1ID, sizeof(wave) - head, 1, fp);
     }
 
+    // Overwrites the "fmt " fields of the wave file fp (opened "r+b") in place,
+    // or the header of a "PCMZ" file. The file must have the same sample
+    // layout; only the rates are relabeled.
     inline
-    bool PcmWave::save_to_file(const char *file) const
+    bool PcmWave::rewrite_format_in_fp(std::FILE *fp) const
     {
-        using namespace std;
-        if (!is_valid())
-            return false;
-
-        bool flag = false;
-        if (FILE *fp = fopen(file, "wb"))
+        uint32_t riff[3];
+        if (pcm_wave_fseek(fp, 0, SEEK_SET) != 0 ||
+            !std::fread(riff, sizeof(riff), 1, fp))
         {
-            flag = write_to_fp(fp);
-            fclose(fp);
+            return false;
         }
-        return flag;
-    }
 
-    #ifdef _WIN32
-        inline
-        bool PcmWave::load_from_file(const wchar_t *file)
+        if (riff[0] == PCM_LOSSLESS_MAGIC)
         {
-            using namespace std;
-            clear();
-
-            bool flag = false;
-            if (FILE *fp = _wfopen(file, L"rb"))
+            PCM_LOSSLESS_HEADER header;
+            if (pcm_wave_fseek(fp, 0, SEEK_SET) != 0 ||
+                !std::fread(&header, sizeof(header), 1, fp) ||
+                header.NumChannels != m_wave.NumChannels ||
+                header.BitsPerSample != m_wave.BitsPerSample)
             {
-                flag = read_from_fp(fp);
-                fclose(fp);
+                return false;
             }
-            return flag;
+            header.SampleRate = m_wave.SampleRate;
+            return pcm_wave_fseek(fp, 0, SEEK_SET) == 0 &&
+                   std::fwrite(&header, sizeof(header), 1, fp) &&
+                   std::fflush(fp) == 0;
+        }
+        if ((riff[0] != 0x46464952 && riff[0] != PCM_WAVE_ID_RF64 &&
+             riff[0] != PCM_WAVE_ID_BW64 && riff[0] != PCM_WAVE_ID_RIFX) ||
+            riff[2] != 0x45564157)
+        {
+            return false;
         }
+        const bool rifx = (riff[0] == PCM_WAVE_ID_RIFX);
 
-        inline
-        bool PcmWave::save_to_file(const wchar_t *file) const
+        for (;;)
         {
-            using namespace std;
-            if (!is_valid())
+            uint32_t chunk[2];
+            if (!std::fread(chunk, sizeof(chunk), 1, fp))
                 return false;
+            if (rifx)
+                chunk[1] = pcm_wave_bswap32(chunk[1]);
 
-            bool flag = false;
-            if (FILE *fp = _wfopen(file, L"wb"))
-            {
-                flag = write_to_fp(fp);
-                fclose(fp);
-            }
-            return flag;
+            if (chunk[0] == 0x20746d66)     // "fmt "
+                break;
+            if (chunk[0] == 0x61746164)     // "data"
+                return false;
+            if (pcm_wave_fseek(fp, int64_t(chunk[1]) + (chunk[1] & 1), SEEK_CUR) != 0)
+                return false;
         }
-    #endif  // def _WIN32
+
+        int64_t pos = pcm_wave_ftell(fp);
+        PCM_WAVE wave;
+        if (pos < 0 || !std::fread(&wave.AudioFormat, 16, 1, fp))
+            return false;
+        if (rifx)
+            pcm_wave_swap_format(wave);
+
+        // the fields as they are in the file; coded samples are not the
+        // 16-bit samples in memory
+        PCM_WAVE coded = m_wave;
+        if (is_g711())
+        {
+            coded.BitsPerSample = 8;
+            coded.BlockAlign = coded.NumChannels;
+            coded.ByteRate = coded.SampleRate * coded.BlockAlign;
+        }
+        else if (is_ima_adpcm())
+        {
+            coded.BitsPerSample = 4;
+            coded.BlockAlign = m_adpcm_align;
+            coded.ByteRate = uint32_t(uint64_t(coded.SampleRate) * m_adpcm_align / m_adpcm_units);
+        }
+        if (wave.AudioFormat != coded.AudioFormat ||
+            wave.NumChannels != coded.NumChannels ||
+            wave.BlockAlign != coded.BlockAlign ||
+            wave.BitsPerSample != coded.BitsPerSample)
+        {
+            return false;
+        }
+
+        wave = coded;
+        if (rifx)
+            pcm_wave_swap_format(wave);
+        return pcm_wave_fseek(fp, pos, SEEK_SET) == 0 &&
+               std::fwrite(&wave.AudioFormat, 16, 1, fp) &&
+               std::fflush(fp) == 0;
+    }
 
     inline
-    void
-    PcmWave::get_info(uint16_t *NumChannels_,
-                      uint16_t *BitsPerSample_,
-                      uint32_t *SampleRate_)
+    bool PcmWave::is_rf64() const
     {
-        if (NumChannels_)
-            *NumChannels_ = m_wave.NumChannels;
-        if (BitsPerSample_)
-            *BitsPerSample_ = m_wave.BitsPerSample;
-        if (SampleRate_)
-            *SampleRate_ = m_wave.SampleRate;
+        return m_data_size > PCM_WAVE_SIZE32_MAX - 36 - sizeof(PCM_WAVE_DS64);
     }
 
+    // read from a big-endian file; the samples in memory are little-endian
     inline
-    void
-    PcmWave::set_info(uint16_t NumChannels_,
-                      uint16_t BitsPerSample_,
-                      uint32_t SampleRate_)
+    bool PcmWave::is_rifx() const
     {
-        m_wave.ChunkID = 0x46464952;
-        m_wave.Format = 0x45564157;
-        m_wave.Subchunk1ID = 0x20746d66;
-        m_wave.Subchunk2ID = 0x61746164;
-        m_wave.Subchunk1Size = 16;
-        m_wave.AudioFormat = 1;
-        m_wave.NumChannels = NumChannels_;
-        m_wave.SampleRate = SampleRate_;
+        return m_wave.ChunkID == PCM_WAVE_ID_RIFX;
+    }
+
+    // the payload is compressed ("PCMZ"); the samples in memory are PCM
+    inline
+    bool PcmWave::is_lossless() const
+    {
+        return m_wave.ChunkID == PCM_LOSSLESS_MAGIC;
+    }
+
+    // read from an IMA ADPCM file; the samples in memory are 16-bit PCM
+    inline
+    bool PcmWave::is_ima_adpcm() const
+    {
+        return m_wave.AudioFormat == PCM_WAVE_FORMAT_IMA_ADPCM;
+    }
+
+    // read from a G.711 file; the samples in memory are 16-bit PCM
+    inline
+    bool PcmWave::is_g711() const
+    {
+        return m_wave.AudioFormat == PCM_WAVE_FORMAT_MULAW ||
+               m_wave.AudioFormat == PCM_WAVE_FORMAT_ALAW;
+    }
+
+    inline
+    bool PcmWave::is_unsupported_format() const
+    {
+        if (m_wave.Subchunk1ID != 0x20746d66)
+            return false;
+        if (m_wave.AudioFormat != PCM_WAVE_FORMAT_PCM &&
+            m_wave.AudioFormat != PCM_WAVE_FORMAT_IMA_ADPCM &&
+            !is_g711())
+        {
+            return true;
+        }
+        return (m_wave.NumChannels != 1 && m_wave.NumChannels != 2) ||
+               (m_wave.BitsPerSample != 8 && m_wave.BitsPerSample != 16);
+    }
+
+    inline
+    bool PcmWave::is_ulaw() const
+    {
+        return m_wave.AudioFormat == PCM_WAVE_FORMAT_MULAW;
+    }
+
+    inline
+    uint16_t PcmWave::adpcm_block_align() const
+    {
+        return m_adpcm_align;
+    }
+
+    inline
+    uint16_t PcmWave::adpcm_block_units() const
+    {
+        return m_adpcm_units;
+    }
+
+    inline
+    bool PcmWave::read_from_fp(std::FILE *fp)
+    {
+        PCM_TRACE_SCOPE("read_from_fp");
+        PCM_LOSSLESS_HEADER lossless;
+        if (read_header_from_fp(fp, &lossless))
+        {
+            if (is_lossless())
+            {
+                PcmLosslessDecoder decoder;
+                if (decoder.open(fp, lossless))
+                {
+                    m_data.clear();
+                    uint8_t buf[64 * 1024];
+                    size_t n;
+                    while ((n = decoder.read(buf, sizeof(buf))) > 0)
+                    {
+                        m_data.insert(m_data.end(), buf, buf + n);
+                    }
+                    update_info();
+                    if (!decoder.error())
+                        return is_valid();
+                }
+            }
+            else if (is_ima_adpcm())
+            {
+                PcmAdpcmDecoder decoder;
+                if (decoder.open(fp, *this))
+                {
+                    uint64_t expected = m_data_size;
+                    m_data.clear();
+                    uint8_t buf[64 * 1024];
+                    size_t n;
+                    while ((n = decoder.read(buf, sizeof(buf))) > 0)
+                    {
+                        m_data.insert(m_data.end(), buf, buf + n);
+                    }
+                    if (expected != PCM_WAVE_SIZE_UNKNOWN && m_data.size() > expected)
+                        m_data.resize(size_t(expected));    // the padding of the last block
+                    update_info();
+                    return is_valid();
+                }
+            }
+            else if (is_g711())
+            {
+                std::vector<uint8_t> codes;
+                uint64_t left = m_data_size;
+                if (left != PCM_WAVE_SIZE_UNKNOWN)
+                    left /= 2;
+                uint8_t buf[64 * 1024];
+                size_t n;
+                while (left > 0 &&
+                       (n = std::fread(buf, 1, size_t(std::min<uint64_t>(left, sizeof(buf))), fp)) > 0)
+                {
+                    codes.insert(codes.end(), buf, buf + n);
+                    if (left != PCM_WAVE_SIZE_UNKNOWN)
+                        left -= n;
+                }
+                m_data.resize(codes.size() * 2);
+                if (!codes.empty())
+                {
+                    pcm_g711_decode(&codes[0], reinterpret_cast<int16_t *>(&m_data[0]), codes.size(),
+                                    is_ulaw());
+                }
+                const bool complete = (left == 0 || left == PCM_WAVE_SIZE_UNKNOWN);
+                update_info();
+                if (complete && m_data.size() % m_wave.BlockAlign == 0)
+                    return is_valid();
+            }
+            else if (m_data_size == PCM_WAVE_SIZE_UNKNOWN)
+            {
+                m_data.clear();
+                uint8_t buf[64 * 1024];
+                size_t n;
+                while ((n = std::fread(buf, 1, sizeof(buf), fp)) > 0)
+                {
+                    m_data.insert(m_data.end(), buf, buf + n);
+                }
+                if (is_rifx() && !m_data.empty())
+                    pcm_wave_swap_samples(&m_data[0], m_data.size(), m_wave.BitsPerSample);
+                update_info();
+                if (m_wave.BlockAlign && m_data.size() % m_wave.BlockAlign == 0)
+                    return is_valid();
+            }
+            else if (m_data_size <= size_t(-1))
+            {
+                m_data.resize(size_t(m_data_size));
+                if (m_data.empty() || std::fread(&m_data[0], m_data.size(), 1, fp))
+                {
+                    if (is_rifx() && !m_data.empty())
+                        pcm_wave_swap_samples(&m_data[0], m_data.size(), m_wave.BitsPerSample);
+                    if (uint32_t bits = m_wave.NumChannels * m_wave.BitsPerSample)
+                    {
+                        return is_valid();
+                    }
+                }
+            }
+        }
+        clear();
+        return false;
+    }
+
+    inline
+    bool PcmWave::write_to_fp(std::FILE *fp) const
+    {
+        PCM_TRACE_SCOPE("write_to_fp");
+        using namespace std;
+        if (!is_valid())
+            return false;
+
+        if (write_header_to_fp(fp) &&
+            std::fwrite(&m_data[0], m_data.size(), 1, fp))
+        {
+            return true;
+        }
+
+        return false;
+    }
+
+    inline
+    bool PcmWave::load_from_file(const char *file)
+    {
+        using namespace std;
+        clear();
+
+        bool flag = false;
+        if (FILE *fp = fopen(file, "rb"))
+        {
+            flag = read_from_fp(fp);
+            fclose(fp);
+        }
+        return flag;
+    }
+
+    inline
+    bool PcmWave::save_to_file(const char *file) const
+    {
+        using namespace std;
+        if (!is_valid())
+            return false;
+
+        bool flag = false;
+        if (FILE *fp = fopen(file, "wb"))
+        {
+            flag = write_to_fp(fp);
+            fclose(fp);
+        }
+        return flag;
+    }
+
+    #ifdef _WIN32
+        inline
+        bool PcmWave::load_from_file(const wchar_t *file)
+        {
+            using namespace std;
+            clear();
+
+            bool flag = false;
+            if (FILE *fp = _wfopen(file, L"rb"))
+            {
+                flag = read_from_fp(fp);
+                fclose(fp);
+            }
+            return flag;
+        }
+
+        inline
+        bool PcmWave::save_to_file(const wchar_t *file) const
+        {
+            using namespace std;
+            if (!is_valid())
+                return false;
+
+            bool flag = false;
+            if (FILE *fp = _wfopen(file, L"wb"))
+            {
+                flag = write_to_fp(fp);
+                fclose(fp);
+            }
+            return flag;
+        }
+    #endif  // def _WIN32
+
+    inline
+    void
+    PcmWave::get_info(uint16_t *NumChannels_,
+                      uint16_t *BitsPerSample_,
+                      uint32_t *SampleRate_)
+    {
+        if (NumChannels_)
+            *NumChannels_ = m_wave.NumChannels;
+        if (BitsPerSample_)
+            *BitsPerSample_ = m_wave.BitsPerSample;
+        if (SampleRate_)
+            *SampleRate_ = m_wave.SampleRate;
+    }
+
+    inline
+    void
+    PcmWave::set_info(uint16_t NumChannels_,
+                      uint16_t BitsPerSample_,
+                      uint32_t SampleRate_)
+    {
+        m_wave.ChunkID = 0x46464952;
+        m_wave.Format = 0x45564157;
+        m_wave.Subchunk1ID = 0x20746d66;
+        m_wave.Subchunk2ID = 0x61746164;
+        m_wave.Subchunk1Size = 16;
+        m_wave.AudioFormat = 1;
+        m_wave.NumChannels = NumChannels_;
+        m_wave.SampleRate = SampleRate_;
         m_wave.BitsPerSample = BitsPerSample_;
         m_wave.Subchunk2Size = 0;  // for set_data
         m_wave.ChunkSize = 0;  // for set_data
@@ -347,6 +1275,22 @@ typedef struct PCM_WAVE
         update_info();
     }
 
+    inline
+    void PcmWave::adopt_data(data_type&& data)
+    {
+        m_data = std::move(data);
+        update_info();
+    }
+
+    inline
+    PcmWave::data_type PcmWave::release_data()
+    {
+        data_type data;
+        data.swap(m_data);
+        update_info();
+        return data;
+    }
+
     inline
     void PcmWave::resize(size_t data_size)
     {
@@ -367,66 +1311,43 @@ typedef struct PCM_WAVE
             return false;
 
         if (empty())
-        {
-            assert(0);
             return false;
-        }
-        if (m_wave.Subchunk2Size != m_data.size())
-        {
-            assert(0);
+        if (m_data_size != m_data.size())
             return false;
-        }
         if (0 && m_wave.ChunkSize != 36 + m_wave.Subchunk2Size)
-        {
-            assert(0);
             return false;
-        }
         return true;
     }
 
     inline
     bool PcmWave::is_valid0() const
     {
-        if (m_wave.ChunkID != 0x46464952)
+        if (m_wave.ChunkID != 0x46464952 &&
+            m_wave.ChunkID != PCM_WAVE_ID_RF64 &&
+            m_wave.ChunkID != PCM_WAVE_ID_BW64 &&
+            m_wave.ChunkID != PCM_WAVE_ID_RIFX &&
+            m_wave.ChunkID != PCM_LOSSLESS_MAGIC)
         {
-            assert(0);
             return false;
         }
         if (m_wave.Format != 0x45564157)
-        {
-            assert(0);
             return false;
-        }
         if (m_wave.Subchunk1ID != 0x20746d66)
-        {
-            assert(0);
             return false;
-        }
         if (m_wave.Subchunk2ID != 0x61746164)
-        {
-            assert(0);
             return false;
-        }
-        if (m_wave.Subchunk1Size != 16)
-        {
-            assert(0);
+        if (m_wave.Subchunk1Size < 16)
             return false;
-        }
-        if (m_wave.AudioFormat != 1)
+        if (m_wave.AudioFormat != PCM_WAVE_FORMAT_PCM &&
+            m_wave.AudioFormat != PCM_WAVE_FORMAT_IMA_ADPCM &&
+            !is_g711())
         {
-            assert(0);
             return false;
         }
         if (m_wave.ByteRate != m_wave.SampleRate * m_wave.NumChannels * m_wave.BitsPerSample / 8)
-        {
-            assert(0);
             return false;
-        }
         if (m_wave.BlockAlign != m_wave.NumChannels * m_wave.BitsPerSample / 8)
-        {
-            assert(0);
             return false;
-        }
         return true;
     }
 
@@ -461,8 +1382,29 @@ typedef struct PCM_WAVE
         m_wave.ByteRate = m_wave.SampleRate * m_wave.NumChannels * m_wave.BitsPerSample / 8;
         m_wave.BlockAlign = m_wave.NumChannels * m_wave.BitsPerSample / 8;
 
-        m_wave.Subchunk2Size = m_data.size();
-        m_wave.ChunkSize = 36 + m_wave.Subchunk2Size;
+        data_size(m_data.size());
+    }
+
+    inline
+    uint64_t PcmWave::data_size() const
+    {
+        return m_data_size;
+    }
+
+    inline
+    void PcmWave::data_size(uint64_t size)
+    {
+        m_data_size = size;
+        if (is_rf64())
+        {
+            m_wave.Subchunk2Size = PCM_WAVE_SIZE32_MAX;
+            m_wave.ChunkSize = PCM_WAVE_SIZE32_MAX;
+        }
+        else
+        {
+            m_wave.Subchunk2Size = uint32_t(size);
+            m_wave.ChunkSize = 36 + m_wave.Subchunk2Size;
+        }
     }
 
     inline
@@ -532,9 +1474,9 @@ typedef struct PCM_WAVE
     }
 
     inline
-    uint32_t PcmWave::num_units() const
+    uint64_t PcmWave::num_units() const
     {
-        return size() / data_unit();
+        return data_size() / data_unit();
     }
 
     inline
@@ -568,10 +1510,1358 @@ typedef struct PCM_WAVE
     }
 
     inline
-    float PcmWave::seconds() const
+    double PcmWave::seconds() const
+    {
+        return double(m_data_size) / m_wave.NumChannels /
+               m_wave.SampleRate / (m_wave.BitsPerSample / 8);
+    }
+
+    inline
+    PcmWaveView::PcmWaveView()
+        : m_channels(PCM_WAVE_DEFAULT_CHANNELS), m_bits(PCM_WAVE_DEFAULT_BITSPERSAMPLE),
+          m_rate(PCM_WAVE_DEFAULT_SAMPLE_RATE), m_data(NULL), m_size(0)
+    {
+    }
+
+    inline
+    PcmWaveView::PcmWaveView(const PcmWave& wave)
+        : m_channels(wave.num_channels()), m_bits(wave.mode()),
+          m_rate(wave.sample_rate()), m_data(NULL), m_size(wave.size())
+    {
+        if (m_size)
+            m_data = &wave.data_8bit(0);
+    }
+
+    inline
+    PcmWaveView::PcmWaveView(uint16_t NumChannels_,
+                             uint16_t BitsPerSample_,
+                             uint32_t SampleRate_,
+                             const void *data, size_t data_size)
+        : m_channels(NumChannels_), m_bits(BitsPerSample_), m_rate(SampleRate_),
+          m_data(static_cast<const uint8_t *>(data)), m_size(data ? data_size : 0)
+    {
+    }
+
+    inline
+    bool PcmWaveView::empty() const
+    {
+        return m_size == 0;
+    }
+
+    inline
+    size_t PcmWaveView::size() const
+    {
+        return m_size;
+    }
+
+    inline
+    bool PcmWaveView::is_valid() const
+    {
+        if (m_channels != 1 && m_channels != 2)
+            return false;
+        if (m_bits != 8 && m_bits != 16)
+            return false;
+        if (m_rate == 0)
+            return false;
+        return m_size % data_unit() == 0;
+    }
+
+    inline
+    bool PcmWaveView::is_mono() const
+    {
+        return m_channels == 1;
+    }
+
+    inline
+    bool PcmWaveView::is_stereo() const
+    {
+        return m_channels == 2;
+    }
+
+    inline
+    uint16_t PcmWaveView::num_channels() const
+    {
+        return m_channels;
+    }
+
+    inline
+    uint32_t PcmWaveView::sample_rate() const
+    {
+        return m_rate;
+    }
+
+    inline
+    bool PcmWaveView::mode_8bit() const
+    {
+        return m_bits == 8;
+    }
+
+    inline
+    bool PcmWaveView::mode_16bit() const
+    {
+        return m_bits == 16;
+    }
+
+    inline
+    uint16_t PcmWaveView::mode() const
+    {
+        return m_bits;
+    }
+
+    inline
+    uint16_t PcmWaveView::data_unit() const
+    {
+        return m_channels * m_bits / 8;
+    }
+
+    inline
+    uint64_t PcmWaveView::num_units() const
+    {
+        return m_size / data_unit();
+    }
+
+    inline
+    uint64_t PcmWaveView::data_size() const
+    {
+        return m_size;
+    }
+
+    inline
+    const void *PcmWaveView::data() const
+    {
+        return m_data;
+    }
+
+    inline
+    const uint8_t& PcmWaveView::data_8bit(size_t index) const
+    {
+        assert(index * sizeof(uint8_t) < m_size);
+        return m_data[index * sizeof(uint8_t)];
+    }
+
+    inline
+    const int16_t& PcmWaveView::data_16bit(size_t index) const
+    {
+        assert(index * sizeof(int16_t) < m_size);
+        return reinterpret_cast<const int16_t&>(m_data[index * sizeof(int16_t)]);
+    }
+
+    inline
+    PcmWaveView PcmWaveView::units(uint64_t first, uint64_t count) const
+    {
+        uint64_t total = num_units();
+        if (first > total)
+            first = total;
+        if (count > total - first)
+            count = total - first;
+        return PcmWaveView(m_channels, m_bits, m_rate,
+                           m_data + size_t(first) * data_unit(),
+                           size_t(count) * data_unit());
+    }
+
+    inline
+    double PcmWaveView::seconds() const
+    {
+        return double(m_size) / m_channels / m_rate / (m_bits / 8);
+    }
+
+    inline
+    PcmLosslessEncoder::PcmLosslessEncoder()
+        : m_fp(NULL), m_header_pos(-1), m_unit(0), m_frames(0), m_offset(0)
+    {
+    }
+
+    inline
+    bool PcmLosslessEncoder::open(std::FILE *fp, uint16_t NumChannels_,
+                                  uint16_t BitsPerSample_, uint32_t SampleRate_,
+                                  uint64_t frames)
+    {
+        if (NumChannels_ == 0 || (BitsPerSample_ != 8 && BitsPerSample_ != 16) ||
+            size_t(PCM_LOSSLESS_BLOCK_UNITS) * NumChannels_ * BitsPerSample_ / 8 >
+                PCM_LOSSLESS_MAX_BLOCK_SIZE)
+        {
+            return false;
+        }
+
+        memset(&m_header, 0, sizeof(m_header));
+        m_header.Magic = PCM_LOSSLESS_MAGIC;
+        m_header.Version = PCM_LOSSLESS_VERSION;
+        m_header.NumChannels = NumChannels_;
+        m_header.BitsPerSample = BitsPerSample_;
+        m_header.SampleRate = SampleRate_;
+        m_header.BlockUnits = PCM_LOSSLESS_BLOCK_UNITS;
+        m_header.FramesLow = uint32_t(frames);
+        m_header.FramesHigh = uint32_t(frames >> 32);
+
+        m_header_pos = pcm_wave_is_seekable(fp) ? pcm_wave_ftell(fp) : -1;
+        m_unit = size_t(NumChannels_) * BitsPerSample_ / 8;
+        m_frames = 0;
+        m_offset = sizeof(m_header);
+        m_pending.clear();
+        m_table.clear();
+        if (!std::fwrite(&m_header, sizeof(m_header), 1, fp))
+            return false;
+
+        m_fp = fp;
+        return true;
+    }
+
+    inline
+    bool PcmLosslessEncoder::write(const void *data, size_t data_size)
+    {
+        if (!m_fp)
+            return false;
+
+        assert(data_size % m_unit == 0);
+        const uint8_t *p = static_cast<const uint8_t *>(data);
+        m_pending.insert(m_pending.end(), p, p + data_size);
+        if (m_pending.size() >= PCM_LOSSLESS_BATCH * PCM_LOSSLESS_BLOCK_UNITS * m_unit)
+            return flush(false);
+        return true;
+    }
+
+    // encodes the whole blocks of m_pending, and the partial one if last
+    inline
+    bool PcmLosslessEncoder::flush(bool last)
+    {
+        const size_t block_size = PCM_LOSSLESS_BLOCK_UNITS * m_unit;
+        size_t count = m_pending.size() / block_size;
+        if (last && m_pending.size() % block_size)
+            ++count;
+        if (count == 0)
+            return true;
+
+        std::vector<std::vector<uint8_t> > blocks(count);
+        pcm_parallel_for(count, 1, [&](size_t, size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+            {
+                size_t offset = i * block_size;
+                size_t size = std::min(block_size, m_pending.size() - offset);
+                uint32_t frames = uint32_t(size / m_unit);
+
+                std::vector<uint8_t>& out = blocks[i];
+                out.resize(2 * sizeof(uint32_t));
+                pcm_lossless_encode_block(&m_pending[offset], frames, m_header.NumChannels,
+                                          m_header.BitsPerSample, out);
+                uint32_t head[2] = { uint32_t(out.size() - sizeof(head)), frames };
+                memcpy(&out[0], head, sizeof(head));
+            }
+        });
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (!std::fwrite(&blocks[i][0], blocks[i].size(), 1, m_fp))
+                return false;
+            m_table.push_back(m_offset);
+            m_offset += blocks[i].size();
+        }
+
+        size_t used = std::min(count * block_size, m_pending.size());
+        m_frames += used / m_unit;
+        m_pending.erase(m_pending.begin(), m_pending.begin() + used);
+        return true;
+    }
+
+    inline
+    bool PcmLosslessEncoder::close()
+    {
+        if (!m_fp)
+            return true;
+
+        std::FILE *fp = m_fp;
+        bool ok = flush(true);
+        m_fp = NULL;
+
+        // the end marker and the seek table
+        uint32_t marker[2] = { 0, 0 };
+        uint32_t count = uint32_t(m_table.size());
+        uint64_t table = m_offset + sizeof(marker);
+        ok = ok && std::fwrite(marker, sizeof(marker), 1, fp) &&
+             std::fwrite(&count, sizeof(count), 1, fp) &&
+             (m_table.empty() || std::fwrite(&m_table[0], m_table.size() * sizeof(uint64_t), 1, fp));
+        if (!ok)
+            return false;
+
+        if (m_header_pos < 0)
+        {
+            uint64_t expected = (uint64_t(m_header.FramesHigh) << 32) | m_header.FramesLow;
+            if (expected != PCM_WAVE_SIZE_UNKNOWN && expected != m_frames)
+                return false;   // the header on the pipe is wrong
+            return std::fflush(fp) == 0;
+        }
+
+        m_header.FramesLow = uint32_t(m_frames);
+        m_header.FramesHigh = uint32_t(m_frames >> 32);
+        m_header.TableLow = uint32_t(table);
+        m_header.TableHigh = uint32_t(table >> 32);
+        int64_t end = pcm_wave_ftell(fp);
+        return pcm_wave_fseek(fp, m_header_pos, SEEK_SET) == 0 &&
+               std::fwrite(&m_header, sizeof(m_header), 1, fp) &&
+               pcm_wave_fseek(fp, end, SEEK_SET) == 0 &&
+               std::fflush(fp) == 0;
+    }
+
+    inline
+    PcmLosslessDecoder::PcmLosslessDecoder()
+        : m_fp(NULL), m_header_pos(-1), m_file_size(-1), m_unit(0), m_block(0),
+          m_position(0), m_end(true), m_error(false), m_pcm_pos(0)
+    {
+    }
+
+    // fp is just after the header
+    inline
+    bool PcmLosslessDecoder::open(std::FILE *fp, const PCM_LOSSLESS_HEADER& header)
+    {
+        if (header.NumChannels == 0 || header.BlockUnits == 0 ||
+            (header.BitsPerSample != 8 && header.BitsPerSample != 16) ||
+            uint64_t(header.BlockUnits) * header.NumChannels * header.BitsPerSample / 8 >
+                PCM_LOSSLESS_MAX_BLOCK_SIZE)
+        {
+            return false;
+        }
+
+        m_fp = fp;
+        m_header = header;
+        m_header_pos = pcm_wave_is_seekable(fp) ? pcm_wave_ftell(fp) - int64_t(sizeof(header)) : -1;
+        m_file_size = -1;
+        if (m_header_pos >= 0)
+        {
+            int64_t pos = pcm_wave_ftell(fp);
+            if (pcm_wave_fseek(fp, 0, SEEK_END) == 0)
+                m_file_size = pcm_wave_ftell(fp);
+            if (pcm_wave_fseek(fp, pos, SEEK_SET) != 0)
+                return false;
+        }
+        m_unit = size_t(header.NumChannels) * header.BitsPerSample / 8;
+        m_block = m_position = 0;
+        m_end = m_error = false;
+        m_pcm.clear();
+        m_pcm_pos = 0;
+        m_table.clear();
+        return true;
+    }
+
+    inline
+    bool PcmLosslessDecoder::error() const
+    {
+        return m_error;
+    }
+
+    inline
+    size_t PcmLosslessDecoder::read(void *data, size_t data_size)
+    {
+        uint8_t *dest = static_cast<uint8_t *>(data);
+        data_size -= data_size % (m_unit ? m_unit : 1);
+
+        size_t got = 0;
+        while (got < data_size)
+        {
+            if (m_pcm_pos == m_pcm.size() && !decode_batch())
+                break;
+            size_t n = std::min(data_size - got, m_pcm.size() - m_pcm_pos);
+            memcpy(dest + got, &m_pcm[m_pcm_pos], n);
+            m_pcm_pos += n;
+            got += n;
+        }
+        m_position += got / m_unit;
+        return got;
+    }
+
+    // reads and decodes the next batch of blocks into m_pcm
+    inline
+    bool PcmLosslessDecoder::decode_batch()
+    {
+        m_pcm.clear();
+        m_pcm_pos = 0;
+        if (m_end || !m_fp)
+            return false;
+
+        const size_t max_frames = m_header.BlockUnits;
+        size_t max_payload = max_frames * m_unit * 2 + 1024;
+        if (m_file_size >= 0)
+        {
+            // a block can't run past the end of the file
+            int64_t pos = pcm_wave_ftell(m_fp);
+            if (pos < 0 || pos > m_file_size)
+            {
+                m_error = m_end = true;
+                return false;
+            }
+            max_payload = size_t(std::min<uint64_t>(max_payload, uint64_t(m_file_size - pos)));
+        }
+        std::vector<std::vector<uint8_t> > payloads;
+        std::vector<size_t> offsets;
+        size_t total = 0;
+        while (payloads.size() < PCM_LOSSLESS_BATCH)
+        {
+            // a truncated or broken stream keeps the blocks before the damage
+            uint32_t head[2];   // size, frames
+            if (!std::fread(head, sizeof(head), 1, m_fp) ||
+                head[1] > max_frames || head[0] > max_payload)
+            {
+                m_error = m_end = true;
+                break;
+            }
+            if (head[1] == 0)
+            {
+                m_end = true;
+                break;
+            }
+
+            payloads.emplace_back(head[0]);
+            if (head[0] && !std::fread(&payloads.back()[0], head[0], 1, m_fp))
+            {
+                payloads.pop_back();
+                m_error = m_end = true;
+                break;
+            }
+            offsets.push_back(total);
+            total += head[1] * m_unit;
+            if (m_file_size >= 0)
+                max_payload -= std::min<size_t>(max_payload, sizeof(head) + head[0]);
+        }
+        offsets.push_back(total);
+
+        m_pcm.resize(total);
+        std::vector<char> ok(payloads.size(), 0);
+        pcm_parallel_for(payloads.size(), 1, [&](size_t, size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+            {
+                size_t frames = (offsets[i + 1] - offsets[i]) / m_unit;
+                const uint8_t *payload = payloads[i].empty() ? NULL : &payloads[i][0];
+                ok[i] = pcm_lossless_decode_block(payload, payloads[i].size(), frames,
+                                                  m_header.NumChannels,
+                                                  m_header.BitsPerSample, &m_pcm[offsets[i]]);
+            }
+        });
+        m_block += payloads.size();
+
+        for (size_t i = 0; i < ok.size(); ++i)
+        {
+            if (!ok[i])
+            {
+                m_pcm.resize(offsets[i]);
+                m_error = m_end = true;
+                break;
+            }
+        }
+        return !m_pcm.empty();
+    }
+
+    inline
+    bool PcmLosslessDecoder::load_table()
+    {
+        if (!m_table.empty())
+            return true;
+
+        uint64_t table = (uint64_t(m_header.TableHigh) << 32) | m_header.TableLow;
+        if (m_header_pos < 0 || table == 0)
+            return false;
+
+        // the table can't be bigger than the rest of the file, nor hold more
+        // blocks than the frames of the header make
+        uint64_t frames = (uint64_t(m_header.FramesHigh) << 32) | m_header.FramesLow;
+        uint64_t blocks = frames / m_header.BlockUnits + (frames % m_header.BlockUnits != 0);
+        int64_t pos = pcm_wave_ftell(m_fp);
+        uint32_t count;
+        bool ok = pos >= 0 && m_file_size >= 0 &&
+                  table <= uint64_t(m_file_size - m_header_pos) &&
+                  pcm_wave_fseek(m_fp, m_header_pos + int64_t(table), SEEK_SET) == 0 &&
+                  std::fread(&count, sizeof(count), 1, m_fp) && count > 0 &&
+                  count <= (uint64_t(m_file_size - m_header_pos) - table) / sizeof(uint64_t) &&
+                  (frames == PCM_WAVE_SIZE_UNKNOWN || count == blocks);
+        if (ok)
+        {
+            m_table.resize(count);
+            ok = std::fread(&m_table[0], count * sizeof(uint64_t), 1, m_fp) == 1;
+        }
+        if (!ok)
+            m_table.clear();
+        return pcm_wave_fseek(m_fp, pos, SEEK_SET) == 0 && ok;
+    }
+
+    inline
+    bool PcmLosslessDecoder::seek(uint64_t unit)
+    {
+        if (!m_fp)
+            return false;
+
+        const uint64_t block_units = m_header.BlockUnits;
+        uint64_t block = unit / block_units;
+        if (m_header_pos >= 0 && load_table())
+        {
+            m_pcm.clear();
+            m_pcm_pos = 0;
+            if (block >= m_table.size())
+            {
+                // at or past the end
+                m_block = m_table.size();
+                m_position = unit;
+                m_end = true;
+                return true;
+            }
+            if (pcm_wave_fseek(m_fp, m_header_pos + int64_t(m_table[block]), SEEK_SET) != 0)
+                return false;
+            m_block = block;
+            m_position = block * block_units;
+            m_end = m_error = false;
+        }
+        else if (unit < m_position)
+        {
+            return false;   // a pipe can only go forward
+        }
+
+        while (m_position < unit)
+        {
+            uint64_t left = unit - m_position;
+            if (m_pcm_pos < m_pcm.size())
+            {
+                size_t n = size_t(std::min<uint64_t>(left, (m_pcm.size() - m_pcm_pos) / m_unit));
+                m_pcm_pos += n * m_unit;
+                m_position += n;
+                continue;
+            }
+            if (m_end)
+                break;
+
+            if (left >= block_units)
+            {
+                // skip a whole block without decoding it
+                uint32_t head[2];
+                if (!std::fread(head, sizeof(head), 1, m_fp))
+                    return false;
+                if (head[1] == 0)
+                {
+                    m_end = true;
+                    break;
+                }
+                if (!pcm_wave_skip(m_fp, head[0]))
+                    return false;
+                ++m_block;
+                m_position += head[1];
+                continue;
+            }
+            if (!decode_batch())
+                break;
+        }
+        return !m_error;
+    }
+
+    inline
+    PcmAdpcmEncoder::PcmAdpcmEncoder()
+        : m_fp(NULL), m_channels(0), m_align(0), m_units(0)
+    {
+    }
+
+    inline
+    bool PcmAdpcmEncoder::open(std::FILE *fp, uint16_t NumChannels_, uint32_t SampleRate_)
+    {
+        if (NumChannels_ == 0)
+            return false;
+        m_fp = fp;
+        m_channels = NumChannels_;
+        m_align = pcm_ima_block_align(NumChannels_, SampleRate_);
+        m_units = pcm_ima_block_units(m_align, NumChannels_);
+        m_pending.clear();
+        return true;
+    }
+
+    inline
+    bool PcmAdpcmEncoder::write(const void *data, size_t data_size)
+    {
+        if (!m_fp)
+            return false;
+
+        const uint8_t *p = static_cast<const uint8_t *>(data);
+        m_pending.insert(m_pending.end(), p, p + data_size);
+        if (m_pending.size() >= PCM_ADPCM_BATCH * m_units * m_channels * sizeof(int16_t))
+            return flush(false);
+        return true;
+    }
+
+    // encodes the whole blocks of m_pending, and the partial one if last
+    inline
+    bool PcmAdpcmEncoder::flush(bool last)
+    {
+        const size_t frame_size = m_channels * sizeof(int16_t);
+        const size_t frames = m_pending.size() / frame_size;
+        size_t count = frames / m_units;
+        if (last && frames % m_units)
+            ++count;
+        if (count == 0)
+            return true;
+
+        m_coded.assign(count * m_align, 0);
+        pcm_parallel_for(count, 1, [&](size_t, size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+            {
+                size_t first = i * m_units;
+                size_t n = std::min(m_units, frames - first);
+                const int16_t *pcm = reinterpret_cast<const int16_t *>(&m_pending[first * frame_size]);
+                pcm_ima_encode_block(pcm, n, m_channels, &m_coded[i * m_align], m_align);
+            }
+        });
+        if (!std::fwrite(&m_coded[0], m_coded.size(), 1, m_fp))
+            return false;
+
+        size_t used = std::min(count * m_units, frames) * frame_size;
+        m_pending.erase(m_pending.begin(), m_pending.begin() + used);
+        return true;
+    }
+
+    inline
+    bool PcmAdpcmEncoder::close()
+    {
+        if (!m_fp)
+            return true;
+        bool ok = flush(true);
+        m_fp = NULL;
+        return ok;
+    }
+
+    inline
+    PcmAdpcmDecoder::PcmAdpcmDecoder()
+        : m_fp(NULL), m_channels(0), m_align(0), m_units(0), m_data_pos(-1),
+          m_blocks(0), m_block(0), m_position(0), m_end(true), m_pcm_pos(0)
+    {
+    }
+
+    inline
+    bool PcmAdpcmDecoder::open(std::FILE *fp, const PcmWave& header)
+    {
+        if (!header.is_ima_adpcm() || !header.adpcm_block_align())
+            return false;
+
+        m_fp = fp;
+        m_channels = header.num_channels();
+        m_align = header.adpcm_block_align();
+        m_units = header.adpcm_block_units();
+        m_data_pos = pcm_wave_is_seekable(fp) ? pcm_wave_ftell(fp) : -1;
+        m_blocks = PCM_WAVE_SIZE_UNKNOWN;
+        if (header.data_size() != PCM_WAVE_SIZE_UNKNOWN)
+            m_blocks = (header.num_units() + m_units - 1) / m_units;
+        m_block = m_position = 0;
+        m_end = false;
+        m_pcm.clear();
+        m_pcm_pos = 0;
+        return true;
+    }
+
+    inline
+    size_t PcmAdpcmDecoder::read(void *data, size_t data_size)
+    {
+        const size_t frame_size = m_channels * sizeof(int16_t);
+        uint8_t *dest = static_cast<uint8_t *>(data);
+        data_size -= data_size % frame_size;
+
+        size_t got = 0;
+        while (got < data_size)
+        {
+            if (m_pcm_pos == m_pcm.size() && !decode_batch())
+                break;
+            size_t n = std::min(data_size - got, m_pcm.size() - m_pcm_pos);
+            memcpy(dest + got, &m_pcm[m_pcm_pos], n);
+            m_pcm_pos += n;
+            got += n;
+        }
+        m_position += got / frame_size;
+        return got;
+    }
+
+    // reads and decodes the next batch of blocks into m_pcm
+    inline
+    bool PcmAdpcmDecoder::decode_batch()
+    {
+        m_pcm.clear();
+        m_pcm_pos = 0;
+        if (m_end || !m_fp)
+            return false;
+
+        uint64_t count = PCM_ADPCM_BATCH;
+        if (m_blocks != PCM_WAVE_SIZE_UNKNOWN && count > m_blocks - m_block)
+            count = m_blocks - m_block;
+        m_coded.resize(size_t(count) * m_align);
+        size_t got = count ? std::fread(&m_coded[0], 1, m_coded.size(), m_fp) : 0;
+        if (got < m_coded.size())
+            m_end = true;
+
+        // a short last block has fewer frames
+        size_t full = got / m_align;
+        size_t tail = std::min(m_units, pcm_ima_block_units(got % m_align, m_channels));
+        size_t blocks = full + (tail ? 1 : 0);
+        const size_t frame_size = m_channels * sizeof(int16_t);
+        m_pcm.resize((full * m_units + tail) * frame_size);
+
+        std::vector<char> ok(blocks, 0);
+        pcm_parallel_for(blocks, 1, [&](size_t, size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+            {
+                size_t frames = (i < full) ? m_units : tail;
+                size_t size = (i < full) ? m_align : got % m_align;
+                int16_t *pcm = reinterpret_cast<int16_t *>(&m_pcm[i * m_units * frame_size]);
+                ok[i] = pcm_ima_decode_block(&m_coded[i * m_align], size, m_channels, pcm, frames);
+            }
+        });
+        m_block += blocks;
+
+        for (size_t i = 0; i < ok.size(); ++i)
+        {
+            if (!ok[i])
+            {
+                // a broken block ends the payload
+                m_pcm.resize(i * m_units * frame_size);
+                m_end = true;
+                break;
+            }
+        }
+        return !m_pcm.empty();
+    }
+
+    inline
+    bool PcmAdpcmDecoder::seek(uint64_t unit)
+    {
+        if (!m_fp)
+            return false;
+
+        if (m_data_pos >= 0)
+        {
+            uint64_t block = unit / m_units;
+            if (pcm_wave_fseek(m_fp, m_data_pos + int64_t(block * m_align), SEEK_SET) != 0)
+                return false;
+            m_pcm.clear();
+            m_pcm_pos = 0;
+            m_block = block;
+            m_position = block * m_units;
+            m_end = (m_blocks != PCM_WAVE_SIZE_UNKNOWN && block >= m_blocks);
+        }
+        else if (unit < m_position)
+        {
+            return false;   // a pipe can only go forward
+        }
+
+        while (m_position < unit)
+        {
+            uint64_t left = unit - m_position;
+            if (m_pcm_pos < m_pcm.size())
+            {
+                const size_t frame_size = m_channels * sizeof(int16_t);
+                size_t n = size_t(std::min<uint64_t>(left, (m_pcm.size() - m_pcm_pos) / frame_size));
+                m_pcm_pos += n * frame_size;
+                m_position += n;
+                continue;
+            }
+            if (m_end)
+                break;
+
+            if (left >= m_units)
+            {
+                // skip whole blocks without decoding them
+                uint64_t count = left / m_units;
+                if (m_blocks != PCM_WAVE_SIZE_UNKNOWN && count > m_blocks - m_block)
+                    count = m_blocks - m_block;
+                if (!pcm_wave_skip(m_fp, count * m_align))
+                    return false;
+                m_block += count;
+                m_position += count * m_units;
+                if (m_blocks != PCM_WAVE_SIZE_UNKNOWN && m_block >= m_blocks)
+                    m_end = true;
+                continue;
+            }
+            if (!decode_batch())
+                break;
+        }
+        return true;
+    }
+
+    // Reads the payload of a wave file block by block.
+    class PcmWaveReader
+    {
+    public:
+        PcmWaveReader();
+
+        bool open(std::FILE *fp);
+        const PcmWave& header() const;
+        bool is_seekable() const;
+
+        // reads up to max_units frames into block; returns the frames read
+        size_t read(PcmWave& block, size_t max_units);
+        // the same into the caller's memory, with room for max_units frames
+        size_t read(void *frames, size_t max_units);
+        bool eof() const;
+
+        // restricts reading to the frames [begin, end); seeks if possible
+        bool seek_range(uint64_t begin, uint64_t end = PCM_WAVE_SIZE_UNKNOWN);
+        // the frames left to read, or PCM_WAVE_SIZE_UNKNOWN
+        uint64_t remaining_units() const;
+
+    protected:
+        std::FILE *m_fp;
+        PcmWave m_header;
+        int64_t m_data_pos;     // file position of the payload; -1 if not seekable
+        uint64_t m_offset;      // in bytes from the payload start
+        uint64_t m_remaining;   // in bytes
+        std::unique_ptr<PcmLosslessDecoder> m_lossless;     // for "PCMZ"
+        std::unique_ptr<PcmAdpcmDecoder> m_adpcm;           // for IMA ADPCM
+        std::vector<uint8_t> m_codes;                       // for G.711
+
+        friend class PcmWaveWriter;
+    }; // class PcmWaveReader
+
+    // A position given in seconds ("1.5", "1.5s") or in frames ("12000f").
+    struct PcmWaveTime
+    {
+        double value = -1;      // not specified if negative
+        bool frames = false;
+
+        bool parse(const char *str);
+        bool empty() const;
+        uint64_t to_units(uint32_t rate) const;
+    };
+
+    // Writes a wave file frame by frame. The header is written first with
+    // placeholder sizes. On a seekable stream it is patched by close(), and
+    // upgraded to RF64 if needed; otherwise the sizes stay 0xFFFFFFFF.
+    class PcmWaveWriter
+    {
+    public:
+        PcmWaveWriter();
+        ~PcmWaveWriter();
+
+        // data_size, if known, gives a pipe the exact sizes instead of 0xFFFFFFFF
+        bool open(std::FILE *fp,
+                  uint16_t NumChannels_,
+                  uint16_t BitsPerSample_,
+                  uint32_t SampleRate_,
+                  uint64_t data_size = PCM_WAVE_SIZE_UNKNOWN,
+                  int flags = 0);   // PCM_WAVE_HEADER_RIFX, _LOSSLESS, _IMA_ADPCM, ...
+        bool write(const void *data, size_t data_size);
+        bool write(const PcmWave& block);
+        bool write(const PcmWaveView& block);
+        // copies the rest of the payload of reader, which has the same format.
+        // On Linux, the kernel copies it if possible (copy_file_range/sendfile).
+        bool copy_from(PcmWaveReader& reader);
+        bool close();
+
+        bool is_seekable() const;
+        const PcmWave& header() const;
+
+    protected:
+        std::FILE *m_fp;
+        PcmWave m_header;
+        int64_t m_header_pos;   // -1 if not seekable
+        uint64_t m_expected;    // the data size given to open()
+        int m_flags;            // PCM_WAVE_HEADER_RIFX, _LOSSLESS, _IMA_ADPCM, _MULAW, _ALAW
+        bool m_junk;            // the header has a JUNK chunk
+        std::vector<uint8_t> m_swap;    // the samples in big-endian
+        std::unique_ptr<PcmLosslessEncoder> m_lossless;     // for "PCMZ"
+        std::unique_ptr<PcmAdpcmEncoder> m_adpcm;           // for IMA ADPCM
+        std::vector<uint8_t> m_codes;                       // for G.711
+
+        bool copy_in_kernel(PcmWaveReader& reader, uint64_t size);
+        bool fits_riff(uint64_t data_size) const;
+
+        PcmWaveWriter(const PcmWaveWriter&) = delete;
+        PcmWaveWriter& operator=(const PcmWaveWriter&) = delete;
+    }; // class PcmWaveWriter
+
+    inline
+    PcmWaveReader::PcmWaveReader()
+        : m_fp(NULL), m_data_pos(-1), m_offset(0), m_remaining(0)
+    {
+    }
+
+    inline
+    bool PcmWaveReader::open(std::FILE *fp)
+    {
+        m_fp = NULL;
+        m_offset = m_remaining = 0;
+        m_lossless.reset();
+        m_adpcm.reset();
+
+        PCM_LOSSLESS_HEADER lossless;
+        if (!m_header.read_header_from_fp(fp, &lossless) || !m_header.data_unit())
+            return false;
+        if (m_header.is_lossless())
+        {
+            m_lossless.reset(new PcmLosslessDecoder());
+            if (!m_lossless->open(fp, lossless))
+                return false;
+        }
+        if (m_header.is_ima_adpcm())
+        {
+            m_adpcm.reset(new PcmAdpcmDecoder());
+            if (!m_adpcm->open(fp, m_header))
+                return false;
+        }
+
+        m_fp = fp;
+        m_data_pos = pcm_wave_is_seekable(fp) ? pcm_wave_ftell(fp) : -1;
+        m_remaining = m_header.data_size();
+        return true;
+    }
+
+    inline
+    const PcmWave& PcmWaveReader::header() const
+    {
+        return m_header;
+    }
+
+    inline
+    bool PcmWaveReader::is_seekable() const
+    {
+        return m_data_pos >= 0;
+    }
+
+    inline
+    size_t PcmWaveReader::read(PcmWave& block, size_t max_units)
+    {
+        block.set_info(m_header.num_channels(), m_header.mode(), m_header.sample_rate());
+        if (!m_fp)
+        {
+            block.resize(0);
+            return 0;
+        }
+
+        uint16_t unit = m_header.data_unit();
+        uint64_t size = uint64_t(max_units) * unit;
+        if (size > m_remaining)
+            size = m_remaining - m_remaining % unit;
+
+        block.resize(size_t(size));
+        size_t got = size ? read(&block.data_8bit(0), size_t(size / unit)) : 0;
+        block.resize(got * unit);
+        return got;
+    }
+
+    inline
+    size_t PcmWaveReader::read(void *frames, size_t max_units)
+    {
+        PCM_TRACE_SCOPE("PcmWaveReader::read");
+        if (!m_fp)
+            return 0;
+
+        uint16_t unit = m_header.data_unit();
+        uint64_t size = uint64_t(max_units) * unit;
+        if (size > m_remaining)
+            size = m_remaining - m_remaining % unit;
+
+        uint8_t *data = static_cast<uint8_t *>(frames);
+        size_t got = 0;
+        if (size && m_lossless)
+            got = m_lossless->read(data, size_t(size));
+        else if (size && m_adpcm)
+            got = m_adpcm->read(data, size_t(size));
+        else if (size && m_header.is_g711())
+        {
+            m_codes.resize(size_t(size / 2));
+            got = std::fread(&m_codes[0], 1, m_codes.size(), m_fp);
+            pcm_g711_decode(&m_codes[0], reinterpret_cast<int16_t *>(data), got,
+                            m_header.is_ulaw());
+            got *= 2;
+        }
+        else if (size)
+            got = std::fread(data, 1, size_t(size), m_fp);
+        got -= got % unit;
+        if (got && m_header.is_rifx() && !m_header.is_g711())
+            pcm_wave_swap_samples(data, got, m_header.mode());
+
+        m_offset += got;
+        if (got < size)
+            m_remaining = 0;
+        else if (m_remaining != PCM_WAVE_SIZE_UNKNOWN)
+            m_remaining -= got;
+        return got / unit;
+    }
+
+    inline
+    uint64_t PcmWaveReader::remaining_units() const
+    {
+        if (m_remaining == PCM_WAVE_SIZE_UNKNOWN)
+            return PCM_WAVE_SIZE_UNKNOWN;
+        return m_remaining / m_header.data_unit();
+    }
+
+    inline
+    bool PcmWaveReader::seek_range(uint64_t begin, uint64_t end)
+    {
+        if (!m_fp)
+            return false;
+
+        uint16_t unit = m_header.data_unit();
+        uint64_t total = m_header.data_size();
+        if (total != PCM_WAVE_SIZE_UNKNOWN)
+        {
+            total /= unit;
+            if (begin > total)
+                begin = total;
+            if (end > total)
+                end = total;
+        }
+        if (end < begin)
+            return false;
+
+        uint64_t offset = begin * unit;
+        if (m_lossless)
+        {
+            if (!m_lossless->seek(begin))
+                return false;
+        }
+        else if (m_adpcm)
+        {
+            if (!m_adpcm->seek(begin))
+                return false;
+        }
+        else if (m_data_pos >= 0)
+        {
+            uint64_t pos = m_header.is_g711() ? offset / 2 : offset;
+            if (pcm_wave_fseek(m_fp, m_data_pos + int64_t(pos), SEEK_SET) != 0)
+                return false;
+        }
+        else
+        {
+            // a pipe can only go forward
+            uint64_t skip = offset - m_offset;
+            if (m_header.is_g711())
+                skip /= 2;
+            if (offset < m_offset || !pcm_wave_skip(m_fp, skip))
+                return false;
+        }
+        m_offset = offset;
+
+        if (end == PCM_WAVE_SIZE_UNKNOWN)
+            m_remaining = PCM_WAVE_SIZE_UNKNOWN;
+        else
+            m_remaining = (end - begin) * unit;
+        return true;
+    }
+
+    inline
+    bool PcmWaveTime::parse(const char *str)
+    {
+        char *end;
+        value = std::strtod(str, &end);
+        frames = (*end == 'f');
+        if (*end == 'f' || *end == 's')
+            ++end;
+        return end != str && *end == 0 && value >= 0;
+    }
+
+    inline
+    bool PcmWaveTime::empty() const
+    {
+        return value < 0;
+    }
+
+    inline
+    uint64_t PcmWaveTime::to_units(uint32_t rate) const
+    {
+        if (empty())
+            return PCM_WAVE_SIZE_UNKNOWN;
+        if (frames)
+            return uint64_t(value);
+        return uint64_t(value * rate + 0.5);
+    }
+
+    inline
+    bool PcmWaveReader::eof() const
+    {
+        return m_remaining < m_header.data_unit();
+    }
+
+    inline
+    PcmWaveWriter::PcmWaveWriter()
+        : m_fp(NULL), m_header_pos(-1), m_expected(PCM_WAVE_SIZE_UNKNOWN), m_flags(0),
+          m_junk(false)
+    {
+    }
+
+    inline
+    PcmWaveWriter::~PcmWaveWriter()
+    {
+        close();
+    }
+
+    inline
+    bool PcmWaveWriter::open(std::FILE *fp,
+                             uint16_t NumChannels_,
+                             uint16_t BitsPerSample_,
+                             uint32_t SampleRate_,
+                             uint64_t data_size,
+                             int flags)
+    {
+        close();
+
+        m_header.set_info(NumChannels_, BitsPerSample_, SampleRate_);
+        m_header.resize(0);
+        m_header_pos = pcm_wave_is_seekable(fp) ? pcm_wave_ftell(fp) : -1;
+        m_expected = data_size;
+        m_flags = flags & (PCM_WAVE_HEADER_RIFX | PCM_WAVE_HEADER_LOSSLESS |
+                           PCM_WAVE_HEADER_IMA_ADPCM | PCM_WAVE_HEADER_MULAW |
+                           PCM_WAVE_HEADER_ALAW);
+        if (m_flags & PCM_WAVE_HEADER_LOSSLESS)
+            m_flags = PCM_WAVE_HEADER_LOSSLESS;     // "PCMZ" is little-endian
+        else if (m_flags & PCM_WAVE_HEADER_IMA_ADPCM)
+            m_flags = PCM_WAVE_HEADER_IMA_ADPCM;
+        else if (m_flags & PCM_WAVE_HEADER_MULAW)
+            m_flags &= ~PCM_WAVE_HEADER_ALAW;
+        m_junk = false;
+        m_lossless.reset();
+        m_adpcm.reset();
+
+        bool ok;
+        if (m_flags & PCM_WAVE_HEADER_LOSSLESS)
+        {
+            uint64_t frames = PCM_WAVE_SIZE_UNKNOWN;
+            if (data_size != PCM_WAVE_SIZE_UNKNOWN)
+                frames = data_size / m_header.data_unit();
+            m_lossless.reset(new PcmLosslessEncoder());
+            ok = m_lossless->open(fp, NumChannels_, BitsPerSample_, SampleRate_, frames);
+        }
+        else if (is_seekable())
+        {
+            // Room for a ds64 only if the size is unknown or too large for
+            // RIFF; a known small size gets the plain 44-byte header.
+            m_junk = !(m_flags & PCM_WAVE_HEADER_IMA_ADPCM) &&
+                     (data_size == PCM_WAVE_SIZE_UNKNOWN || !fits_riff(data_size));
+            ok = m_header.write_header_to_fp(fp, (m_junk ? PCM_WAVE_HEADER_JUNK : 0) | m_flags);
+        }
+        else if (data_size != PCM_WAVE_SIZE_UNKNOWN)
+        {
+            m_header.data_size(data_size);
+            ok = m_header.write_header_to_fp(fp, m_flags);
+            m_header.data_size(0);
+        }
+        else
+        {
+            ok = m_header.write_header_to_fp(fp, PCM_WAVE_HEADER_STREAM | m_flags);
+        }
+        if (ok && (m_flags & PCM_WAVE_HEADER_IMA_ADPCM))
+        {
+            m_adpcm.reset(new PcmAdpcmEncoder());
+            ok = m_adpcm->open(fp, NumChannels_, SampleRate_);
+        }
+        if (!ok)
+            return false;
+
+        m_fp = fp;
+        return true;
+    }
+
+    inline
+    bool PcmWaveWriter::write(const void *data, size_t data_size)
+    {
+        PCM_TRACE_SCOPE("PcmWaveWriter::write");
+        if (!m_fp)
+            return false;
+        if (!data_size)
+            return true;
+
+        assert(data_size % m_header.data_unit() == 0);
+        const bool g711 = (m_flags & (PCM_WAVE_HEADER_MULAW | PCM_WAVE_HEADER_ALAW)) != 0;
+        if ((m_flags & PCM_WAVE_HEADER_RIFX) && m_header.mode() > 8 && !g711)
+        {
+            m_swap.assign(static_cast<const uint8_t *>(data),
+                          static_cast<const uint8_t *>(data) + data_size);
+            pcm_wave_swap_samples(&m_swap[0], data_size, m_header.mode());
+            data = &m_swap[0];
+        }
+        if (m_lossless)
+        {
+            if (!m_lossless->write(data, data_size))
+                return false;
+        }
+        else if (m_adpcm)
+        {
+            if (!m_adpcm->write(data, data_size))
+                return false;
+        }
+        else if (g711)
+        {
+            m_codes.resize(data_size / 2);
+            pcm_g711_encode(static_cast<const int16_t *>(data), &m_codes[0], m_codes.size(),
+                            (m_flags & PCM_WAVE_HEADER_MULAW) != 0);
+            if (!std::fwrite(&m_codes[0], m_codes.size(), 1, m_fp))
+                return false;
+        }
+        else if (!std::fwrite(data, data_size, 1, m_fp))
+        {
+            return false;
+        }
+
+        m_header.data_size(m_header.data_size() + data_size);
+        return true;
+    }
+
+    inline
+    bool PcmWaveWriter::write(const PcmWave& block)
+    {
+        assert(block.num_channels() == m_header.num_channels());
+        assert(block.mode() == m_header.mode());
+        if (block.empty())
+            return true;
+        return write(&block.data_8bit(0), block.size());
+    }
+
+    inline
+    bool PcmWaveWriter::write(const PcmWaveView& block)
+    {
+        if (block.empty())
+            return true;
+        assert(block.num_channels() == m_header.num_channels());
+        assert(block.mode() == m_header.mode());
+        return write(block.data(), block.size());
+    }
+
+    inline
+    bool PcmWaveWriter::copy_from(PcmWaveReader& reader)
+    {
+        const PcmWave& header = reader.header();
+        assert(header.num_channels() == m_header.num_channels());
+        assert(header.mode() == m_header.mode());
+        if (!m_fp || !reader.m_fp)
+            return false;
+
+        uint64_t size = reader.m_remaining;
+        if (size != PCM_WAVE_SIZE_UNKNOWN)
+            size -= size % header.data_unit();
+        // the bytes can be copied as they are if the byte orders match
+        bool same_order = header.mode() == 8 ||
+                          header.is_rifx() == ((m_flags & PCM_WAVE_HEADER_RIFX) != 0);
+        // only a plain payload can be copied as it is
+        bool plain = !m_lossless && !m_adpcm && !reader.m_lossless && !reader.m_adpcm &&
+                     !reader.m_header.is_g711() &&
+                     !(m_flags & (PCM_WAVE_HEADER_MULAW | PCM_WAVE_HEADER_ALAW));
+        if (same_order && plain &&
+            size != PCM_WAVE_SIZE_UNKNOWN && reader.is_seekable() &&
+            copy_in_kernel(reader, size))
+        {
+            return true;
+        }
+
+        PcmWave block;
+        while (reader.read(block, 64 * 1024) > 0)
+        {
+            if (!write(block))
+                return false;
+        }
+        return true;
+    }
+
+    // copies size bytes without passing them through user space
+    inline
+    bool PcmWaveWriter::copy_in_kernel(PcmWaveReader& reader, uint64_t size)
+    {
+    #ifdef __linux__
+        if (std::fflush(m_fp) != 0)
+            return false;
+
+        int fd_in = fileno(reader.m_fp);
+        int fd_out = fileno(m_fp);
+        off_t off_in = off_t(reader.m_data_pos + reader.m_offset);
+        off_t off_out = is_seekable() ? off_t(pcm_wave_ftell(m_fp)) : 0;
+
+        uint64_t left = size;
+        if (is_seekable())
+        {
+            while (left > 0)
+            {
+                ssize_t n = copy_file_range(fd_in, &off_in, fd_out, &off_out, size_t(left), 0);
+                if (n <= 0)
+                    break;
+                left -= n;
+            }
+        }
+        // sendfile writes at the file position of fd_out
+        if (is_seekable() && left > 0 && lseek(fd_out, off_out, SEEK_SET) < 0)
+            left = 0;
+        while (left > 0)
+        {
+            ssize_t n = sendfile(fd_out, fd_in, &off_in, size_t(left));
+            if (n <= 0)
+                break;
+            left -= n;
+            off_out += n;
+        }
+
+        uint64_t done = size - left;
+        if (done == 0)
+            return false;   // nothing copied; fall back to the FILE functions
+
+        if (is_seekable() && pcm_wave_fseek(m_fp, off_out, SEEK_SET) != 0)
+            return false;
+        if (pcm_wave_fseek(reader.m_fp, off_in, SEEK_SET) != 0)
+            return false;
+
+        m_header.data_size(m_header.data_size() + done);
+        reader.m_offset += done;
+        reader.m_remaining -= done;
+        return left == 0 || copy_from(reader);
+    #else
+        return false;
+    #endif
+    }
+
+    inline
+    bool PcmWaveWriter::close()
+    {
+        if (!m_fp)
+            return true;
+
+        std::FILE *fp = m_fp;
+        m_fp = NULL;
+
+        if (m_lossless)
+        {
+            bool ok = m_lossless->close();
+            m_lossless.reset();
+            return ok;
+        }
+        if (m_adpcm)
+        {
+            bool ok = m_adpcm->close();
+            m_adpcm.reset();
+            if (!ok)
+                return false;
+        }
+        if (!is_seekable())
+        {
+            if (m_expected != PCM_WAVE_SIZE_UNKNOWN && m_expected != m_header.data_size())
+                return false;   // the header on the pipe is wrong
+            return std::fflush(fp) == 0;
+        }
+
+        int64_t end = pcm_wave_ftell(fp);
+        if (!m_junk && !fits_riff(m_header.data_size()) && !(m_flags & PCM_WAVE_HEADER_IMA_ADPCM))
+            return false;   // more than open() was told; no room for a ds64
+        return pcm_wave_fseek(fp, m_header_pos, SEEK_SET) == 0 &&
+               m_header.write_header_to_fp(fp, (m_junk ? PCM_WAVE_HEADER_JUNK : 0) | m_flags) &&
+               pcm_wave_fseek(fp, end, SEEK_SET) == 0 &&
+               std::fflush(fp) == 0;
+    }
+
+    // whether a payload of data_size bytes of samples fits a RIFF header
+    inline
+    bool PcmWaveWriter::fits_riff(uint64_t data_size) const
+    {
+        if (m_flags & (PCM_WAVE_HEADER_MULAW | PCM_WAVE_HEADER_ALAW))
+            data_size /= 2;     // a byte per sample
+        return data_size <= PCM_WAVE_SIZE32_MAX - 36 - sizeof(PCM_WAVE_DS64);
+    }
+
+    inline
+    bool PcmWaveWriter::is_seekable() const
+    {
+        return m_header_pos >= 0;
+    }
+
+    inline
+    const PcmWave& PcmWaveWriter::header() const
     {
-        return float(m_wave.Subchunk2Size) / m_wave.NumChannels /
-               m_wave.SampleRate / (m_wave.BitsPerSample / 8); 
+        return m_header;
     }
 #endif  /* C++ */
 
@@ -1,20 +1,257 @@
-#include <windows.h>
-#include <mmsystem.h>
+#include "PcmWave.hpp"
+#include "PcmPlay.hpp"
+#ifdef _WIN32
+    #include <windows.h>
+    #include <mmsystem.h>
+    #include <io.h>
+    #include <fcntl.h>
+#endif
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#define PLAY_BUFFER_MS  200     // default size of the ring buffer
+#define PLAY_PERIOD_MS  10      // default size of a period
+
+#ifdef _WIN32
+    static bool play_winmm(const char *file)
+    {
+        BOOL ret;
+        if (strcmp(file, "-") == 0)
+        {
+            // PlaySound cannot read a pipe; play it from memory
+            std::vector<char> data;
+            char buf[BUFSIZ];
+            size_t n;
+            _setmode(_fileno(stdin), _O_BINARY);
+            while ((n = fread(buf, 1, sizeof(buf), stdin)) > 0)
+            {
+                data.insert(data.end(), buf, buf + n);
+            }
+            if (data.empty())
+                return false;
+            ret = PlaySoundA(&data[0], NULL, SND_MEMORY | SND_NODEFAULT | SND_SYNC);
+        }
+        else
+        {
+            ret = PlaySoundA(file, NULL, SND_FILENAME | SND_NODEFAULT | SND_SYNC);
+        }
+        if (!ret)
+        {
+            fprintf(stderr, "GetLastError(): %ld\n", GetLastError());
+            return false;
+        }
+        return true;
+    }
+#endif
+
+static void show_stats(const PcmPlayStats& stats)
+{
+    fprintf(stderr, "frames: %llu, periods: %llu, underruns: %llu (%llu frames of silence), xruns: %llu\n",
+            (unsigned long long)stats.units, (unsigned long long)stats.periods,
+            (unsigned long long)stats.underruns, (unsigned long long)stats.silence_units,
+            (unsigned long long)stats.xruns);
+    fprintf(stderr, "latency: min %.2f ms, avg %.2f ms, max %.2f ms\n",
+            stats.latency_min * 1000, stats.latency_avg() * 1000, stats.latency_max * 1000);
+}
+
+static void show_help(void)
+{
+    printf("play --- Plays a wave file\n");
+    printf("Usage: play [options] sound.wav\n");
+    printf("Use '-' for stdin.\n");
+    printf("Options:\n");
+    printf("--help          Show this help.\n");
+    printf("--version       Show version info.\n");
+#if defined(_WIN32)
+    printf("--sink XXX      'winmm' (default), 'null' or 'file'.\n");
+#elif defined(PCM_PLAY_ALSA)
+    printf("--sink XXX      'alsa' (default), 'null' or 'file'.\n");
+    printf("--device XXX    ALSA device name (default: 'default').\n");
+#else
+    printf("--sink XXX      'null' (default) or 'file'.\n");
+#endif
+    printf("-o FILE         Output file of the 'file' sink.\n");
+    printf("--buffer MS     Size of the ring buffer in milliseconds (default: %d).\n", PLAY_BUFFER_MS);
+    printf("--period MS     Size of a period in milliseconds (default: %d).\n", PLAY_PERIOD_MS);
+    printf("--stats         Show the underruns and the latency.\n");
+}
+
+static void show_version(void)
+{
+    printf("play version 0.2 by katahiromz\n");
+}
 
 int main(int argc, char **argv)
 {
+#if defined(_WIN32)
+    const char *sink_name = "winmm";
+#elif defined(PCM_PLAY_ALSA)
+    const char *sink_name = "alsa";
+    const char *device = "default";
+#else
+    const char *sink_name = "null";
+#endif
+    const char *in_file = NULL;
+    const char *out_file = NULL;
+    double buffer_ms = PLAY_BUFFER_MS, period_ms = PLAY_PERIOD_MS;
+    bool stats = false;
+
     if (argc <= 1)
     {
-        printf("Usage: play sound.wav\n");
-        return 0;
+        show_help();
+        return EXIT_SUCCESS;
+    }
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (argv[i][0] == '-' && argv[i][1] != 0)
+        {
+            if (strcmp(argv[i], "--help") == 0)
+            {
+                show_help();
+                return EXIT_SUCCESS;
+            }
+            if (strcmp(argv[i], "--version") == 0)
+            {
+                show_version();
+                return EXIT_SUCCESS;
+            }
+            if (strcmp(argv[i], "--stats") == 0)
+            {
+                stats = true;
+                continue;
+            }
+            if (i + 1 >= argc)
+            {
+                fprintf(stderr, "ERROR: No parameter for '%s'.\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+            if (strcmp(argv[i], "--sink") == 0)
+            {
+                sink_name = argv[++i];
+                continue;
+            }
+#ifdef PCM_PLAY_ALSA
+            if (strcmp(argv[i], "--device") == 0)
+            {
+                device = argv[++i];
+                continue;
+            }
+#endif
+            if (strcmp(argv[i], "-o") == 0)
+            {
+                out_file = argv[++i];
+                continue;
+            }
+            if (strcmp(argv[i], "--buffer") == 0 || strcmp(argv[i], "--period") == 0)
+            {
+                double& value = (argv[i][2] == 'b') ? buffer_ms : period_ms;
+                ++i;
+                char *endptr;
+                value = strtod(argv[i], &endptr);
+                if (*endptr != 0 || !(value > 0))
+                {
+                    fprintf(stderr, "ERROR: Invalid parameter '%s'.\n", argv[i]);
+                    return EXIT_FAILURE;
+                }
+                continue;
+            }
+
+            fprintf(stderr, "ERROR: Invalid argument '%s'.\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+
+        if (in_file)
+        {
+            fprintf(stderr, "ERROR: Too many argument.\n");
+            return EXIT_FAILURE;
+        }
+        in_file = argv[i];
     }
 
-    BOOL ret = PlaySoundA(argv[1], NULL, SND_FILENAME | SND_NODEFAULT | SND_SYNC);
-    if (!ret)
+    if (in_file == NULL)
     {
-        printf("GetLastError(): %ld\n", GetLastError());
-        return 1;
+        fprintf(stderr, "ERROR: No input file.\n");
+        return EXIT_FAILURE;
     }
-    return 0;
+
+#ifdef _WIN32
+    if (strcmp(sink_name, "winmm") == 0)
+        return play_winmm(in_file) ? EXIT_SUCCESS : EXIT_FAILURE;
+#endif
+
+    FILE *fout = NULL;
+    PcmSink *sink = NULL;
+    if (strcmp(sink_name, "null") == 0)
+    {
+        sink = new PcmNullSink();
+    }
+    else if (strcmp(sink_name, "file") == 0)
+    {
+        if (out_file == NULL)
+        {
+            fprintf(stderr, "ERROR: No output file.\n");
+            return EXIT_FAILURE;
+        }
+        fout = pcm_wave_fopen(out_file, "wb");
+        if (!fout)
+        {
+            fprintf(stderr, "ERROR: Unable to open file '%s'.\n", out_file);
+            return EXIT_FAILURE;
+        }
+        sink = new PcmFileSink(fout);
+    }
+#ifdef PCM_PLAY_ALSA
+    else if (strcmp(sink_name, "alsa") == 0)
+    {
+        sink = new PcmAlsaSink(device, unsigned(buffer_ms * 1000));
+    }
+#endif
+    else
+    {
+        fprintf(stderr, "ERROR: Invalid parameter '%s'.\n", sink_name);
+        return EXIT_FAILURE;
+    }
+
+    FILE *fin = pcm_wave_fopen(in_file, "rb");
+    if (!fin)
+    {
+        fprintf(stderr, "ERROR: Unable to open file '%s'.\n", in_file);
+        delete sink;
+        if (fout)
+            pcm_wave_fclose(fout);
+        return EXIT_FAILURE;
+    }
+
+    bool ret = false;
+    PcmWaveReader reader;
+    if (!reader.open(fin))
+    {
+        fprintf(stderr, "ERROR: %s: unable to read\n", in_file);
+    }
+    else
+    {
+        uint32_t rate = reader.header().sample_rate();
+        size_t buffer_units = size_t(buffer_ms * rate / 1000);
+        size_t period_units = size_t(period_ms * rate / 1000);
+        if (period_units == 0)
+            period_units = 1;
+        if (buffer_units < period_units * 2)
+            buffer_units = period_units * 2;
+
+        PcmPlayer player(*sink, buffer_units, period_units);
+        ret = player.play(reader);
+        if (!ret)
+            fprintf(stderr, "ERROR: %s: Unable to play.\n", in_file);
+        if (stats)
+            show_stats(player.stats());
+    }
+
+    delete sink;
+    if (fout)
+        pcm_wave_fclose(fout);
+    pcm_wave_fclose(fin);
+    return ret ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -1,2 +1,2 @@
 #!/bin/bash
-python3 graph.py data.txt
+./txt2wav data.txt data.wav && ./wavplot data.wav graph.png
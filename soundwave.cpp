@@ -0,0 +1,404 @@
+#include "PcmWave.hpp"
+#include "PcmSimd.hpp"
+#include "wav2wav.hpp"
+#include "wav2txt.hpp"
+#include "txt2wav.hpp"
+#include "soundwave.h"
+#include <new>
+#include <exception>
+
+struct SW_READER
+{
+    FILE *fp;
+    PcmWaveReader reader;
+};
+
+struct SW_WRITER
+{
+    FILE *fp;
+    PcmWaveWriter writer;
+};
+
+static bool is_valid_info(const SW_INFO *info)
+{
+    return info && (info->channels == 1 || info->channels == 2) &&
+           (info->bits == 8 || info->bits == 16) && info->sample_rate > 0;
+}
+
+static bool open_check(const char *file, const char *mode)
+{
+    if (strcmp(file, "-") == 0)
+        return true;
+    FILE *fp = fopen(file, mode);
+    if (!fp)
+        return false;
+    fclose(fp);
+    return true;
+}
+
+extern "C"
+int sw_version(void)
+{
+    return SOUNDWAVE_H_;
+}
+
+extern "C"
+const char *sw_strerror(int result)
+{
+    switch (result)
+    {
+    case SW_OK:             return "Success";
+    case SW_ERROR_ARGUMENT: return "Invalid parameter";
+    case SW_ERROR_OPEN:     return "Unable to open file";
+    case SW_ERROR_READ:     return "Unable to read";
+    case SW_ERROR_WRITE:    return "Unable to write";
+    case SW_ERROR_FORMAT:   return "Unsupported format";
+    case SW_ERROR_CONVERT:  return "Unable to convert";
+    case SW_ERROR_MEMORY:   return "Out of memory";
+    case SW_ERROR_SEEK:     return "Unable to seek";
+    }
+    return "Unknown error";
+}
+
+extern "C"
+int sw_reader_open(const char *file, SW_READER **reader)
+{
+    if (!file || !reader)
+        return SW_ERROR_ARGUMENT;
+    *reader = NULL;
+
+    SW_READER *r = new(std::nothrow) SW_READER;
+    if (!r)
+        return SW_ERROR_MEMORY;
+
+    r->fp = pcm_wave_fopen(file, "rb");
+    if (!r->fp)
+    {
+        delete r;
+        return SW_ERROR_OPEN;
+    }
+    int result = SW_OK;
+    try
+    {
+        bool ok = r->reader.open(r->fp);
+        if (r->reader.header().is_unsupported_format())
+            result = SW_ERROR_FORMAT;   // such as float or 24-bit
+        else if (!ok)
+            result = SW_ERROR_READ;
+    }
+    catch (const std::bad_alloc&)
+    {
+        result = SW_ERROR_MEMORY;
+    }
+    catch (const std::exception&)
+    {
+        result = SW_ERROR_READ;
+    }
+    if (result != SW_OK)
+    {
+        pcm_wave_fclose(r->fp);
+        delete r;
+        return result;
+    }
+
+    *reader = r;
+    return SW_OK;
+}
+
+extern "C"
+int sw_reader_info(const SW_READER *reader, SW_INFO *info)
+{
+    if (!reader || !info)
+        return SW_ERROR_ARGUMENT;
+
+    const PcmWave& header = reader->reader.header();
+    info->channels = header.num_channels();
+    info->bits = header.mode();
+    info->sample_rate = header.sample_rate();
+    if (header.data_size() == PCM_WAVE_SIZE_UNKNOWN)
+        info->num_frames = SW_UNKNOWN_FRAMES;
+    else
+        info->num_frames = header.num_units();
+    return SW_OK;
+}
+
+extern "C"
+int sw_reader_read(SW_READER *reader, void *frames, size_t max_frames, size_t *num_read)
+{
+    if (num_read)
+        *num_read = 0;
+    if (!reader || (!frames && max_frames))
+        return SW_ERROR_ARGUMENT;
+
+    size_t got = 0;
+    try
+    {
+        if (max_frames)
+            got = reader->reader.read(frames, max_frames);
+    }
+    catch (const std::bad_alloc&)
+    {
+        return SW_ERROR_MEMORY;
+    }
+    catch (const std::exception&)
+    {
+        return SW_ERROR_READ;
+    }
+    if (num_read)
+        *num_read = got;
+    return SW_OK;
+}
+
+extern "C"
+int sw_reader_seek(SW_READER *reader, uint64_t frame)
+{
+    if (!reader)
+        return SW_ERROR_ARGUMENT;
+    try
+    {
+        return reader->reader.seek_range(frame) ? SW_OK : SW_ERROR_SEEK;
+    }
+    catch (const std::bad_alloc&)
+    {
+        return SW_ERROR_MEMORY;
+    }
+    catch (const std::exception&)
+    {
+        return SW_ERROR_SEEK;
+    }
+}
+
+extern "C"
+void sw_reader_close(SW_READER *reader)
+{
+    if (!reader)
+        return;
+    pcm_wave_fclose(reader->fp);
+    delete reader;
+}
+
+extern "C"
+int sw_writer_open(const char *file, const SW_INFO *info, SW_WRITER **writer)
+{
+    if (!file || !writer || !is_valid_info(info))
+        return SW_ERROR_ARGUMENT;
+    *writer = NULL;
+
+    SW_WRITER *w = new(std::nothrow) SW_WRITER;
+    if (!w)
+        return SW_ERROR_MEMORY;
+
+    w->fp = pcm_wave_fopen(file, "wb");
+    if (!w->fp)
+    {
+        delete w;
+        return SW_ERROR_OPEN;
+    }
+    int result = SW_OK;
+    try
+    {
+        if (!w->writer.open(w->fp, info->channels, info->bits, info->sample_rate))
+            result = SW_ERROR_WRITE;
+    }
+    catch (const std::bad_alloc&)
+    {
+        result = SW_ERROR_MEMORY;
+    }
+    catch (const std::exception&)
+    {
+        result = SW_ERROR_WRITE;
+    }
+    if (result != SW_OK)
+    {
+        pcm_wave_fclose(w->fp);
+        delete w;
+        return result;
+    }
+
+    *writer = w;
+    return SW_OK;
+}
+
+extern "C"
+int sw_writer_write(SW_WRITER *writer, const void *frames, size_t num_frames)
+{
+    if (!writer || (!frames && num_frames))
+        return SW_ERROR_ARGUMENT;
+
+    size_t size = num_frames * writer->writer.header().data_unit();
+    try
+    {
+        if (size && !writer->writer.write(frames, size))
+            return SW_ERROR_WRITE;
+    }
+    catch (const std::bad_alloc&)
+    {
+        return SW_ERROR_MEMORY;
+    }
+    catch (const std::exception&)
+    {
+        return SW_ERROR_WRITE;
+    }
+    return SW_OK;
+}
+
+extern "C"
+int sw_writer_close(SW_WRITER *writer)
+{
+    if (!writer)
+        return SW_ERROR_ARGUMENT;
+
+    bool ok;
+    try
+    {
+        ok = writer->writer.close();
+    }
+    catch (const std::exception&)
+    {
+        ok = false;
+    }
+    if (writer->fp == stdout)
+        ok = (fflush(stdout) == 0) && ok;
+    else
+        ok = (fclose(writer->fp) == 0) && ok;
+    delete writer;
+    return ok ? SW_OK : SW_ERROR_WRITE;
+}
+
+extern "C"
+int sw_convert_frames(const SW_INFO *in_info, const void *in,
+                      const SW_INFO *out_info, void *out, size_t num_frames)
+{
+    if (!is_valid_info(in_info) || !is_valid_info(out_info) ||
+        (num_frames && (!in || !out)))
+    {
+        return SW_ERROR_ARGUMENT;
+    }
+
+    size_t size = num_frames * in_info->channels * in_info->bits / 8;
+    if (in_info->channels == out_info->channels && in_info->bits == out_info->bits)
+    {
+        if (size)
+            memmove(out, in, size);
+        return SW_OK;
+    }
+
+    W2W w2w;
+    w2w.channels = out_info->channels;
+    w2w.mode = out_info->bits;
+    try
+    {
+        PcmWaveView wave1(in_info->channels, in_info->bits, in_info->sample_rate, in, size);
+        PcmWave wave2;
+        if (!convert_wave(wave1, wave2, w2w))
+            return SW_ERROR_CONVERT;
+        if (wave2.size())
+            memcpy(out, &wave2.data_8bit(0), wave2.size());
+    }
+    catch (const std::bad_alloc&)
+    {
+        return SW_ERROR_MEMORY;
+    }
+    catch (const std::exception&)
+    {
+        return SW_ERROR_CONVERT;
+    }
+    return SW_OK;
+}
+
+extern "C"
+void sw_convert_init(SW_CONVERT *options)
+{
+    if (!options)
+        return;
+    memset(options, 0, sizeof(*options));
+    options->normalize = SW_NORMALIZE_NONE;
+    options->start = -1;
+    options->end = -1;
+}
+
+extern "C"
+int sw_convert(const char *in_file, const char *out_file, const SW_CONVERT *options)
+{
+    if (!in_file || !out_file)
+        return SW_ERROR_ARGUMENT;
+
+    W2W w2w;
+    if (options)
+    {
+        if ((options->channels != 0 && options->channels != 1 && options->channels != 2) ||
+            (options->bits != 0 && options->bits != 8 && options->bits != 16) ||
+            options->sample_rate < 0 ||
+            options->normalize < SW_NORMALIZE_NONE || options->normalize > SW_NORMALIZE_RMS)
+        {
+            return SW_ERROR_ARGUMENT;
+        }
+        w2w.channels = options->channels;
+        w2w.mode = options->bits;
+        w2w.sampling_rate = options->sample_rate;
+        w2w.gain = options->gain;
+        w2w.normalize = options->normalize;
+        w2w.start.value = options->start;
+        w2w.end.value = options->end;
+    }
+
+    if (!open_check(in_file, "rb"))
+        return SW_ERROR_OPEN;
+    try
+    {
+        return wav2wav(in_file, out_file, w2w) ? SW_OK : SW_ERROR_CONVERT;
+    }
+    catch (const std::bad_alloc&)
+    {
+        return SW_ERROR_MEMORY;
+    }
+    catch (const std::exception&)
+    {
+        return SW_ERROR_CONVERT;
+    }
+}
+
+extern "C"
+int sw_wav_to_txt(const char *wav_file, const char *txt_file)
+{
+    if (!wav_file || !txt_file)
+        return SW_ERROR_ARGUMENT;
+    if (!open_check(wav_file, "rb"))
+        return SW_ERROR_OPEN;
+
+    W2T w2t;
+    try
+    {
+        return wav2txt(wav_file, txt_file, w2t) ? SW_OK : SW_ERROR_CONVERT;
+    }
+    catch (const std::bad_alloc&)
+    {
+        return SW_ERROR_MEMORY;
+    }
+    catch (const std::exception&)
+    {
+        return SW_ERROR_CONVERT;
+    }
+}
+
+extern "C"
+int sw_txt_to_wav(const char *txt_file, const char *wav_file, int sample_rate)
+{
+    if (!txt_file || !wav_file || sample_rate < 0)
+        return SW_ERROR_ARGUMENT;
+    if (!open_check(txt_file, "r"))
+        return SW_ERROR_OPEN;
+
+    try
+    {
+        return txt2wav(txt_file, wav_file, sample_rate) ? SW_OK : SW_ERROR_CONVERT;
+    }
+    catch (const std::bad_alloc&)
+    {
+        return SW_ERROR_MEMORY;
+    }
+    catch (const std::exception&)
+    {
+        return SW_ERROR_CONVERT;
+    }
+}
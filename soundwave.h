@@ -0,0 +1,105 @@
+/* soundwave.h --- C API of the soundwave library */
+#ifndef SOUNDWAVE_H_
+#define SOUNDWAVE_H_     1   /* Version 1 */
+
+#if __cplusplus >= 201103L  /* C++11 */
+    #include <cstdint>
+    #include <cstddef>
+#elif __STDC_VERSION__ >= 199901L   /* C99 */
+    #include <stdint.h>
+    #include <stddef.h>
+#else
+    #include "pstdint.h"
+    #include <stddef.h>
+#endif
+
+#if defined(_WIN32) && defined(SOUNDWAVE_SHARED)
+    #ifdef SOUNDWAVE_BUILD
+        #define SOUNDWAVE_API __declspec(dllexport)
+    #else
+        #define SOUNDWAVE_API __declspec(dllimport)
+    #endif
+#else
+    #define SOUNDWAVE_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* result codes; every function returns SW_OK or a negative code, and prints
+   nothing */
+#define SW_OK                   0
+#define SW_ERROR_ARGUMENT       (-1)    /* invalid parameter */
+#define SW_ERROR_OPEN           (-2)    /* unable to open a file */
+#define SW_ERROR_READ           (-3)    /* unable to read, or not a wave file */
+#define SW_ERROR_WRITE          (-4)    /* unable to write */
+#define SW_ERROR_FORMAT         (-5)    /* unsupported format */
+#define SW_ERROR_CONVERT        (-6)    /* the conversion failed */
+#define SW_ERROR_MEMORY         (-7)    /* out of memory */
+#define SW_ERROR_SEEK           (-8)    /* not seekable or out of range */
+
+#define SW_UNKNOWN_FRAMES       ((uint64_t)-1)  /* streamed until EOF */
+
+#define SW_NORMALIZE_NONE       0
+#define SW_NORMALIZE_PEAK       1   /* peak to 0 dBFS */
+#define SW_NORMALIZE_RMS        2   /* RMS to -20 dBFS */
+
+typedef struct SW_INFO
+{
+    uint16_t channels;          /* 1 or 2 */
+    uint16_t bits;              /* 8 or 16 */
+    uint32_t sample_rate;       /* in Hz */
+    uint64_t num_frames;        /* SW_UNKNOWN_FRAMES if unknown */
+} SW_INFO;
+
+typedef struct SW_CONVERT
+{
+    int channels;               /* same as the input if zero */
+    int bits;                   /* same as the input if zero */
+    int sample_rate;            /* same as the input if zero; a relabel */
+    double gain;                /* in dB */
+    int normalize;              /* SW_NORMALIZE_... */
+    double start;               /* in seconds; from the beginning if negative */
+    double end;                 /* in seconds; to the end if negative */
+} SW_CONVERT;
+
+typedef struct SW_READER SW_READER;
+typedef struct SW_WRITER SW_WRITER;
+
+SOUNDWAVE_API int sw_version(void);
+SOUNDWAVE_API const char *sw_strerror(int result);
+
+/* "-" means stdin; frames are interleaved, 8-bit unsigned or 16-bit signed */
+SOUNDWAVE_API int sw_reader_open(const char *file, SW_READER **reader);
+SOUNDWAVE_API int sw_reader_info(const SW_READER *reader, SW_INFO *info);
+SOUNDWAVE_API int sw_reader_read(SW_READER *reader, void *frames,
+                                 size_t max_frames, size_t *num_read);
+SOUNDWAVE_API int sw_reader_seek(SW_READER *reader, uint64_t frame);
+SOUNDWAVE_API void sw_reader_close(SW_READER *reader);
+
+/* "-" means stdout. info->num_frames is ignored. */
+SOUNDWAVE_API int sw_writer_open(const char *file, const SW_INFO *info,
+                                 SW_WRITER **writer);
+SOUNDWAVE_API int sw_writer_write(SW_WRITER *writer, const void *frames,
+                                  size_t num_frames);
+/* finishes the header and frees the writer */
+SOUNDWAVE_API int sw_writer_close(SW_WRITER *writer);
+
+/* frames of in_info --> frames of out_info; sample rates are not changed */
+SOUNDWAVE_API int sw_convert_frames(const SW_INFO *in_info, const void *in,
+                                    const SW_INFO *out_info, void *out,
+                                    size_t num_frames);
+
+SOUNDWAVE_API void sw_convert_init(SW_CONVERT *options);
+SOUNDWAVE_API int sw_convert(const char *in_file, const char *out_file,
+                             const SW_CONVERT *options);
+SOUNDWAVE_API int sw_wav_to_txt(const char *wav_file, const char *txt_file);
+SOUNDWAVE_API int sw_txt_to_wav(const char *txt_file, const char *wav_file,
+                                int sample_rate);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif  /* ndef SOUNDWAVE_H_ */
@@ -0,0 +1,45 @@
+# wav2wav_cache.cmake --- Checks that writing to an output placed from the
+#                          cache of wav2wav leaves the cache entry alone
+#    ex) cmake -DWAV2WAV=wav2wav -DINPUT=in.wav -DDIR=work -P wav2wav_cache.cmake
+##############################################################################
+
+file(REMOVE_RECURSE "${DIR}")
+file(MAKE_DIRECTORY "${DIR}")
+set(CACHE_DIR "${DIR}/cache")
+set(OUTPUT "${DIR}/out.wav")
+
+# runs wav2wav with the arguments; the messages go to the variable messages
+function(run_wav2wav messages)
+    execute_process(COMMAND "${WAV2WAV}" ${ARGN}
+                    RESULT_VARIABLE result OUTPUT_VARIABLE out ERROR_VARIABLE err)
+    if (NOT result EQUAL 0)
+        message(FATAL_ERROR "wav2wav ${ARGN} failed:\n${out}${err}")
+    endif()
+    set(${messages} "${out}${err}" PARENT_SCOPE)
+endfunction()
+
+# a miss stores the entry, and a rerun places it at the output
+run_wav2wav(messages "${INPUT}" "${OUTPUT}" --cache "${CACHE_DIR}")
+run_wav2wav(messages "${INPUT}" "${OUTPUT}" --cache "${CACHE_DIR}")
+if (NOT messages MATCHES "\\(cached\\)")
+    message(FATAL_ERROR "The second run was not a cache hit:\n${messages}")
+endif()
+
+file(GLOB entries "${CACHE_DIR}/*-*.wav")
+list(LENGTH entries count)
+if (NOT count EQUAL 1)
+    message(FATAL_ERROR "Expected one cache entry, found ${count}.")
+endif()
+file(SHA256 "${entries}" before)
+
+# writes another conversion over the output, without the cache
+run_wav2wav(messages "${INPUT}" "${OUTPUT}" --mode 8)
+file(SHA256 "${OUTPUT}" written)
+if (written STREQUAL before)
+    message(FATAL_ERROR "The output was not rewritten.")
+endif()
+
+file(SHA256 "${entries}" after)
+if (NOT after STREQUAL before)
+    message(FATAL_ERROR "Writing to the output changed the cache entry.")
+endif()
@@ -1,23 +1,20 @@
 #include "PcmWave.hpp"
+#include "wav2txt.hpp"
 #include "txt2wav.hpp"
 #include <cstdio>
+#include <cstdlib>
 #include <limits>
+#include <vector>
 
 #define BUFSIZE 128
 
-static void show_info(const char *name, const PcmWave& wave)
-{
-    fprintf(stderr, "%s: %ld Hz sampling, %d-bit, %d channel (%.2f seconds)\n",
-            name, wave.sample_rate(),
-            wave.mode(), wave.num_channels(), wave.seconds());
-}
-
 static uint16_t scan_mode(FILE *fin)
 {
+    PCM_TRACE_SCOPE("txt2wav scan_mode");
     int data;
     char buf[BUFSIZE];
 
-    while (fscanf(fin, "%d", &data) != EOF)
+    while (fscanf(fin, "%d", &data) == 1)
     {
         if (data < std::numeric_limits<uint8_t>::min() ||
             std::numeric_limits<uint8_t>::max() < data)
@@ -31,6 +28,7 @@ static uint16_t scan_mode(FILE *fin)
 
 static uint16_t scan_channels(FILE *fin)
 {
+    PCM_TRACE_SCOPE("txt2wav scan_channels");
     int a, b;
     short ch;
     char buf[BUFSIZE];
@@ -43,6 +41,7 @@ static uint16_t scan_channels(FILE *fin)
 
 bool read_1ch_8(FILE *fin, PcmWave& wave)
 {
+    PCM_TRACE_SCOPE("txt2wav parse");
     int left, right;
     char buf[BUFSIZE];
     size_t count = 0;
@@ -51,10 +50,11 @@ bool read_1ch_8(FILE *fin, PcmWave& wave)
     while (fgets(buf, BUFSIZE, fin) != NULL)
     {
         int n = sscanf(buf, "%d %d", &left, &right);
-        assert(n == ch);
-
-        assert(std::numeric_limits<uint8_t>::min() <= left);
-        assert(left <= std::numeric_limits<uint8_t>::max());
+        if (n != ch ||
+            left < std::numeric_limits<uint8_t>::min() || std::numeric_limits<uint8_t>::max() < left)
+        {
+            return false;
+        }
 
         wave.push_8bit(uint8_t(left));
     }
@@ -65,6 +65,7 @@ bool read_1ch_8(FILE *fin, PcmWave& wave)
 
 bool read_1ch_16(FILE *fin, PcmWave& wave)
 {
+    PCM_TRACE_SCOPE("txt2wav parse");
     int left, right;
     char buf[BUFSIZE];
     size_t count = 0;
@@ -73,10 +74,11 @@ bool read_1ch_16(FILE *fin, PcmWave& wave)
     while (fgets(buf, BUFSIZE, fin) != NULL)
     {
         int n = sscanf(buf, "%d %d", &left, &right);
-        assert(n == ch);
-
-        assert(std::numeric_limits<int16_t>::min() <= left);
-        assert(left <= std::numeric_limits<int16_t>::max());
+        if (n != ch ||
+            left < std::numeric_limits<int16_t>::min() || std::numeric_limits<int16_t>::max() < left)
+        {
+            return false;
+        }
 
         wave.push_16bit(int16_t(left));
     }
@@ -87,6 +89,7 @@ bool read_1ch_16(FILE *fin, PcmWave& wave)
 
 bool read_2ch_8(FILE *fin, PcmWave& wave)
 {
+    PCM_TRACE_SCOPE("txt2wav parse");
     int left, right;
     char buf[BUFSIZE];
     size_t count = 0;
@@ -95,13 +98,12 @@ bool read_2ch_8(FILE *fin, PcmWave& wave)
     while (fgets(buf, BUFSIZE, fin) != NULL)
     {
         int n = sscanf(buf, "%d %d", &left, &right);
-        assert(n == ch);
-
-        assert(std::numeric_limits<uint8_t>::min() <= left);
-        assert(left <= std::numeric_limits<uint8_t>::max());
-
-        assert(std::numeric_limits<uint8_t>::min() <= right);
-        assert(right <= std::numeric_limits<uint8_t>::max());
+        if (n != ch ||
+            left < std::numeric_limits<uint8_t>::min() || std::numeric_limits<uint8_t>::max() < left ||
+            right < std::numeric_limits<uint8_t>::min() || std::numeric_limits<uint8_t>::max() < right)
+        {
+            return false;
+        }
 
         wave.push_8bit(uint8_t(left));
         wave.push_8bit(uint8_t(right));
@@ -114,6 +116,7 @@ bool read_2ch_8(FILE *fin, PcmWave& wave)
 
 bool read_2ch_16(FILE *fin, PcmWave& wave)
 {
+    PCM_TRACE_SCOPE("txt2wav parse");
     int left, right;
     char buf[BUFSIZE];
     size_t count = 0;
@@ -122,33 +125,243 @@ bool read_2ch_16(FILE *fin, PcmWave& wave)
     while (fgets(buf, BUFSIZE, fin) != NULL)
     {
         int n = sscanf(buf, "%d %d", &left, &right);
-        assert(n == ch);
-
-        assert(std::numeric_limits<int16_t>::min() <= left);
-        assert(left <= std::numeric_limits<int16_t>::max());
-
-        assert(std::numeric_limits<int16_t>::min() <= right);
-        assert(right <= std::numeric_limits<int16_t>::max());
+        if (n != ch ||
+            left < std::numeric_limits<int16_t>::min() || std::numeric_limits<int16_t>::max() < left ||
+            right < std::numeric_limits<int16_t>::min() || std::numeric_limits<int16_t>::max() < right)
+        {
+            return false;
+        }
 
         wave.push_16bit(int16_t(left));
         wave.push_16bit(int16_t(right));
         count++;
     }
 
-    printf("count: %u\n", count);
+    pcm_wave_message("count: %u\n", (unsigned)count);
     wave.update_info();
     return true;
 }
 
+// Reads whole lines from a stream without copying them.
+class LineReader
+{
+public:
+    explicit LineReader(FILE *fp) : m_fp(fp), m_buf(T2W_BUFFER_SIZE), m_pos(0), m_end(0),
+                                    m_eof(false)
+    {
+    }
+
+    // [begin, end) is the next line without the newline
+    bool next(const char *& begin, const char *& end)
+    {
+        for (;;)
+        {
+            const char *p = &m_buf[0] + m_pos;
+            const char *q = static_cast<const char *>(memchr(p, '\n', m_end - m_pos));
+            if (q || (m_eof && m_pos < m_end))
+            {
+                if (!q)
+                    q = &m_buf[0] + m_end;
+                begin = p;
+                end = q;
+                if (end > begin && end[-1] == '\r')
+                    --end;
+                m_pos = (q - &m_buf[0]) + (q < &m_buf[0] + m_end);
+                return true;
+            }
+            if (m_eof)
+                return false;
+
+            // keep the partial line and read more
+            memmove(&m_buf[0], &m_buf[0] + m_pos, m_end - m_pos);
+            m_end -= m_pos;
+            m_pos = 0;
+            if (m_end == m_buf.size())
+                m_buf.resize(m_buf.size() * 2);
+            size_t n = fread(&m_buf[0] + m_end, 1, m_buf.size() - m_end, m_fp);
+            m_end += n;
+            if (n == 0)
+                m_eof = true;
+        }
+    }
+
+protected:
+    FILE *m_fp;
+    std::vector<char> m_buf;
+    size_t m_pos, m_end;
+    bool m_eof;
+};
+
+static bool parse_int(const char *& p, const char *end, int& value)
+{
+    while (p < end && (*p == ' ' || *p == '\t'))
+        ++p;
+    bool minus = (p < end && *p == '-');
+    if (minus)
+        ++p;
+    if (p == end || *p < '0' || '9' < *p)
+        return false;
+
+    int n = 0;
+    for (; p < end && '0' <= *p && *p <= '9'; ++p)
+    {
+        if (n > 99999999)
+            return false;
+        n = n * 10 + (*p - '0');
+    }
+    value = minus ? -n : n;
+    return true;
+}
+
+// decodes the delta dialect of wav2txt (see W2T_DELTA_MAGIC); fin is after
+// the W2T_DELTA_MAGIC and the space that follow it
+static bool read_delta(const char *in, const char *out, FILE *fin, FILE *fout,
+                       int sampling_rate)
+{
+    PCM_TRACE_SCOPE("txt2wav parse delta");
+    LineReader lines(fin);
+    const char *p, *end;
+    if (!lines.next(p, end))
+        return false;
+
+    int channels, mode, rate, keyframe;
+    if (!parse_int(p, end, channels) || !parse_int(p, end, mode) ||
+        !parse_int(p, end, rate) || !parse_int(p, end, keyframe) ||
+        (channels != 1 && channels != 2) || (mode != 8 && mode != 16) || rate <= 0)
+    {
+        pcm_wave_message("ERROR: %s: Invalid header.\n", in);
+        return false;
+    }
+    if (sampling_rate == 0)
+        sampling_rate = rate;
+
+    PcmWaveWriter writer;
+    if (!writer.open(fout, channels, mode, sampling_rate))
+    {
+        pcm_wave_message("ERROR: %s: Unable to write.\n", out);
+        return false;
+    }
+
+    const int lo = (mode == 8) ? 0 : -32768, hi = (mode == 8) ? 255 : 32767;
+    const size_t unit = channels * mode / 8;
+    std::vector<uint8_t> block(T2W_BLOCK_UNITS * unit);
+    size_t count = 0;
+    uint64_t line = 1;
+    int value[2] = { 0, 0 };
+    while (lines.next(p, end))
+    {
+        ++line;
+        bool key = (p < end && *p == '=');
+        if (key)
+            ++p;
+        if (key || p < end)
+        {
+            for (int ch = 0; ch < channels; ++ch)
+            {
+                int n;
+                if (!parse_int(p, end, n))
+                {
+                    pcm_wave_message("ERROR: %s: Invalid line %llu.\n", in, (unsigned long long)line);
+                    return false;
+                }
+                value[ch] = key ? n : value[ch] + n;
+                if (value[ch] < lo || hi < value[ch])
+                {
+                    pcm_wave_message("ERROR: %s: Out of range at line %llu.\n", in, (unsigned long long)line);
+                    return false;
+                }
+            }
+        }
+
+        uint8_t *dest = &block[count * unit];
+        for (int ch = 0; ch < channels; ++ch)
+        {
+            if (mode == 8)
+            {
+                dest[ch] = uint8_t(value[ch]);
+            }
+            else
+            {
+                int16_t v = int16_t(value[ch]);
+                memcpy(dest + ch * 2, &v, 2);
+            }
+        }
+
+        if (++count == T2W_BLOCK_UNITS)
+        {
+            if (!writer.write(&block[0], count * unit))
+            {
+                pcm_wave_message("ERROR: %s: Unable to write.\n", out);
+                return false;
+            }
+            count = 0;
+        }
+    }
+
+    if ((count && !writer.write(&block[0], count * unit)) || !writer.close())
+    {
+        pcm_wave_message("ERROR: %s: Unable to write.\n", out);
+        return false;
+    }
+
+    pcm_wave_show_info(out, writer.header());
+    pcm_wave_message("'%s' --> '%s' (OK)\n", in, out);
+    return true;
+}
+
 bool txt2wav_fp(const char *in, const char *out, FILE *fin, FILE *fout, int sampling_rate)
 {
+    // the delta dialect, known by the whole magic and a space, is read in
+    // one pass
+    const size_t magic = strlen(W2T_DELTA_MAGIC);
+    const bool seekable = pcm_wave_is_seekable(fin);
+    const int64_t start = seekable ? pcm_wave_ftell(fin) : 0;
+    char head[sizeof(W2T_DELTA_MAGIC)];
+    size_t got = fread(head, 1, magic + 1, fin);
+    if (got == magic + 1 && memcmp(head, W2T_DELTA_MAGIC, magic) == 0 && head[magic] == ' ')
+        return read_delta(in, out, fin, fout, sampling_rate);
+    if (seekable && pcm_wave_fseek(fin, start, SEEK_SET) != 0)
+    {
+        pcm_wave_message("ERROR: %s: unable to read\n", in);
+        return false;
+    }
+
     if (sampling_rate == 0)
         sampling_rate = 44100;
 
+    // the text is scanned more than once; spool a pipe to a temporary file
+    FILE *spool = NULL;
+    if (!seekable)
+    {
+        spool = tmpfile();
+        if (!spool)
+        {
+            pcm_wave_message("ERROR: %s: Unable to create a temporary file.\n", in);
+            return false;
+        }
+
+        fwrite(head, 1, got, spool);    // read above
+        char buf[BUFSIZ];
+        size_t n;
+        while ((n = fread(buf, 1, sizeof(buf), fin)) > 0)
+        {
+            fwrite(buf, 1, n, spool);
+        }
+        rewind(spool);
+        fin = spool;
+    }
+
     uint32_t mode = scan_mode(fin);
     rewind(fin);
     uint32_t channels = scan_channels(fin);
     rewind(fin);
+    if (channels != 1 && channels != 2)
+    {
+        if (spool)
+            fclose(spool);
+        pcm_wave_message("ERROR: %s: Invalid text.\n", in);
+        return false;
+    }
 
     PcmWave wave(channels, mode, sampling_rate);
 
@@ -179,15 +392,23 @@ bool txt2wav_fp(const char *in, const char *out, FILE *fin, FILE *fout, int samp
         break;
     }
 
-    show_info(in, wave);
+    if (spool)
+        fclose(spool);
+    if (!flag)
+    {
+        pcm_wave_message("ERROR: %s: Invalid text.\n", in);
+        return false;
+    }
+
+    pcm_wave_show_info(in, wave);
 
     if (!wave.write_to_fp(fout))
     {
-        fprintf(stderr, "ERROR: %s: Unable to write.\n", out);
+        pcm_wave_message("ERROR: %s: Unable to write.\n", out);
         return false;
     }
 
-    fprintf(stderr, "'%s' --> '%s' (OK)\n", in, out);
+    pcm_wave_message("'%s' --> '%s' (OK)\n", in, out);
 
     return true;
 }
@@ -197,120 +418,40 @@ bool txt2wav(const char *txt_file, const char *wav_file, int sampling_rate)
     FILE *fin, *fout;
 
     assert(txt_file);
-    fin = fopen(txt_file, "r");
+    fin = pcm_wave_fopen(txt_file, "r");
     if (!fin)
     {
-        fprintf(stderr, "ERROR: Unable to open file '%s'.\n", txt_file);
+        pcm_wave_message("ERROR: Unable to open file '%s'.\n", txt_file);
         return false;
     }
 
     char out_name[256];
     if (!wav_file)
     {
-        strcpy(out_name, txt_file);
-        strcat(out_name, ".wav");
-        wav_file = out_name;
+        if (strcmp(txt_file, "-") == 0)
+        {
+            wav_file = "-";
+        }
+        else
+        {
+            strcpy(out_name, txt_file);
+            strcat(out_name, ".wav");
+            wav_file = out_name;
+        }
     }
 
-    fout = fopen(wav_file, "wb");
+    fout = pcm_wave_fopen(wav_file, "wb");
     if (!fout)
     {
-        fprintf(stderr, "ERROR: Unable to open file '%s'.\n", wav_file);
-        fclose(fin);
+        pcm_wave_message("ERROR: Unable to open file '%s'.\n", wav_file);
+        pcm_wave_fclose(fin);
         return false;
     }
 
     bool ret = txt2wav_fp(txt_file, wav_file, fin, fout, sampling_rate);
 
-    fclose(fout);
-    fclose(fin);
+    pcm_wave_fclose(fout);
+    pcm_wave_fclose(fin);
 
     return ret;
 }
-
-#ifdef TXT2WAV
-    static void show_help(void)
-    {
-        printf("txt2wav --- Converts a text file to a wave file\n");
-        printf("Usage: txt2wav [options] text-file.txt [sound-file.wav]\n");
-        printf("Options:\n");
-        printf("--help      Show this help.\n");
-        printf("--version   Show version info.\n");
-        printf("--rate XXX  Specify sampling rate.\n");
-    }
-
-    static void show_version(void)
-    {
-        printf("txt2wav version 0.4 by katahiromz\n");
-    }
-
-    int main(int argc, char **argv)
-    {
-        int sampling_rate = 0;
-
-        if (argc <= 1)
-        {
-            show_help();
-            return EXIT_SUCCESS;
-        }
-
-        const char *arg1 = NULL;
-        const char *arg2 = NULL;
-        for (int i = 1; i < argc; ++i)
-        {
-            if (argv[i][0] == '-')
-            {
-                if (strcmp(argv[i], "--help") == 0)
-                {
-                    show_help();
-                    return EXIT_SUCCESS;
-                }
-                if (strcmp(argv[i], "--version") == 0)
-                {
-                    show_version();
-                    return EXIT_SUCCESS;
-                }
-                if (strcmp(argv[i], "--rate") == 0)
-                {
-                    if (i + 1 >= argc)
-                    {
-                        fprintf(stderr, "ERROR: No parameter for '%s'.\n", argv[i]);
-                        return EXIT_FAILURE;
-                    }
-                    ++i;
-                    sampling_rate = (int)strtoul(argv[i], NULL, 0);
-                    if (i >= argc || sampling_rate == 0)
-                    {
-                        fprintf(stderr, "ERROR: Invalid parameter '%s'.\n", argv[i]);
-                        return EXIT_FAILURE;
-                    }
-                    continue;
-                }
-
-                fprintf(stderr, "ERROR: Invalid argument '%s'.\n", argv[i]);
-                return EXIT_FAILURE;
-            }
-            if (arg1 == NULL)
-            {
-                arg1 = argv[i];
-            }
-            else if (arg2 == NULL)
-            {
-                arg2 = argv[i];
-            }
-            else
-            {
-                fprintf(stderr, "ERROR: Too many argument.\n");
-                return EXIT_FAILURE;
-            }
-        }
-
-        if (arg1 == NULL)
-        {
-            fprintf(stderr, "ERROR: No input file.\n");
-            return EXIT_FAILURE;
-        }
-
-        return txt2wav(arg1, arg2, sampling_rate) ? EXIT_SUCCESS : EXIT_FAILURE;
-    }
-#endif
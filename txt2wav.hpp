@@ -3,6 +3,9 @@
 
 #include <cstdio>
 
+#define T2W_BLOCK_UNITS     (64 * 1024)     // frames per block of the delta dialect
+#define T2W_BUFFER_SIZE     (1024 * 1024)   // bytes of text per read
+
 bool txt2wav_fp(const char *in, const char *out, FILE *fin, FILE *fout, int sampling_rate);
 bool txt2wav(const char *txt_file, const char *wav_file, int sampling_rate);
 
@@ -0,0 +1,93 @@
+#include "PcmWave.hpp"
+#include "txt2wav.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static void show_help(void)
+{
+    printf("txt2wav --- Converts a text file to a wave file\n");
+    printf("Usage: txt2wav [options] text-file.txt [sound-file.wav]\n");
+    printf("Use '-' for stdin/stdout.\n");
+    printf("Options:\n");
+    printf("--help      Show this help.\n");
+    printf("--version   Show version info.\n");
+    printf("--rate XXX  Specify sampling rate.\n");
+}
+
+static void show_version(void)
+{
+    printf("txt2wav version 0.5 by katahiromz\n");
+}
+
+int main(int argc, char **argv)
+{
+    pcm_wave_messages() = stderr;    // the library is quiet otherwise
+
+    int sampling_rate = 0;
+
+    if (argc <= 1)
+    {
+        show_help();
+        return EXIT_SUCCESS;
+    }
+
+    const char *arg1 = NULL;
+    const char *arg2 = NULL;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (argv[i][0] == '-' && argv[i][1] != 0)
+        {
+            if (strcmp(argv[i], "--help") == 0)
+            {
+                show_help();
+                return EXIT_SUCCESS;
+            }
+            if (strcmp(argv[i], "--version") == 0)
+            {
+                show_version();
+                return EXIT_SUCCESS;
+            }
+            if (strcmp(argv[i], "--rate") == 0)
+            {
+                if (i + 1 >= argc)
+                {
+                    fprintf(stderr, "ERROR: No parameter for '%s'.\n", argv[i]);
+                    return EXIT_FAILURE;
+                }
+                ++i;
+                sampling_rate = (int)strtoul(argv[i], NULL, 0);
+                if (i >= argc || sampling_rate == 0)
+                {
+                    fprintf(stderr, "ERROR: Invalid parameter '%s'.\n", argv[i]);
+                    return EXIT_FAILURE;
+                }
+                continue;
+            }
+
+            fprintf(stderr, "ERROR: Invalid argument '%s'.\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+        if (arg1 == NULL)
+        {
+            arg1 = argv[i];
+        }
+        else if (arg2 == NULL)
+        {
+            arg2 = argv[i];
+        }
+        else
+        {
+            fprintf(stderr, "ERROR: Too many argument.\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (arg1 == NULL)
+    {
+        fprintf(stderr, "ERROR: No input file.\n");
+        return EXIT_FAILURE;
+    }
+
+    return txt2wav(arg1, arg2, sampling_rate) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -1,13 +1,8 @@
 #include "PcmWave.hpp"
 #include "wav2txt.hpp"
 #include <cstdio>
-
-static void show_info(const char *name, const PcmWave& wave)
-{
-    fprintf(stderr, "%s: %ld Hz sampling, %d-bit, %d channel (%.2f seconds)\n",
-            name, wave.sample_rate(),
-            wave.mode(), wave.num_channels(), wave.seconds());
-}
+#include <cstdlib>
+#include <vector>
 
 static bool write_1ch_8(FILE *fout, const PcmWave& wave)
 {
@@ -45,30 +40,19 @@ static bool write_2ch_16(FILE *fout, const PcmWave& wave)
     return true;
 }
 
-bool wav2txt_fp(const char *in, const char *out, FILE *fin, FILE *fout)
+static bool write_block(FILE *fout, const PcmWave& wave)
 {
-    PcmWave wave;
-    if (!wave.read_from_fp(fin))
-    {
-        fprintf(stderr, "ERROR: %s: unable to read\n", in);
-        return false;
-    }
-
-    show_info(in, wave);
-
+    PCM_TRACE_SCOPE("wav2txt emit");
     switch (wave.num_channels())
     {
     case 1:
         switch (wave.mode())
         {
         case 8:
-            write_1ch_8(fout, wave);
-            break;
+            return write_1ch_8(fout, wave);
         case 16:
-            write_1ch_16(fout, wave);
-            break;
+            return write_1ch_16(fout, wave);
         default:
-            assert(0);
             return false;
         }
         break;
@@ -76,128 +60,192 @@ bool wav2txt_fp(const char *in, const char *out, FILE *fin, FILE *fout)
         switch (wave.mode())
         {
         case 8:
-            write_2ch_8(fout, wave);
-            break;
+            return write_2ch_8(fout, wave);
         case 16:
-            write_2ch_16(fout, wave);
-            break;
+            return write_2ch_16(fout, wave);
         default:
-            assert(0);
             return false;
         }
         break;
     default:
-        assert(0);
         return false;
     }
+}
 
-    return true;
+// The delta dialect: the W2T_DELTA_MAGIC line "#delta CH BITS RATE KEY",
+// then a line per frame. A line "=a b" is a keyframe of absolute values,
+// every KEY frames from the first; other lines hold the differences from
+// the previous frame, and an empty line means no change.
+struct DeltaState
+{
+    uint64_t index = 0;
+    int prev[2] = { 0, 0 };
+    std::vector<char> buf;
+};
+
+static char *put_int(char *p, int value)
+{
+    char digits[12];
+    int n = 0;
+    unsigned u = (value < 0) ? 0u - unsigned(value) : unsigned(value);
+    do
+    {
+        digits[n++] = char('0' + u % 10);
+        u /= 10;
+    } while (u);
+    if (value < 0)
+        *p++ = '-';
+    while (n > 0)
+        *p++ = digits[--n];
+    return p;
 }
 
-bool wav2txt(const char *wav_file, const char *txt_file)
+static bool write_delta_block(FILE *fout, const PcmWave& wave, uint32_t keyframe,
+                              DeltaState& state)
 {
-    FILE *fin, *fout;
+    PCM_TRACE_SCOPE("wav2txt emit delta");
+    const int channels = wave.num_channels();
+    const size_t units = size_t(wave.num_units());
+
+    // '=' and '\n', and a sign, 5 digits and a space per channel
+    state.buf.resize(units * (channels * 7 + 2));
+    char *p = &state.buf[0];
+    for (size_t i = 0; i < units; ++i)
+    {
+        int value[2];
+        bool same = true;
+        for (int ch = 0; ch < channels; ++ch)
+        {
+            size_t k = i * channels + ch;
+            value[ch] = wave.mode_8bit() ? int(wave.data_8bit(k)) : int(wave.data_16bit(k));
+            if (value[ch] != state.prev[ch])
+                same = false;
+        }
 
-    assert(wav_file);
-    fin = fopen(wav_file, "rb");
-    if (!fin)
+        if (state.index % keyframe == 0)
+        {
+            *p++ = '=';
+            for (int ch = 0; ch < channels; ++ch)
+            {
+                if (ch)
+                    *p++ = ' ';
+                p = put_int(p, value[ch]);
+            }
+        }
+        else if (!same)
+        {
+            for (int ch = 0; ch < channels; ++ch)
+            {
+                if (ch)
+                    *p++ = ' ';
+                p = put_int(p, value[ch] - state.prev[ch]);
+            }
+        }
+        *p++ = '\n';
+
+        for (int ch = 0; ch < channels; ++ch)
+            state.prev[ch] = value[ch];
+        ++state.index;
+    }
+
+    size_t size = p - &state.buf[0];
+    return !size || fwrite(&state.buf[0], size, 1, fout) == 1;
+}
+
+bool wav2txt_fp(const char *in, const char *out, FILE *fin, FILE *fout, const W2T& w2t)
+{
+    PcmWaveReader reader;
+    if (!reader.open(fin))
     {
-        fprintf(stderr, "ERROR: Unable to open file '%s'.\n", wav_file);
+        pcm_wave_message("ERROR: %s: unable to read\n", in);
         return false;
     }
 
-    char out_name[256];
-    if (!txt_file)
+    pcm_wave_show_info(in, reader.header());
+
+    if (!w2t.start.empty() || !w2t.end.empty())
     {
-        strcpy(out_name, wav_file);
-        strcat(out_name, ".txt");
-        txt_file = out_name;
+        uint32_t rate = reader.header().sample_rate();
+        uint64_t begin = w2t.start.empty() ? 0 : w2t.start.to_units(rate);
+        if (!reader.seek_range(begin, w2t.end.to_units(rate)))
+        {
+            pcm_wave_message("ERROR: %s: Invalid range.\n", in);
+            return false;
+        }
     }
 
-    fout = fopen(txt_file, "w");
-    if (!fout)
+    const PcmWave& header = reader.header();
+    if (w2t.delta)
     {
-        fprintf(stderr, "ERROR: Unable to open file '%s'.\n", txt_file);
-        fclose(fin);
-        return false;
+        if ((!header.mode_8bit() && !header.mode_16bit()) || header.num_channels() > 2)
+        {
+            pcm_wave_message("ERROR: %s: Unable to convert.\n", in);
+            return false;
+        }
+        fprintf(fout, "%s %d %d %lu %lu\n", W2T_DELTA_MAGIC, header.num_channels(),
+                header.mode(), (unsigned long)header.sample_rate(),
+                (unsigned long)w2t.keyframe);
     }
 
-    bool ret = wav2txt_fp(wav_file, txt_file, fin, fout);
-    if (ret)
+    PcmWave wave;
+    DeltaState state;
+    while (reader.read(wave, W2T_BLOCK_UNITS) > 0)
     {
-        fprintf(stderr, "'%s' --> '%s' (OK)\n", wav_file, txt_file);
+        bool ok = w2t.delta ? write_delta_block(fout, wave, w2t.keyframe, state)
+                            : write_block(fout, wave);
+        if (!ok)
+        {
+            pcm_wave_message("ERROR: %s: Unable to write.\n", out);
+            return false;
+        }
     }
 
-    fclose(fout);
-    fclose(fin);
-
-    return ret;
+    return true;
 }
 
-#ifdef WAV2TXT
-    static void show_help(void)
-    {
-        printf("wav2txt --- Converts a wave file to a text file\n");
-        printf("Usage: txt2wav [options] sound-file.wav [text-file.txt]\n");
-        printf("Options:\n");
-        printf("--help      Show this help.\n");
-        printf("--version   Show version info.\n");
-    }
+bool wav2txt(const char *wav_file, const char *txt_file, const W2T& w2t)
+{
+    FILE *fin, *fout;
 
-    static void show_version(void)
+    assert(wav_file);
+    fin = pcm_wave_fopen(wav_file, "rb");
+    if (!fin)
     {
-        printf("wav2txt version 0.4 by katahiromz\n");
+        pcm_wave_message("ERROR: Unable to open file '%s'.\n", wav_file);
+        return false;
     }
 
-    int main(int argc, char **argv)
+    char out_name[256];
+    if (!txt_file)
     {
-        if (argc <= 1)
+        if (strcmp(wav_file, "-") == 0)
         {
-            show_help();
-            return EXIT_SUCCESS;
+            txt_file = "-";
         }
-
-        const char *arg1 = NULL;
-        const char *arg2 = NULL;
-        for (int i = 1; i < argc; ++i)
+        else
         {
-            if (argv[i][0] == '-')
-            {
-                if (strcmp(argv[i], "--help") == 0)
-                {
-                    show_help();
-                    return EXIT_SUCCESS;
-                }
-                if (strcmp(argv[i], "--version") == 0)
-                {
-                    show_version();
-                    return EXIT_SUCCESS;
-                }
-
-                fprintf(stderr, "ERROR: Invalid argument '%s'.\n", argv[i]);
-                return EXIT_FAILURE;
-            }
-            if (arg1 == NULL)
-            {
-                arg1 = argv[i];
-            }
-            else if (arg2 == NULL)
-            {
-                arg2 = argv[i];
-            }
-            else
-            {
-                fprintf(stderr, "ERROR: Too many argument.\n");
-                return EXIT_FAILURE;
-            }
+            strcpy(out_name, wav_file);
+            strcat(out_name, ".txt");
+            txt_file = out_name;
         }
+    }
 
-        if (arg1 == NULL)
-        {
-            fprintf(stderr, "ERROR: No input file.\n");
-            return EXIT_FAILURE;
-        }
+    fout = pcm_wave_fopen(txt_file, "w");
+    if (!fout)
+    {
+        pcm_wave_message("ERROR: Unable to open file '%s'.\n", txt_file);
+        pcm_wave_fclose(fin);
+        return false;
+    }
 
-        return wav2txt(arg1, arg2) ? EXIT_SUCCESS : EXIT_FAILURE;
+    bool ret = wav2txt_fp(wav_file, txt_file, fin, fout, w2t);
+    if (ret)
+    {
+        pcm_wave_message("'%s' --> '%s' (OK)\n", wav_file, txt_file);
     }
-#endif
+
+    pcm_wave_fclose(fout);
+    pcm_wave_fclose(fin);
+
+    return ret;
+}
@@ -3,7 +3,19 @@
 
 #include <cstdio>
 
-bool wav2txt_fp(const char *in, const char *out, FILE *fin, FILE *fout);
-bool wav2txt(const char *wav_file, const char *txt_file);
+#define W2T_BLOCK_UNITS     (64 * 1024)     // frames per streaming block
+#define W2T_KEYFRAME        4096            // frames per keyframe of the delta dialect
+#define W2T_DELTA_MAGIC     "#delta"        // the first line of the delta dialect
+
+struct W2T
+{
+    PcmWaveTime start;      // from the beginning if empty
+    PcmWaveTime end;        // to the end if empty
+    bool delta = false;     // write the delta dialect
+    uint32_t keyframe = W2T_KEYFRAME;
+};
+
+bool wav2txt_fp(const char *in, const char *out, FILE *fin, FILE *fout, const W2T& w2t);
+bool wav2txt(const char *wav_file, const char *txt_file, const W2T& w2t);
 
 #endif  // ndef WAV2TXT_HPP_
@@ -0,0 +1,118 @@
+#include "PcmWave.hpp"
+#include "wav2txt.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static void show_help(void)
+{
+    printf("wav2txt --- Converts a wave file to a text file\n");
+    printf("Usage: wav2txt [options] sound-file.wav [text-file.txt]\n");
+    printf("Use '-' for stdin/stdout.\n");
+    printf("Options:\n");
+    printf("--help          Show this help.\n");
+    printf("--version       Show version info.\n");
+    printf("--start TIME    Start position in seconds, or frames with 'f' suffix.\n");
+    printf("--end TIME      End position in seconds, or frames with 'f' suffix.\n");
+    printf("--delta         Write differences between frames, with keyframes.\n");
+    printf("--keyframe XXX  Frames per keyframe of '--delta' (default: %d).\n", W2T_KEYFRAME);
+}
+
+static void show_version(void)
+{
+    printf("wav2txt version 0.5 by katahiromz\n");
+}
+
+int main(int argc, char **argv)
+{
+    pcm_wave_messages() = stderr;    // the library is quiet otherwise
+
+    W2T w2t;
+
+    if (argc <= 1)
+    {
+        show_help();
+        return EXIT_SUCCESS;
+    }
+
+    const char *arg1 = NULL;
+    const char *arg2 = NULL;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (argv[i][0] == '-' && argv[i][1] != 0)
+        {
+            if (strcmp(argv[i], "--help") == 0)
+            {
+                show_help();
+                return EXIT_SUCCESS;
+            }
+            if (strcmp(argv[i], "--version") == 0)
+            {
+                show_version();
+                return EXIT_SUCCESS;
+            }
+            if (strcmp(argv[i], "--delta") == 0)
+            {
+                w2t.delta = true;
+                continue;
+            }
+            if (strcmp(argv[i], "--keyframe") == 0)
+            {
+                if (i + 1 >= argc)
+                {
+                    fprintf(stderr, "ERROR: No parameter for '%s'.\n", argv[i]);
+                    return EXIT_FAILURE;
+                }
+                ++i;
+                w2t.keyframe = (uint32_t)strtoul(argv[i], NULL, 0);
+                if (w2t.keyframe == 0)
+                {
+                    fprintf(stderr, "ERROR: Invalid parameter '%s'.\n", argv[i]);
+                    return EXIT_FAILURE;
+                }
+                continue;
+            }
+
+            if (strcmp(argv[i], "--start") == 0 || strcmp(argv[i], "--end") == 0)
+            {
+                if (i + 1 >= argc)
+                {
+                    fprintf(stderr, "ERROR: No parameter for '%s'.\n", argv[i]);
+                    return EXIT_FAILURE;
+                }
+                PcmWaveTime& time = (argv[i][2] == 's') ? w2t.start : w2t.end;
+                ++i;
+                if (!time.parse(argv[i]))
+                {
+                    fprintf(stderr, "ERROR: Invalid parameter '%s'.\n", argv[i]);
+                    return EXIT_FAILURE;
+                }
+                continue;
+            }
+
+            fprintf(stderr, "ERROR: Invalid argument '%s'.\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+        if (arg1 == NULL)
+        {
+            arg1 = argv[i];
+        }
+        else if (arg2 == NULL)
+        {
+            arg2 = argv[i];
+        }
+        else
+        {
+            fprintf(stderr, "ERROR: Too many argument.\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (arg1 == NULL)
+    {
+        fprintf(stderr, "ERROR: No input file.\n");
+        return EXIT_FAILURE;
+    }
+
+    return wav2txt(arg1, arg2, w2t) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -1,96 +1,116 @@
 #include "PcmWave.hpp"
+#include "PcmSimd.hpp"
+#include "PcmParallel.hpp"
+#include "PcmHash.hpp"
 #include "wav2wav.hpp"
 #include <cstdio>
+#include <cstdlib>
+#include <cmath>
 #include <limits>
+#include <string>
+#include <sys/stat.h>
+#ifdef _WIN32
+    #include <direct.h>
+    #include <process.h>
+#else
+    #include <unistd.h>
+#endif
+#ifdef __linux__
+    #include <fcntl.h>
+    #include <sys/ioctl.h>
+    #include <linux/fs.h>
+#endif
 
-static void show_info(const char *name, const PcmWave& wave)
-{
-    fprintf(stderr, "%s: %ld Hz sampling, %d-bit, %d channel (%.2f seconds)\n",
-            name, wave.sample_rate(),
-            wave.mode(), wave.num_channels(), wave.seconds());
-}
+// The converters presize the output and fill disjoint ranges of it in
+// parallel. A streaming block is below the grain and stays serial.
 
-bool mono_to_stereo(const PcmWave& wave1, PcmWave& wave2)
+bool mono_to_stereo(const PcmWaveView& wave1, PcmWave& wave2)
 {
+    PCM_TRACE_SCOPE("mono_to_stereo");
     wave2.clear();
 
-    if (wave1.num_channels() != 1)
-    {
-        assert(0);
+    if (wave1.num_channels() != 1 || (wave1.mode() != 8 && wave1.mode() != 16))
         return false;
-    }
 
-    wave2.reserve(wave1.num_units() * wave1.num_channels() * 2);
+    size_t units = size_t(wave1.num_units());
+    wave2.set_info(2, wave1.mode(), wave1.sample_rate());
+    wave2.resize(size_t(wave1.data_size()) * 2);
+    if (units == 0)
+        return true;
 
-    switch (wave1.mode())
+    if (wave1.mode() == 8)
     {
-    case 8:
-        wave2.set_info(2, wave1.mode(), wave1.sample_rate());
-        for (size_t i = 0; i < wave1.num_units() * wave1.num_channels(); ++i)
+        const uint8_t *src = &wave1.data_8bit(0);
+        uint8_t *dest = &wave2.data_8bit(0);
+        pcm_parallel_for(units, W2W_FRAME_GRAIN, [=](size_t, size_t begin, size_t end)
         {
-            uint8_t value = wave1.data_8bit(i);
-            wave2.push_8bit(value);
-            wave2.push_8bit(value);
-        }
-        break;
-    case 16:
-        wave2.set_info(2, wave1.mode(), wave1.sample_rate());
-        for (size_t i = 0; i < wave1.num_units() * wave1.num_channels(); ++i)
+            for (size_t i = begin; i < end; ++i)
+            {
+                dest[2 * i] = src[i];
+                dest[2 * i + 1] = src[i];
+            }
+        });
+    }
+    else
+    {
+        const int16_t *src = &wave1.data_16bit(0);
+        int16_t *dest = &wave2.data_16bit(0);
+        pcm_parallel_for(units, W2W_FRAME_GRAIN, [=](size_t, size_t begin, size_t end)
         {
-            int16_t value = wave1.data_16bit(i);
-            wave2.push_16bit(value);
-            wave2.push_16bit(value);
-        }
-        break;
-    default:
-        assert(0);
-        return false;
+            for (size_t i = begin; i < end; ++i)
+            {
+                dest[2 * i] = src[i];
+                dest[2 * i + 1] = src[i];
+            }
+        });
     }
 
-    wave2.update_info();
     return true;
 }
 
-bool stereo_to_mono(const PcmWave& wave1, PcmWave& wave2)
+bool stereo_to_mono(const PcmWaveView& wave1, PcmWave& wave2)
 {
+    PCM_TRACE_SCOPE("stereo_to_mono");
     wave2.clear();
 
-    if (wave1.num_channels() != 2)
-    {
-        assert(0);
+    if (wave1.num_channels() != 2 || (wave1.mode() != 8 && wave1.mode() != 16))
         return false;
-    }
 
-    wave2.reserve(wave1.num_units() * wave1.num_channels() / 2);
+    size_t units = size_t(wave1.num_units());
+    wave2.set_info(1, wave1.mode(), wave1.sample_rate());
+    wave2.resize(size_t(wave1.data_size()) / 2);
+    if (units == 0)
+        return true;
 
-    switch (wave1.mode())
+    if (wave1.mode() == 8)
     {
-    case 8:
-        wave2.set_info(1, wave1.mode(), wave1.sample_rate());
-        for (size_t i = 0; i < wave1.num_units() * wave1.num_channels(); i += 2)
+        const uint8_t *src = &wave1.data_8bit(0);
+        uint8_t *dest = &wave2.data_8bit(0);
+        pcm_parallel_for(units, W2W_FRAME_GRAIN, [=](size_t, size_t begin, size_t end)
         {
-            int left = wave1.data_8bit(i);
-            int right = wave1.data_8bit(i + 1);
-            uint8_t middle = uint8_t((left + right) / 2);
-            wave2.push_8bit(middle);
-        }
-        break;
-    case 16:
-        wave2.set_info(1, wave1.mode(), wave1.sample_rate());
-        for (size_t i = 0; i < wave1.num_units() * wave1.num_channels(); i += 2)
+            for (size_t i = begin; i < end; ++i)
+            {
+                int left = src[2 * i];
+                int right = src[2 * i + 1];
+                dest[i] = uint8_t((left + right) / 2);
+            }
+        });
+    }
+    else
+    {
+        const int16_t *src = &wave1.data_16bit(0);
+        int16_t *dest = &wave2.data_16bit(0);
+        pcm_parallel_for(units, W2W_FRAME_GRAIN, [=](size_t, size_t begin, size_t end)
         {
-            int left = wave1.data_16bit(i);
-            int right = wave1.data_16bit(i + 1);
-            int16_t middle = int16_t((left + right) / 2);
-            wave2.push_16bit(middle);
-        }
-        break;
-    default:
-        assert(0);
-        return false;
+            for (size_t i = begin; i < end; ++i)
+            {
+                int left = src[2 * i];
+                int right = src[2 * i + 1];
+                dest[i] = int16_t((left + right) / 2);
+            }
+        });
     }
 
-    wave2.update_info();
     return true;
 }
 
@@ -109,125 +129,133 @@ inline void interpolation_test(void)
     assert(linear_interpolation(32767, -32768, 32767, 0, 255) == 255);
 }
 
-bool mode_8bit_to_16bit(const PcmWave& wave1, PcmWave& wave2)
+bool mode_8bit_to_16bit(const PcmWaveView& wave1, PcmWave& wave2)
 {
+    PCM_TRACE_SCOPE("mode_8bit_to_16bit");
     interpolation_test();
 
     wave2.clear();
 
-    if (wave1.mode() != 8)
-    {
-        assert(0);
+    if (wave1.mode() != 8 || (wave1.num_channels() != 1 && wave1.num_channels() != 2))
         return false;
-    }
 
-    wave2.reserve(wave1.num_units() * wave1.num_channels() * 2);
+    // a sample is a sample of either channel
+    size_t count = size_t(wave1.num_units()) * wave1.num_channels();
+    wave2.set_info(wave1.num_channels(), 16, wave1.sample_rate());
+    wave2.resize(count * 2);
+    if (count == 0)
+        return true;
 
-    switch (wave1.num_channels())
+    const uint8_t *src = &wave1.data_8bit(0);
+    int16_t *dest = &wave2.data_16bit(0);
+    pcm_parallel_for(count, W2W_GRAIN, [=](size_t, size_t begin, size_t end)
     {
-    case 1:
-        wave2.set_info(1, 16, wave1.sample_rate());
-        for (size_t i = 0; i < wave1.num_units() * wave1.num_channels(); ++i)
+        for (size_t i = begin; i < end; ++i)
         {
-            int value = wave1.data_16bit(i);
-            assert(0 <= value && value <= 255);
             // [0, 255] --> [-32768, 32767]
-            value = linear_interpolation(value, 0, 255, -32768, 32767);
-            assert(-32768 <= value && value <= 32767);
-            wave2.push_16bit(int16_t(value));
+            dest[i] = int16_t(linear_interpolation(src[i], 0, 255, -32768, 32767));
         }
-        break;
-    case 2:
-        wave2.set_info(2, 16, wave1.sample_rate());
-        for (size_t i = 0; i < wave1.num_units() * wave1.num_channels(); i += 2)
-        {
-            int left = wave1.data_16bit(i);
-            int right = wave1.data_16bit(i + 1);
-            assert(0 <= left && left <= 255);
-            assert(0 <= right && right <= 255);
-            // [0, 255] --> [-32768, 32767]
-            left = linear_interpolation(left, 0, 255, -32768, 32767);
-            right = linear_interpolation(right, 0, 255, -32768, 32767);
-            assert(-32768 <= left && left <= 32767);
-            assert(-32768 <= right && right <= 32767);
-            wave2.push_16bit(int16_t(left));
-            wave2.push_16bit(int16_t(right));
-        }
-        break;
-    default:
-        assert(0);
-        return false;
-    }
+    });
 
-    wave2.update_info();
     return true;
 }
 
-bool mode_16bit_to_8bit(const PcmWave& wave1, PcmWave& wave2)
+bool mode_16bit_to_8bit(const PcmWaveView& wave1, PcmWave& wave2)
 {
+    PCM_TRACE_SCOPE("mode_16bit_to_8bit");
     interpolation_test();
 
     wave2.clear();
 
-    if (wave1.mode() != 16)
-    {
-        assert(0);
+    if (wave1.mode() != 16 || (wave1.num_channels() != 1 && wave1.num_channels() != 2))
         return false;
-    }
 
-    wave2.reserve(wave1.num_units() * wave1.num_channels() / 2);
+    size_t count = size_t(wave1.num_units()) * wave1.num_channels();
+    wave2.set_info(wave1.num_channels(), 8, wave1.sample_rate());
+    wave2.resize(count);
+    if (count == 0)
+        return true;
 
-    switch (wave1.num_channels())
+    const int16_t *src = &wave1.data_16bit(0);
+    uint8_t *dest = &wave2.data_8bit(0);
+    pcm_parallel_for(count, W2W_GRAIN, [=](size_t, size_t begin, size_t end)
     {
-    case 1:
-        wave2.set_info(1, 8, wave1.sample_rate());
-        for (size_t i = 0; i < wave1.num_units() * wave1.num_channels(); ++i)
+        for (size_t i = begin; i < end; ++i)
         {
-            int value = wave1.data_16bit(i);
-            assert(-32768 <= value && value <= 32767);
             // [-32768, 32767] --> [0, 255]
-            value = linear_interpolation(value, -32768, 32767, 0, 255);
-            assert(0 <= value && value <= 255);
-            wave2.push_8bit(uint8_t(value));
+            dest[i] = uint8_t(linear_interpolation(src[i], -32768, 32767, 0, 255));
         }
+    });
+
+    return true;
+}
+
+// the level of all samples, as a parallel reduction
+bool scan_level(const PcmWave& wave, PcmLevel& level)
+{
+    PCM_TRACE_SCOPE("scan_level");
+    size_t count = wave.num_units() * wave.num_channels();
+    if (count == 0)
+        return true;
+
+    std::vector<PcmLevel> levels(pcm_parallel_num_chunks(count, W2W_GRAIN));
+    switch (wave.mode())
+    {
+    case 8:
+        pcm_parallel_for(count, W2W_GRAIN, [&](size_t chunk, size_t begin, size_t end)
+        {
+            pcm_scan_8bit(&wave.data_8bit(begin), end - begin, levels[chunk]);
+        });
         break;
-    case 2:
-        wave2.set_info(2, 8, wave1.sample_rate());
-        for (size_t i = 0; i < wave1.num_units() * wave1.num_channels(); i += 2)
+    case 16:
+        pcm_parallel_for(count, W2W_GRAIN, [&](size_t chunk, size_t begin, size_t end)
         {
-            int left = wave1.data_16bit(i);
-            int right = wave1.data_16bit(i + 1);
-            assert(-32768 <= left && left <= 32767);
-            assert(-32768 <= right && right <= 32767);
-            // [-32768, 32767] --> [0, 255]
-            left = linear_interpolation(left, -32768, 32767, 0, 255);
-            right = linear_interpolation(right, -32768, 32767, 0, 255);
-            assert(0 <= left && left <= 255);
-            assert(0 <= right && right <= 255);
-            wave2.push_8bit(uint8_t(left));
-            wave2.push_8bit(uint8_t(right));
-        }
+            pcm_scan_16bit(&wave.data_16bit(begin), end - begin, levels[chunk]);
+        });
         break;
     default:
-        assert(0);
         return false;
     }
 
-    wave2.update_info();
+    for (auto& chunk : levels)
+    {
+        level.add(chunk);
+    }
     return true;
 }
 
-bool wav2wav_fp(const char *in, const char *out, FILE *fin, FILE *fout, W2W& w2w)
+// multiplies all samples by gain with saturation
+bool apply_gain(PcmWave& wave, float gain)
 {
-    PcmWave wave1, wave2, wave3;
+    PCM_TRACE_SCOPE("apply_gain");
+    size_t count = wave.num_units() * wave.num_channels();
+    if (count == 0)
+        return true;
 
-    if (!wave1.read_from_fp(fin))
+    switch (wave.mode())
     {
-        fprintf(stderr, "ERROR: %s: unable to read\n", in);
+    case 8:
+        pcm_parallel_for(count, W2W_GRAIN, [&](size_t, size_t begin, size_t end)
+        {
+            pcm_gain_8bit(&wave.data_8bit(begin), end - begin, gain);
+        });
+        break;
+    case 16:
+        pcm_parallel_for(count, W2W_GRAIN, [&](size_t, size_t begin, size_t end)
+        {
+            pcm_gain_16bit(&wave.data_16bit(begin), end - begin, gain);
+        });
+        break;
+    default:
         return false;
     }
+    return true;
+}
 
-    show_info(in, wave1);
+// converts the channels and bits of wave1 as w2w says. wave1 may be moved.
+bool convert_wave(PcmWave& wave1, PcmWave& wave3, const W2W& w2w)
+{
+    PcmWave wave2;
 
     bool flag = false;
     switch (w2w.channels)
@@ -261,10 +289,7 @@ bool wav2wav_fp(const char *in, const char *out, FILE *fin, FILE *fout, W2W& w2w
     }
 
     if (!flag)
-    {
-        fprintf(stderr, "ERROR: %s: Unable to convert.\n", in);
         return false;
-    }
 
     flag = false;
     switch (w2w.mode)
@@ -297,185 +322,1024 @@ bool wav2wav_fp(const char *in, const char *out, FILE *fin, FILE *fout, W2W& w2w
         break;
     }
 
-    if (!flag)
+    return flag;
+}
+
+// the same for frames that wave1 does not own; they are read in place
+bool convert_wave(const PcmWaveView& wave1, PcmWave& wave3, const W2W& w2w)
+{
+    bool channels = (w2w.channels != 0 && w2w.channels != wave1.num_channels());
+    bool bits = (w2w.mode != 0 && w2w.mode != wave1.mode());
+    if (!channels && !bits)
     {
-        fprintf(stderr, "ERROR: %s: Unable to convert.\n", in);
-        return false;
+        wave3.set_info(wave1.num_channels(), wave1.mode(), wave1.sample_rate());
+        wave3.set_data(wave1.data(), wave1.size());
+        return true;
+    }
+    if (!channels)
+    {
+        return (w2w.mode == 8) ? mode_16bit_to_8bit(wave1, wave3)
+                               : mode_8bit_to_16bit(wave1, wave3);
     }
 
-    if (w2w.sampling_rate)
+    PcmWave wave2;
+    bool flag = (w2w.channels == 1) ? stereo_to_mono(wave1, wave2)
+                                    : mono_to_stereo(wave1, wave2);
+    if (!flag)
+        return false;
+    if (!bits)
     {
-        wave3.sample_rate(w2w.sampling_rate);
-        wave3.update_info();
+        wave3 = std::move(wave2);
+        return true;
     }
+    return (w2w.mode == 8) ? mode_16bit_to_8bit(wave2, wave3)
+                           : mode_8bit_to_16bit(wave2, wave3);
+}
+
+bool W2WChannelsNode::configure(const PcmFormat& in, PcmFormat& out)
+{
+    out = in;
+    out.channels = uint16_t(m_channels);
+    return (in.channels == 1 || in.channels == 2) && (in.bits == 8 || in.bits == 16);
+}
+
+PcmWave *W2WChannelsNode::process(PcmWave& in, PcmWave& out)
+{
+    if (in.num_channels() == m_channels)
+        return &in;
+    bool ok = (m_channels == 1) ? stereo_to_mono(in, out) : mono_to_stereo(in, out);
+    return ok ? &out : NULL;
+}
+
+bool W2WBitsNode::configure(const PcmFormat& in, PcmFormat& out)
+{
+    out = in;
+    out.bits = uint16_t(m_bits);
+    return (in.channels == 1 || in.channels == 2) && (in.bits == 8 || in.bits == 16);
+}
+
+PcmWave *W2WBitsNode::process(PcmWave& in, PcmWave& out)
+{
+    if (in.mode() == m_bits)
+        return &in;
+    bool ok = (m_bits == 8) ? mode_16bit_to_8bit(in, out) : mode_8bit_to_16bit(in, out);
+    return ok ? &out : NULL;
+}
+
+bool W2WRateNode::configure(const PcmFormat& in, PcmFormat& out)
+{
+    out = in;
+    out.rate = m_rate;
+    return m_rate > 0;
+}
+
+PcmWave *W2WRateNode::process(PcmWave& in, PcmWave&)
+{
+    in.sample_rate(m_rate);
+    in.update_info();
+    return &in;
+}
+
+bool W2WGainNode::configure(const PcmFormat& in, PcmFormat& out)
+{
+    out = in;
+    return in.bits == 8 || in.bits == 16;
+}
+
+PcmWave *W2WGainNode::process(PcmWave& in, PcmWave&)
+{
+    return apply_gain(in, m_gain) ? &in : NULL;
+}
 
-    show_info(out, wave3);
-    assert(wave3.is_valid());
+bool W2WFilterNode::configure(const PcmFormat& in, PcmFormat& out)
+{
+    out = in;
+    if (in.bits != 8 && in.bits != 16)
+        return false;
 
-    if (!wave3.write_to_fp(fout))
+    PcmFilterChain chain;
+    if (!chain.parse(m_spec.c_str(), in.rate))
     {
-        fprintf(stderr, "ERROR: %s: Unable to write.\n", out);
+        pcm_wave_message("ERROR: Invalid filter '%s' at %lu Hz.\n", m_spec.c_str(),
+                         (unsigned long)in.rate);
         return false;
     }
+    m_format = in;
+    m_chains.assign(in.channels, chain);
+    m_planes.resize(in.channels);
+    m_delay = m_skip = chain.delay();
+    return true;
+}
 
-    fprintf(stderr, "'%s' --> '%s' (OK)\n", in, out);
+PcmWave *W2WFilterNode::process(PcmWave& in, PcmWave& out)
+{
+    return filter(in, out) ? &out : NULL;
+}
 
+// the last frames, by filtering silence as long as the delay
+PcmWave *W2WFilterNode::drain(PcmWave& out)
+{
+    if (m_delay == 0)
+        return NULL;
+
+    PcmWave silence;
+    silence.set_info(m_format.channels, m_format.bits, m_format.rate);
+    silence.resize(m_delay * silence.data_unit());
+    if (m_format.bits == 8)
+        memset(&silence.data_8bit(0), 128, size_t(silence.data_size()));
+    if (!filter(silence, out) || out.empty())
+        return NULL;
+    return &out;
+}
+
+// Filters in into out in floats, a channel per task. The output starts
+// m_delay frames late, which makes up for the delay of the filters.
+bool W2WFilterNode::filter(PcmWave& in, PcmWave& out)
+{
+    PCM_TRACE_SCOPE("filter");
+    const int channels = in.num_channels();
+    const size_t units = size_t(in.num_units());
+    const bool is8 = in.mode_8bit();
+    pcm_parallel_for(channels, 1, [&](size_t, size_t begin, size_t end)
+    {
+        for (size_t ch = begin; ch < end; ++ch)
+        {
+            std::vector<float>& plane = m_planes[ch];
+            plane.resize(units);
+            for (size_t i = 0; i < units; ++i)
+            {
+                plane[i] = is8 ? float(int(in.data_8bit(i * channels + ch)) - 128)
+                               : float(in.data_16bit(i * channels + ch));
+            }
+            if (units)
+                m_chains[ch].process(&plane[0], units);
+        }
+    });
+
+    size_t skip = (m_skip < units) ? m_skip : units;
+    m_skip -= skip;
+    size_t frames = units - skip;
+    out.set_info(channels, in.mode(), in.sample_rate());
+    out.resize(frames * in.data_unit());
+    if (frames == 0)
+        return true;
+
+    m_mixed.resize(frames * channels);
+    for (int ch = 0; ch < channels; ++ch)
+    {
+        const float *plane = &m_planes[ch][skip];
+        for (size_t i = 0; i < frames; ++i)
+            m_mixed[i * channels + ch] = plane[i];
+    }
+    if (is8)
+        pcm_store_8bit(&out.data_8bit(0), &m_mixed[0], m_mixed.size());
+    else
+        pcm_store_16bit(&out.data_16bit(0), &m_mixed[0], m_mixed.size());
     return true;
 }
 
-bool wav2wav(const char *file1, const char *file2, W2W& w2w)
+// hashes the frames of the source for the cache; the first node of a graph
+class W2WHashNode : public PcmNode
 {
-    FILE *fin, *fout;
+public:
+    explicit W2WHashNode(PcmHash64 *hash) : m_hash(hash) { }
 
-    assert(file1);
-    fin = fopen(file1, "rb");
-    if (!fin)
+    bool configure(const PcmFormat& in, PcmFormat& out)
     {
-        fprintf(stderr, "ERROR: Unable to open file '%s'.\n", file1);
-        return false;
+        out = in;
+        return true;
     }
 
-    char out_name[256];
-    if (!file2)
+    PcmWave *process(PcmWave& in, PcmWave&)
     {
-        strcpy(out_name, file1);
-        strcat(out_name, ".wav");
-        file2 = out_name;
+        if (in.data_size() > 0)
+            m_hash->update(&in.data_8bit(0), size_t(in.data_size()));
+        return &in;
     }
 
-    fout = fopen(file2, "wb");
-    if (!fout)
+protected:
+    PcmHash64 *m_hash;
+};
+
+// measures the level of the blocks that reach the gain of --normalize
+class W2WLevelNode : public PcmNode
+{
+public:
+    bool configure(const PcmFormat& in, PcmFormat& out)
     {
-        fprintf(stderr, "ERROR: Unable to open file '%s'.\n", file2);
-        fclose(fin);
+        out = in;
+        m_bits = in.bits;
+        return in.bits == 8 || in.bits == 16;
+    }
+
+    PcmWave *process(PcmWave& in, PcmWave&)
+    {
+        return scan_level(in, m_level) ? &in : NULL;
+    }
+
+    const PcmLevel& level() const
+    {
+        return m_level;
+    }
+
+    int bits() const
+    {
+        return m_bits;
+    }
+
+protected:
+    PcmLevel m_level;
+    int m_bits = 0;
+};
+
+// adds the nodes of w2w that come before the gain after parent; returns the
+// last one
+static int add_w2w_pre_nodes(PcmGraph& graph, const W2W& w2w, int parent)
+{
+    if (w2w.channels)
+        parent = graph.add(new W2WChannelsNode(w2w.channels), parent);
+    // the filter and the gain run at the wider of the two sample sizes
+    if (w2w.mode == 16)
+        parent = graph.add(new W2WBitsNode(w2w.mode), parent);
+    if (w2w.filter)
+        parent = graph.add(new W2WFilterNode(w2w.filter), parent);
+    return parent;
+}
+
+// adds the gain and the nodes of w2w after it after parent; returns the
+// last one
+static int add_w2w_post_nodes(PcmGraph& graph, const W2W& w2w, float gain, int parent)
+{
+    if (gain != 1.0f)
+        parent = graph.add(new W2WGainNode(gain), parent);
+    if (w2w.mode && w2w.mode != 16)
+        parent = graph.add(new W2WBitsNode(w2w.mode), parent);
+    if (w2w.sampling_rate)
+        parent = graph.add(new W2WRateNode(w2w.sampling_rate), parent);
+    return parent;
+}
+
+// The analysis pass of --normalize. It runs the nodes before the gain and
+// measures the level of their output, where the gain applies. That output
+// is spooled to *spool, and converted from there by the nodes after the
+// gain, unless there are no such nodes and the input can be read again.
+static bool normalize_pass(const char *in, PcmWaveReader& reader,
+                           uint64_t begin, uint64_t end,
+                           const W2W& w2w, float& gain, FILE **spool,
+                           PcmHash64 *hash)
+{
+    const PcmWave& header = reader.header();
+    PcmGraph graph;
+    int first = hash ? graph.add(new W2WHashNode(hash)) : -1;
+    int parent = add_w2w_pre_nodes(graph, w2w, first);
+    bool spooling = (parent != first || !reader.is_seekable());
+    W2WLevelNode *level = new W2WLevelNode;
+    parent = graph.add(level, parent);
+
+    *spool = NULL;
+    if (spooling)
+    {
+        *spool = tmpfile();
+        if (!*spool)
+        {
+            pcm_wave_message("ERROR: %s: Unable to create a temporary file.\n", in);
+            return false;
+        }
+        graph.add(new PcmWriterNode(*spool, "temporary file", 0, reader.remaining_units()), parent);
+    }
+
+    PcmFormat source = { header.num_channels(), header.mode(), uint32_t(header.sample_rate()) };
+    if (!graph.configure(source))
+    {
+        pcm_wave_message("ERROR: %s: Unable to convert.\n", in);
+        return false;
+    }
+    if (!graph.run(reader, W2W_SCAN_UNITS))
         return false;
+
+    double ratio, target = 1.0;
+    if (w2w.normalize == W2W_NORMALIZE_PEAK)
+    {
+        ratio = level->level().peak_ratio(level->bits());
+    }
+    else
+    {
+        ratio = level->level().rms_ratio(level->bits());
+        target = std::pow(10.0, W2W_RMS_TARGET_DB / 20);
     }
+    if (ratio > 0)
+        gain *= float(target / ratio);
 
-    bool ret = wav2wav_fp(file1, file2, fin, fout, w2w);
+    pcm_wave_message("%s: peak %.2f dBFS, RMS %.2f dBFS, gain %+.2f dB\n", in,
+                     20 * std::log10(level->level().peak_ratio(level->bits()) + 1e-12),
+                     20 * std::log10(level->level().rms_ratio(level->bits()) + 1e-12),
+                     20 * std::log10(gain));
 
-    fclose(fout);
-    fclose(fin);
+    bool ok;
+    if (*spool)
+        ok = fseek(*spool, 0, SEEK_SET) == 0 && reader.open(*spool);
+    else
+        ok = reader.seek_range(begin, end);
+    if (!ok)
+        pcm_wave_message("ERROR: %s: unable to read\n", in);
+    return ok;
+}
 
-    return ret;
+// The flags of PcmWaveWriter::open for an output
+static int writer_flags(int format, bool rifx, bool lossless)
+{
+    int flags = rifx ? PCM_WAVE_HEADER_RIFX : 0;
+    if (lossless)
+        flags = PCM_WAVE_HEADER_LOSSLESS;
+    else if (format == PCM_WAVE_FORMAT_IMA_ADPCM)
+        flags = PCM_WAVE_HEADER_IMA_ADPCM;
+    else if (format == PCM_WAVE_FORMAT_MULAW)
+        flags |= PCM_WAVE_HEADER_MULAW;
+    else if (format == PCM_WAVE_FORMAT_ALAW)
+        flags |= PCM_WAVE_HEADER_ALAW;
+    return flags;
 }
 
-#ifdef WAV2WAV
-    static void show_help(void)
+// A branch of --chain: the steps after the options of w2w, and the output.
+// A step is a node, or an option of the output.
+struct W2WBranch
+{
+    std::vector<std::string> steps;
+    std::string file;
+    FILE *fp = NULL;
+};
+
+#define W2W_STEP_CHANNELS   0
+#define W2W_STEP_MODE       1
+#define W2W_STEP_RATE       2
+#define W2W_STEP_GAIN       3
+#define W2W_STEP_FORMAT     4   // mode=ima|ulaw|alaw
+#define W2W_STEP_RIFX       5
+#define W2W_STEP_LOSSLESS   6
+#define W2W_STEP_FILTER     7   // filter=SPEC of PcmFilterChain
+
+static bool parse_step(const std::string& step, int& type, double& value)
+{
+    value = 0;
+    if (step == "rifx")
+    {
+        type = W2W_STEP_RIFX;
+        return true;
+    }
+    if (step == "lossless")
     {
-        printf("wav2wav --- Converts a wave file to another wave file\n");
-        printf("Usage: txt2wav [options] wave-file-1.txt [wave-file-2.wav]\n");
-        printf("Options:\n");
-        printf("--help          Show this help.\n");
-        printf("--version       Show version info.\n");
-        printf("--channels XXX  Specify the number of channels.\n");
-        printf("--rate XXX      Specify sampling rate.\n");
-        printf("--mode XXX      Specify bits per sample.\n");
+        type = W2W_STEP_LOSSLESS;
+        return true;
     }
 
-    static void show_version(void)
+    size_t eq = step.find('=');
+    if (eq == std::string::npos)
+        return false;
+    std::string name = step.substr(0, eq);
+    const char *arg = step.c_str() + eq + 1;
+
+    if (name == "filter")
     {
-        printf("wav2wav version 0.5 by katahiromz\n");
+        type = W2W_STEP_FILTER;
+        return *arg != 0;
     }
+    if (name == "mode")
+    {
+        type = W2W_STEP_FORMAT;
+        if (strcmp(arg, "ima") == 0)
+            value = PCM_WAVE_FORMAT_IMA_ADPCM;
+        else if (strcmp(arg, "ulaw") == 0)
+            value = PCM_WAVE_FORMAT_MULAW;
+        else if (strcmp(arg, "alaw") == 0)
+            value = PCM_WAVE_FORMAT_ALAW;
+        else
+            type = W2W_STEP_MODE;
+        if (type == W2W_STEP_FORMAT)
+            return true;
+    }
+    else if (name == "channels")
+        type = W2W_STEP_CHANNELS;
+    else if (name == "rate")
+        type = W2W_STEP_RATE;
+    else if (name == "gain")
+        type = W2W_STEP_GAIN;
+    else
+        return false;
+
+    char *endptr;
+    value = strtod(arg, &endptr);
+    if (*arg == 0 || *endptr != 0)
+        return false;
+    switch (type)
+    {
+    case W2W_STEP_CHANNELS:
+        return value == 1 || value == 2;
+    case W2W_STEP_MODE:
+        return value == 8 || value == 16;
+    case W2W_STEP_RATE:
+        return value >= 1 && value <= 0xFFFFFFFF && value == std::floor(value);
+    default:
+        return true;
+    }
+}
 
-    int main(int argc, char **argv)
+// "STEP,STEP,...>FILE;STEP,...>FILE;..."
+static bool parse_chain(const char *chain, std::vector<W2WBranch>& branches)
+{
+    std::string spec = chain;
+    size_t pos = 0;
+    do
     {
-        W2W w2w;
+        size_t semi = spec.find(';', pos);
+        std::string text = spec.substr(pos, (semi == std::string::npos) ? std::string::npos : semi - pos);
+        pos = (semi == std::string::npos) ? spec.size() + 1 : semi + 1;
+
+        size_t gt = text.rfind('>');
+        if (gt == std::string::npos || gt + 1 >= text.size())
+        {
+            pcm_wave_message("ERROR: No output in '%s' of the chain.\n", text.c_str());
+            return false;
+        }
 
-        if (argc <= 1)
+        W2WBranch branch;
+        branch.file = text.substr(gt + 1);
+        std::string steps = text.substr(0, gt);
+        for (size_t i = 0; i < steps.size(); )
         {
-            show_help();
-            return EXIT_SUCCESS;
+            size_t comma = steps.find(',', i);
+            if (comma == std::string::npos)
+                comma = steps.size();
+            branch.steps.push_back(steps.substr(i, comma - i));
+            i = comma + 1;
         }
 
-        const char *arg1 = NULL;
-        const char *arg2 = NULL;
-        for (int i = 1; i < argc; ++i)
+        for (auto& step : branch.steps)
         {
-            if (argv[i][0] == '-')
+            int type;
+            double value;
+            if (!parse_step(step, type, value))
             {
-                if (strcmp(argv[i], "--help") == 0)
-                {
-                    show_help();
-                    return EXIT_SUCCESS;
-                }
-                if (strcmp(argv[i], "--version") == 0)
-                {
-                    show_version();
-                    return EXIT_SUCCESS;
-                }
-                if (strcmp(argv[i], "--channels") == 0)
-                {
-                    if (i + 1 >= argc)
-                    {
-                        fprintf(stderr, "ERROR: No parameter for '%s'.\n", argv[i]);
-                        return EXIT_FAILURE;
-                    }
-                    ++i;
-                    w2w.channels = (int)strtoul(argv[i], NULL, 0);
-                    if (i >= argc || (w2w.channels != 0 && w2w.channels != 1 && w2w.channels != 2))
-                    {
-                        fprintf(stderr, "ERROR: Invalid parameter '%s'.\n", argv[i]);
-                        return EXIT_FAILURE;
-                    }
-                    continue;
-                }
-                if (strcmp(argv[i], "--rate") == 0)
-                {
-                    if (i + 1 >= argc)
-                    {
-                        fprintf(stderr, "ERROR: No parameter for '%s'.\n", argv[i]);
-                        return EXIT_FAILURE;
-                    }
-                    ++i;
-                    w2w.sampling_rate = (int)strtoul(argv[i], NULL, 0);
-                    if (i >= argc)
-                    {
-                        fprintf(stderr, "ERROR: Invalid parameter '%s'.\n", argv[i]);
-                        return EXIT_FAILURE;
-                    }
-                    continue;
-                }
-                if (strcmp(argv[i], "--mode") == 0)
-                {
-                    if (i + 1 >= argc)
-                    {
-                        fprintf(stderr, "ERROR: No parameter for '%s'.\n", argv[i]);
-                        return EXIT_FAILURE;
-                    }
-                    ++i;
-                    w2w.mode = (int)strtoul(argv[i], NULL, 0);
-                    if (i >= argc || (w2w.mode != 0 && w2w.mode != 8 && w2w.mode != 16))
-                    {
-                        fprintf(stderr, "ERROR: Invalid parameter '%s'.\n", argv[i]);
-                        return EXIT_FAILURE;
-                    }
-                    continue;
-                }
-
-                fprintf(stderr, "ERROR: Invalid argument '%s'.\n", argv[i]);
-                return EXIT_FAILURE;
+                pcm_wave_message("ERROR: Invalid step '%s' of the chain.\n", step.c_str());
+                return false;
             }
-            if (arg1 == NULL)
+        }
+        branches.push_back(branch);
+    } while (pos <= spec.size());
+
+    return true;
+}
+
+// Builds the graph of the branches after the nodes of w2w, and runs it in
+// one pass. Branches with the same first steps share their nodes. If
+// spooled, reader gives the output of the nodes before the gain.
+static bool convert_stream(const char *in, PcmWaveReader& reader,
+                           std::vector<W2WBranch>& branches,
+                           const W2W& w2w, float gain, PcmHash64 *hash, bool spooled)
+{
+    const PcmWave& header = reader.header();
+    PcmGraph graph;
+    int root = hash ? graph.add(new W2WHashNode(hash)) : -1;
+    if (!spooled)
+        root = add_w2w_pre_nodes(graph, w2w, root);
+    root = add_w2w_post_nodes(graph, w2w, gain, root);
+
+    std::vector<PcmWriterNode *> writers;
+    std::vector<std::pair<std::pair<int, int>, std::string> > keys;  // (parent, type), step
+    std::vector<int> ids;
+    for (auto& branch : branches)
+    {
+        int parent = root;
+        int format = w2w.format;
+        bool rifx = w2w.rifx, lossless = w2w.lossless;
+        for (auto& step : branch.steps)
+        {
+            int type;
+            double value;
+            parse_step(step, type, value);
+
+            PcmNode *node = NULL;
+            switch (type)
             {
-                arg1 = argv[i];
+            case W2W_STEP_RIFX:
+                rifx = true;
+                continue;
+            case W2W_STEP_LOSSLESS:
+                lossless = true;
+                continue;
+            case W2W_STEP_FORMAT:
+                format = int(value);
+                type = W2W_STEP_MODE;
+                value = 16;
+                break;
+            case W2W_STEP_MODE:
+                format = 0;
+                break;
             }
-            else if (arg2 == NULL)
+
+            // an equal step after the same node is shared
+            char text[32];
+            snprintf(text, sizeof(text), "%.17g", value);
+            std::pair<std::pair<int, int>, std::string> key(std::make_pair(parent, type),
+                (type == W2W_STEP_FILTER) ? step.substr(step.find('=') + 1) : text);
+            size_t k = std::find(keys.begin(), keys.end(), key) - keys.begin();
+            if (k < keys.size())
             {
-                arg2 = argv[i];
+                parent = ids[k];
+                continue;
             }
-            else
+
+            switch (type)
             {
-                fprintf(stderr, "ERROR: Too many argument.\n");
-                return EXIT_FAILURE;
+            case W2W_STEP_CHANNELS:
+                node = new W2WChannelsNode(int(value));
+                break;
+            case W2W_STEP_MODE:
+                node = new W2WBitsNode(int(value));
+                break;
+            case W2W_STEP_RATE:
+                node = new W2WRateNode(uint32_t(value));
+                break;
+            case W2W_STEP_GAIN:
+                node = new W2WGainNode(float(std::pow(10.0, value / 20)));
+                break;
+            case W2W_STEP_FILTER:
+                node = new W2WFilterNode(key.second.c_str());
+                break;
             }
+            parent = graph.add(node, parent);
+            keys.push_back(key);
+            ids.push_back(parent);
         }
 
-        if (arg1 == NULL)
+        if (rifx && format == PCM_WAVE_FORMAT_IMA_ADPCM)
+        {
+            pcm_wave_message("ERROR: %s: IMA ADPCM cannot be written as RIFX.\n",
+                             branch.file.c_str());
+            return false;
+        }
+        if (rifx && lossless)
+        {
+            pcm_wave_message("ERROR: %s: PCMZ cannot be written as RIFX.\n",
+                             branch.file.c_str());
+            return false;
+        }
+        if (lossless && format == PCM_WAVE_FORMAT_IMA_ADPCM)
+        {
+            pcm_wave_message("ERROR: %s: IMA ADPCM cannot be written as PCMZ.\n",
+                             branch.file.c_str());
+            return false;
+        }
+        if (lossless && (format == PCM_WAVE_FORMAT_MULAW || format == PCM_WAVE_FORMAT_ALAW))
         {
-            fprintf(stderr, "ERROR: No input file.\n");
-            return EXIT_FAILURE;
+            pcm_wave_message("ERROR: %s: G.711 cannot be written as PCMZ.\n",
+                             branch.file.c_str());
+            return false;
         }
+        PcmWriterNode *writer = new PcmWriterNode(branch.fp, branch.file.c_str(),
+                                                  writer_flags(format, rifx, lossless),
+                                                  reader.remaining_units());
+        graph.add(writer, parent);
+        writers.push_back(writer);
+    }
 
-        return wav2wav(arg1, arg2, w2w) ? EXIT_SUCCESS : EXIT_FAILURE;
+    PcmFormat source = { header.num_channels(), header.mode(), uint32_t(header.sample_rate()) };
+    if (!graph.configure(source))
+    {
+        pcm_wave_message("ERROR: %s: Unable to convert.\n", in);
+        return false;
     }
+
+    if (!graph.run(reader, W2W_BLOCK_UNITS))
+        return false;
+
+    for (auto writer : writers)
+    {
+        pcm_wave_show_info(writer->name(), writer->header());
+    }
+    return true;
+}
+
+static bool convert_branches(const char *in, FILE *fin, std::vector<W2WBranch>& branches,
+                             W2W& w2w, uint64_t *input_hash)
+{
+    PcmWaveReader reader;
+
+    if (!reader.open(fin))
+    {
+        pcm_wave_message("ERROR: %s: unable to read\n", in);
+        return false;
+    }
+
+    const PcmWave& header = reader.header();
+    pcm_wave_show_info(in, header);
+
+    uint64_t begin = w2w.start.empty() ? 0 : w2w.start.to_units(header.sample_rate());
+    uint64_t end = w2w.end.to_units(header.sample_rate());
+    if (!w2w.start.empty() || !w2w.end.empty())
+    {
+        if (!reader.seek_range(begin, end))
+        {
+            pcm_wave_message("ERROR: %s: Invalid range.\n", in);
+            return false;
+        }
+    }
+
+    float gain = float(std::pow(10.0, w2w.gain / 20));
+
+    PcmHash64 hash;
+    hash.update_value(uint32_t(header.num_channels()));
+    hash.update_value(uint32_t(header.mode()));
+    hash.update_value(uint32_t(header.sample_rate()));
+    PcmHash64 *hashing = input_hash ? &hash : NULL;
+
+    FILE *spool = NULL;
+    bool ret = true;
+    if (w2w.normalize != W2W_NORMALIZE_NONE)
+    {
+        ret = normalize_pass(in, reader, begin, end, w2w, gain, &spool, hashing);
+        hashing = NULL;     // the frames are read again
+    }
+
+    if (ret)
+        ret = convert_stream(in, reader, branches, w2w, gain, hashing, spool != NULL);
+
+    if (spool)
+        fclose(spool);
+
+    if (ret && input_hash)
+        *input_hash = hash.digest();
+
+    if (ret)
+    {
+        for (auto& branch : branches)
+        {
+            pcm_wave_message("'%s' --> '%s' (OK)\n", in, branch.file.c_str());
+        }
+    }
+    return ret;
+}
+
+// *input_hash, if not NULL, receives the hash of the input frames with their
+// format. They are hashed as they are read for the conversion.
+bool wav2wav_fp(const char *in, const char *out, FILE *fin, FILE *fout, W2W& w2w,
+                uint64_t *input_hash)
+{
+    std::vector<W2WBranch> branches(1);
+    branches[0].file = out;
+    branches[0].fp = fout;
+    return convert_branches(in, fin, branches, w2w, input_hash);
+}
+
+// runs the branches of chain after the options of w2w, in one pass
+bool wav2wav_chain(const char *wav_file, const char *chain, W2W& w2w)
+{
+    std::vector<W2WBranch> branches;
+    if (!parse_chain(chain, branches))
+        return false;
+
+    FILE *fin = pcm_wave_fopen(wav_file, "rb");
+    if (!fin)
+    {
+        pcm_wave_message("ERROR: Unable to open file '%s'.\n", wav_file);
+        return false;
+    }
+
+    bool ret = true;
+    for (auto& branch : branches)
+    {
+        branch.fp = pcm_wave_fopen(branch.file.c_str(), "wb");
+        if (!branch.fp)
+        {
+            pcm_wave_message("ERROR: Unable to open file '%s'.\n", branch.file.c_str());
+            ret = false;
+            break;
+        }
+    }
+
+    if (ret)
+        ret = convert_branches(wav_file, fin, branches, w2w, NULL);
+
+    for (auto& branch : branches)
+    {
+        if (branch.fp)
+            pcm_wave_fclose(branch.fp);
+    }
+    pcm_wave_fclose(fin);
+    return ret;
+}
+
+// The conversion cache (--cache DIR). An entry DIR/<input>-<options>.wav is
+// named by the hash of the input frames with their format, which
+// wav2wav_fp() computes while converting, and by the hash of the options.
+// DIR/<identity>.id keeps the input hash of a file by its device, inode,
+// size, modification time and range, so a rerun finds the entry without
+// reading the input. An output is always a file of its own (a reflink or a
+// copy), so writing to it later leaves the read-only entry alone.
+
+// the contents of file, or a mark if it cannot be read
+static void cache_hash_file(PcmHash64& hash, const char *file)
+{
+    FILE *fp = fopen(file, "rb");
+    if (!fp)
+    {
+        hash.update_value(uint8_t(0));
+        return;
+    }
+    std::vector<char> buffer(64 * 1024);
+    size_t n;
+    while ((n = fread(&buffer[0], 1, buffer.size(), fp)) > 0)
+        hash.update(&buffer[0], n);
+    fclose(fp);
+    hash.update_value(uint8_t(1));
+}
+
+static uint64_t cache_options_hash(const W2W& w2w)
+{
+    PcmHash64 hash;
+    hash.update_value(uint32_t(W2W_CACHE_VERSION));
+    hash.update_value(int32_t(w2w.channels));
+    hash.update_value(int32_t(w2w.mode));
+    hash.update_value(int32_t(w2w.format));
+    hash.update_value(int32_t(w2w.sampling_rate));
+    hash.update_value(w2w.gain);
+    hash.update_value(int32_t(w2w.normalize));
+    hash.update_value(uint8_t(w2w.rifx));
+    hash.update_value(uint8_t(w2w.lossless));
+    if (w2w.filter)
+    {
+        hash.update(w2w.filter, strlen(w2w.filter) + 1);
+        // the spec names the taps files; their taps are part of the options
+        std::vector<std::string> files;
+        PcmFilterChain::files(w2w.filter, files);
+        for (auto& file : files)
+            cache_hash_file(hash, file.c_str());
+    }
+    return hash.digest();
+}
+
+static bool cache_file_identity(const char *file, const W2W& w2w, uint64_t& identity)
+{
+    struct stat st;
+    if (stat(file, &st) != 0 || (st.st_mode & S_IFMT) != S_IFREG)
+        return false;
+
+    PcmHash64 hash;
+    hash.update_value(uint64_t(st.st_dev));
+    hash.update_value(uint64_t(st.st_ino));
+    hash.update_value(uint64_t(st.st_size));
+    hash.update_value(int64_t(st.st_mtime));
+#ifdef __linux__
+    hash.update_value(int64_t(st.st_mtim.tv_nsec));
+#endif
+#ifdef _WIN32
+    hash.update(file, strlen(file));    // no inode numbers
+#endif
+    hash.update_value(w2w.start.value);
+    hash.update_value(uint8_t(w2w.start.frames));
+    hash.update_value(w2w.end.value);
+    hash.update_value(uint8_t(w2w.end.frames));
+    identity = hash.digest();
+    return true;
+}
+
+static std::string cache_path(const char *dir, uint64_t key1, const uint64_t *key2)
+{
+    char name[64];
+    if (key2)
+        sprintf(name, "/%016llx-%016llx.wav", (unsigned long long)key1, (unsigned long long)*key2);
+    else
+        sprintf(name, "/%016llx.id", (unsigned long long)key1);
+    return std::string(dir) + name;
+}
+
+static std::string cache_temp_path(const std::string& path)
+{
+#ifdef _WIN32
+    return path + "." + std::to_string(_getpid()) + ".tmp";
+#else
+    return path + "." + std::to_string(getpid()) + ".tmp";
+#endif
+}
+
+// Copies file from to file to, as a reflink (a copy-on-write clone) where
+// the file system supports it, else byte by byte.
+static bool cache_place_file(const char *from, const char *to)
+{
+    remove(to);     // never write through an old link
+#ifdef __linux__
+    int fd_in = open(from, O_RDONLY);
+    if (fd_in < 0)
+        return false;
+    int fd_out = open(to, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    bool cloned = (fd_out >= 0 && ioctl(fd_out, FICLONE, fd_in) == 0);
+    if (fd_out >= 0)
+        close(fd_out);
+    close(fd_in);
+    if (cloned)
+        return true;
 #endif
+
+    FILE *fin = fopen(from, "rb");
+    if (!fin)
+        return false;
+    FILE *fout = fopen(to, "wb");
+    if (!fout)
+    {
+        fclose(fin);
+        return false;
+    }
+    std::vector<char> buffer(1024 * 1024);
+    bool ok = true;
+    size_t n;
+    while ((n = fread(&buffer[0], 1, buffer.size(), fin)) > 0)
+    {
+        if (fwrite(&buffer[0], 1, n, fout) != n)
+        {
+            ok = false;
+            break;
+        }
+    }
+    if (ferror(fin))
+        ok = false;
+    fclose(fin);
+    if (fclose(fout) != 0)
+        ok = false;
+    if (!ok)
+        remove(to);
+    return ok;
+}
+
+// places the cached output of an identified input at out
+static bool cache_lookup(const W2W& w2w, uint64_t identity, const char *out)
+{
+    FILE *fp = fopen(cache_path(w2w.cache, identity, NULL).c_str(), "r");
+    if (!fp)
+        return false;
+    unsigned long long input;
+    bool found = (fscanf(fp, "%llx", &input) == 1);
+    fclose(fp);
+    if (!found)
+        return false;
+
+    uint64_t options = cache_options_hash(w2w);
+    return cache_place_file(cache_path(w2w.cache, input, &options).c_str(), out);
+}
+
+static void cache_store(const W2W& w2w, const uint64_t *identity, uint64_t input,
+                        const char *out)
+{
+    uint64_t options = cache_options_hash(w2w);
+    std::string entry = cache_path(w2w.cache, input, &options);
+    std::string temp = cache_temp_path(entry);
+
+    bool ok = cache_place_file(out, temp.c_str());
+    if (ok)
+    {
+    #ifdef _WIN32
+        _chmod(temp.c_str(), _S_IREAD);
+    #else
+        chmod(temp.c_str(), S_IRUSR | S_IRGRP | S_IROTH);
+    #endif
+        remove(entry.c_str());
+        ok = (rename(temp.c_str(), entry.c_str()) == 0);
+    }
+
+    if (ok && identity)
+    {
+        std::string id = cache_path(w2w.cache, *identity, NULL);
+        temp = cache_temp_path(id);
+        FILE *fp = fopen(temp.c_str(), "w");
+        ok = (fp != NULL);
+        if (fp)
+        {
+            fprintf(fp, "%016llx\n", (unsigned long long)input);
+            if (fclose(fp) != 0)
+                ok = false;
+        }
+        remove(id.c_str());
+        ok = ok && rename(temp.c_str(), id.c_str()) == 0;
+    }
+
+    if (!ok)
+    {
+        remove(temp.c_str());
+        pcm_wave_message("WARNING: %s: Unable to store in the cache.\n", w2w.cache);
+    }
+}
+
+bool wav2wav(const char *file1, const char *file2, W2W& w2w)
+{
+    FILE *fin, *fout;
+
+    assert(file1);
+    fin = pcm_wave_fopen(file1, "rb");
+    if (!fin)
+    {
+        pcm_wave_message("ERROR: Unable to open file '%s'.\n", file1);
+        return false;
+    }
+
+    char out_name[256];
+    if (!file2)
+    {
+        if (strcmp(file1, "-") == 0)
+        {
+            file2 = "-";
+        }
+        else
+        {
+            strcpy(out_name, file1);
+            strcat(out_name, ".wav");
+            file2 = out_name;
+        }
+    }
+
+    // the cache needs files on both sides
+    bool cached = w2w.cache && strcmp(file1, "-") != 0 && strcmp(file2, "-") != 0;
+    uint64_t identity = 0;
+    bool identified = false;
+    if (cached)
+    {
+    #ifdef _WIN32
+        _mkdir(w2w.cache);
+    #else
+        mkdir(w2w.cache, 0777);
+    #endif
+        identified = cache_file_identity(file1, w2w, identity);
+        if (identified && cache_lookup(w2w, identity, file2))
+        {
+            pcm_wave_fclose(fin);
+            pcm_wave_message("'%s' --> '%s' (cached)\n", file1, file2);
+            return true;
+        }
+        remove(file2);  // may be a link to an entry of an older version
+    }
+
+    fout = pcm_wave_fopen(file2, "wb");
+    if (!fout)
+    {
+        pcm_wave_message("ERROR: Unable to open file '%s'.\n", file2);
+        pcm_wave_fclose(fin);
+        return false;
+    }
+
+    uint64_t input = 0;
+    bool ret = wav2wav_fp(file1, file2, fin, fout, w2w, cached ? &input : NULL);
+
+    pcm_wave_fclose(fout);
+    pcm_wave_fclose(fin);
+
+    if (ret && cached)
+        cache_store(w2w, identified ? &identity : NULL, input, file2);
+
+    return ret;
+}
+
+// relabels the sampling rate by rewriting the header only
+bool wav2wav_in_place(const char *wav_file, const W2W& w2w)
+{
+    if (w2w.channels || w2w.mode || w2w.format || w2w.gain != 0 || w2w.rifx || w2w.lossless ||
+        w2w.filter ||
+        w2w.normalize != W2W_NORMALIZE_NONE || !w2w.start.empty() || !w2w.end.empty())
+    {
+        pcm_wave_message("ERROR: Only '--rate' can be changed in place.\n");
+        return false;
+    }
+
+    FILE *fp = fopen(wav_file, "r+b");
+    if (!fp)
+    {
+        pcm_wave_message("ERROR: Unable to open file '%s'.\n", wav_file);
+        return false;
+    }
+
+    PcmWave header;
+    if (!header.read_header_from_fp(fp))
+    {
+        pcm_wave_message("ERROR: %s: unable to read\n", wav_file);
+        fclose(fp);
+        return false;
+    }
+    pcm_wave_show_info(wav_file, header);
+
+    if (w2w.sampling_rate)
+    {
+        uint64_t size = header.data_size();
+        header.sample_rate(w2w.sampling_rate);
+        header.update_info();   // ByteRate
+        header.data_size(size);
+    }
+
+    bool ret = header.rewrite_format_in_fp(fp);
+    if (fclose(fp) != 0)
+        ret = false;
+    if (!ret)
+    {
+        pcm_wave_message("ERROR: %s: Unable to write.\n", wav_file);
+        return false;
+    }
+
+    pcm_wave_show_info(wav_file, header);
+    pcm_wave_message("'%s' (OK)\n", wav_file);
+    return true;
+}
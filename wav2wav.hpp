@@ -2,19 +2,108 @@
 #define WAV2WAV_HPP_
 
 #include <cstdio>
+#include "PcmGraph.hpp"
+#include "PcmFilter.hpp"
+
+#define W2W_BLOCK_UNITS     (64 * 1024)     // frames per streaming block
+#define W2W_SCAN_UNITS      (1024 * 1024)   // frames per block of the level scan
+#define W2W_GRAIN           (256 * 1024)    // samples per thread task
+#define W2W_FRAME_GRAIN     (256 * 1024)    // frames per channel converter task
+#define W2W_CACHE_VERSION   2               // bump when the output of a conversion changes
+
+#define W2W_NORMALIZE_NONE  0
+#define W2W_NORMALIZE_PEAK  1   // peak to 0 dBFS
+#define W2W_NORMALIZE_RMS   2   // RMS to W2W_RMS_TARGET_DB
+#define W2W_RMS_TARGET_DB   (-20.0)
 
 struct W2W
 {
     int channels = 0;       // default if zero
     int mode = 0;           // default if zero
+    int format = 0;         // PCM_WAVE_FORMAT_* of the output; PCM if zero
     int sampling_rate = 0;  // default if zero
+    PcmWaveTime start;      // from the beginning if empty
+    PcmWaveTime end;        // to the end if empty
+    double gain = 0;        // in dB
+    int normalize = W2W_NORMALIZE_NONE;
+    bool rifx = false;      // write big-endian "RIFX"
+    bool lossless = false;  // write compressed "PCMZ"
+    const char *cache = NULL;   // directory of the conversion cache if not NULL
+    const char *filter = NULL;  // spec of a PcmFilterChain if not NULL
+};
+
+// the operations of wav2wav as nodes of a PcmGraph
+
+class W2WChannelsNode : public PcmNode     // 1 <--> 2 channels
+{
+public:
+    explicit W2WChannelsNode(int channels) : m_channels(channels) { }
+    bool configure(const PcmFormat& in, PcmFormat& out);
+    PcmWave *process(PcmWave& in, PcmWave& out);
+protected:
+    int m_channels;
+};
+
+class W2WBitsNode : public PcmNode         // 8 <--> 16 bits
+{
+public:
+    explicit W2WBitsNode(int bits) : m_bits(bits) { }
+    bool configure(const PcmFormat& in, PcmFormat& out);
+    PcmWave *process(PcmWave& in, PcmWave& out);
+protected:
+    int m_bits;
+};
+
+class W2WRateNode : public PcmNode         // relabels the sampling rate
+{
+public:
+    explicit W2WRateNode(uint32_t rate) : m_rate(rate) { }
+    bool configure(const PcmFormat& in, PcmFormat& out);
+    PcmWave *process(PcmWave& in, PcmWave& out);
+protected:
+    uint32_t m_rate;
+};
+
+class W2WGainNode : public PcmNode         // multiplies by a factor, saturating
+{
+public:
+    explicit W2WGainNode(float gain) : m_gain(gain) { }
+    bool configure(const PcmFormat& in, PcmFormat& out);
+    PcmWave *process(PcmWave& in, PcmWave& out);
+protected:
+    float m_gain;
+};
+
+class W2WFilterNode : public PcmNode       // a PcmFilterChain per channel
+{
+public:
+    explicit W2WFilterNode(const char *spec) : m_spec(spec) { }
+    bool configure(const PcmFormat& in, PcmFormat& out);
+    PcmWave *process(PcmWave& in, PcmWave& out);
+    PcmWave *drain(PcmWave& out);
+protected:
+    std::string m_spec;
+    PcmFormat m_format;
+    std::vector<PcmFilterChain> m_chains;
+    std::vector<std::vector<float> > m_planes;
+    std::vector<float> m_mixed;
+    size_t m_delay;     // frames of the filters' delay
+    size_t m_skip;      // frames of the delay still to drop
+    bool filter(PcmWave& in, PcmWave& out);
 };
 
-bool mono_to_stereo(const PcmWave& wave1, PcmWave& wave2);
-bool stereo_to_mono(const PcmWave& wave1, PcmWave& wave2);
-bool mode_8bit_to_16bit(const PcmWave& wave1, PcmWave& wave2);
-bool mode_16bit_to_8bit(const PcmWave& wave1, PcmWave& wave2);
-bool wav2wav_fp(const char *in, const char *out, FILE *fin, FILE *fout, W2W& w2w);
+bool mono_to_stereo(const PcmWaveView& wave1, PcmWave& wave2);
+bool stereo_to_mono(const PcmWaveView& wave1, PcmWave& wave2);
+bool mode_8bit_to_16bit(const PcmWaveView& wave1, PcmWave& wave2);
+bool mode_16bit_to_8bit(const PcmWaveView& wave1, PcmWave& wave2);
+bool convert_wave(PcmWave& wave1, PcmWave& wave3, const W2W& w2w);
+bool convert_wave(const PcmWaveView& wave1, PcmWave& wave3, const W2W& w2w);
+bool scan_level(const PcmWave& wave, PcmLevel& level);
+bool apply_gain(PcmWave& wave, float gain);
+bool wav2wav_fp(const char *in, const char *out, FILE *fin, FILE *fout, W2W& w2w,
+                uint64_t *input_hash = NULL);
 bool wav2wav(const char *txt_file, const char *wav_file, W2W& w2w);
+bool wav2wav_in_place(const char *wav_file, const W2W& w2w);
+bool wav2wav_chain(const char *wav_file, const char *chain, W2W& w2w);
 
 #endif  // ndef WAV2WAV_HPP_
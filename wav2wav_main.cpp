@@ -0,0 +1,305 @@
+#include "PcmWave.hpp"
+#include "wav2wav.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static void show_help(void)
+{
+    printf("wav2wav --- Converts a wave file to another wave file\n");
+    printf("Usage: wav2wav [options] wave-file-1.wav [wave-file-2.wav]\n");
+    printf("Use '-' for stdin/stdout.\n");
+    printf("Options:\n");
+    printf("--help          Show this help.\n");
+    printf("--version       Show version info.\n");
+    printf("--channels XXX  Specify the number of channels.\n");
+    printf("--rate XXX      Specify sampling rate.\n");
+    printf("--mode XXX      Specify bits per sample (8 or 16), or 'ima', 'ulaw', 'alaw'.\n");
+    printf("--gain DB       Change the level by DB decibels (saturating).\n");
+    printf("--normalize X   Normalize 'peak' to 0 dBFS or 'rms' to -20 dBFS.\n");
+    printf("--filter SPEC   Filter with FILTER+FILTER+..., frequencies in Hz:\n");
+    printf("                lowpass:F[:TAPS], highpass:F[:TAPS], bandpass:F1:F2[:TAPS]\n");
+    printf("                (linear-phase FIR, delay made up for; TAPS odd, 511),\n");
+    printf("                iir-lowpass:F[:ORDER], iir-highpass:F[:ORDER],\n");
+    printf("                iir-bandpass:F1:F2[:ORDER] (Butterworth; ORDER even, 4),\n");
+    printf("                dcblock[:F] (10 Hz), or fir:FILE (taps in a text file).\n");
+    printf("--start TIME    Start position in seconds, or frames with 'f' suffix.\n");
+    printf("--end TIME      End position in seconds, or frames with 'f' suffix.\n");
+    printf("--rifx          Write a big-endian RIFX file.\n");
+    printf("--lossless      Write a compressed PCMZ file (read back automatically).\n");
+    printf("--in-place      Relabel '--rate' by rewriting the header of the file only.\n");
+    printf("--cache DIR     Reuse the outputs of earlier conversions kept in DIR.\n");
+    printf("--chain SPEC    Write several outputs in one pass, after the other options.\n");
+    printf("                SPEC is 'STEP,STEP,...>FILE;STEP,...>FILE;...' with the steps\n");
+    printf("                channels=N, mode=X, rate=HZ, gain=DB, filter=SPEC, rifx\n");
+    printf("                and lossless.\n");
+    printf("                Branches with the same first steps share them.\n");
+}
+
+static void show_version(void)
+{
+    printf("wav2wav version 0.12 by katahiromz\n");
+}
+
+int main(int argc, char **argv)
+{
+    pcm_wave_messages() = stderr;    // the library is quiet otherwise
+
+    W2W w2w;
+    bool in_place = false;
+    const char *chain = NULL;
+
+    if (argc <= 1)
+    {
+        show_help();
+        return EXIT_SUCCESS;
+    }
+
+    const char *arg1 = NULL;
+    const char *arg2 = NULL;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (argv[i][0] == '-' && argv[i][1] != 0)
+        {
+            if (strcmp(argv[i], "--help") == 0)
+            {
+                show_help();
+                return EXIT_SUCCESS;
+            }
+            if (strcmp(argv[i], "--version") == 0)
+            {
+                show_version();
+                return EXIT_SUCCESS;
+            }
+            if (strcmp(argv[i], "--channels") == 0)
+            {
+                if (i + 1 >= argc)
+                {
+                    fprintf(stderr, "ERROR: No parameter for '%s'.\n", argv[i]);
+                    return EXIT_FAILURE;
+                }
+                ++i;
+                w2w.channels = (int)strtoul(argv[i], NULL, 0);
+                if (i >= argc || (w2w.channels != 0 && w2w.channels != 1 && w2w.channels != 2))
+                {
+                    fprintf(stderr, "ERROR: Invalid parameter '%s'.\n", argv[i]);
+                    return EXIT_FAILURE;
+                }
+                continue;
+            }
+            if (strcmp(argv[i], "--rate") == 0)
+            {
+                if (i + 1 >= argc)
+                {
+                    fprintf(stderr, "ERROR: No parameter for '%s'.\n", argv[i]);
+                    return EXIT_FAILURE;
+                }
+                ++i;
+                w2w.sampling_rate = (int)strtoul(argv[i], NULL, 0);
+                if (i >= argc)
+                {
+                    fprintf(stderr, "ERROR: Invalid parameter '%s'.\n", argv[i]);
+                    return EXIT_FAILURE;
+                }
+                continue;
+            }
+            if (strcmp(argv[i], "--mode") == 0)
+            {
+                if (i + 1 >= argc)
+                {
+                    fprintf(stderr, "ERROR: No parameter for '%s'.\n", argv[i]);
+                    return EXIT_FAILURE;
+                }
+                ++i;
+                // the coded formats take 16-bit samples
+                w2w.format = 0;
+                if (strcmp(argv[i], "ima") == 0)
+                    w2w.format = PCM_WAVE_FORMAT_IMA_ADPCM;
+                else if (strcmp(argv[i], "ulaw") == 0)
+                    w2w.format = PCM_WAVE_FORMAT_MULAW;
+                else if (strcmp(argv[i], "alaw") == 0)
+                    w2w.format = PCM_WAVE_FORMAT_ALAW;
+                if (w2w.format)
+                {
+                    w2w.mode = 16;
+                    continue;
+                }
+                w2w.mode = (int)strtoul(argv[i], NULL, 0);
+                if (i >= argc || (w2w.mode != 0 && w2w.mode != 8 && w2w.mode != 16))
+                {
+                    fprintf(stderr, "ERROR: Invalid parameter '%s'.\n", argv[i]);
+                    return EXIT_FAILURE;
+                }
+                continue;
+            }
+
+            if (strcmp(argv[i], "--gain") == 0)
+            {
+                if (i + 1 >= argc)
+                {
+                    fprintf(stderr, "ERROR: No parameter for '%s'.\n", argv[i]);
+                    return EXIT_FAILURE;
+                }
+                ++i;
+                char *endptr;
+                w2w.gain = strtod(argv[i], &endptr);
+                if (*endptr != 0)
+                {
+                    fprintf(stderr, "ERROR: Invalid parameter '%s'.\n", argv[i]);
+                    return EXIT_FAILURE;
+                }
+                continue;
+            }
+            if (strcmp(argv[i], "--normalize") == 0)
+            {
+                if (i + 1 >= argc)
+                {
+                    fprintf(stderr, "ERROR: No parameter for '%s'.\n", argv[i]);
+                    return EXIT_FAILURE;
+                }
+                ++i;
+                if (strcmp(argv[i], "peak") == 0)
+                    w2w.normalize = W2W_NORMALIZE_PEAK;
+                else if (strcmp(argv[i], "rms") == 0)
+                    w2w.normalize = W2W_NORMALIZE_RMS;
+                else
+                {
+                    fprintf(stderr, "ERROR: Invalid parameter '%s'.\n", argv[i]);
+                    return EXIT_FAILURE;
+                }
+                continue;
+            }
+            if (strcmp(argv[i], "--rifx") == 0)
+            {
+                w2w.rifx = true;
+                continue;
+            }
+            if (strcmp(argv[i], "--lossless") == 0)
+            {
+                w2w.lossless = true;
+                continue;
+            }
+            if (strcmp(argv[i], "--chain") == 0)
+            {
+                if (i + 1 >= argc)
+                {
+                    fprintf(stderr, "ERROR: No parameter for '%s'.\n", argv[i]);
+                    return EXIT_FAILURE;
+                }
+                ++i;
+                chain = argv[i];
+                continue;
+            }
+            if (strcmp(argv[i], "--filter") == 0)
+            {
+                if (i + 1 >= argc)
+                {
+                    fprintf(stderr, "ERROR: No parameter for '%s'.\n", argv[i]);
+                    return EXIT_FAILURE;
+                }
+                ++i;
+                w2w.filter = argv[i];
+                continue;
+            }
+            if (strcmp(argv[i], "--cache") == 0)
+            {
+                if (i + 1 >= argc)
+                {
+                    fprintf(stderr, "ERROR: No parameter for '%s'.\n", argv[i]);
+                    return EXIT_FAILURE;
+                }
+                ++i;
+                w2w.cache = argv[i];
+                continue;
+            }
+            if (strcmp(argv[i], "--in-place") == 0)
+            {
+                in_place = true;
+                continue;
+            }
+            if (strcmp(argv[i], "--start") == 0 || strcmp(argv[i], "--end") == 0)
+            {
+                if (i + 1 >= argc)
+                {
+                    fprintf(stderr, "ERROR: No parameter for '%s'.\n", argv[i]);
+                    return EXIT_FAILURE;
+                }
+                PcmWaveTime& time = (argv[i][2] == 's') ? w2w.start : w2w.end;
+                ++i;
+                if (!time.parse(argv[i]))
+                {
+                    fprintf(stderr, "ERROR: Invalid parameter '%s'.\n", argv[i]);
+                    return EXIT_FAILURE;
+                }
+                continue;
+            }
+
+            fprintf(stderr, "ERROR: Invalid argument '%s'.\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+        if (arg1 == NULL)
+        {
+            arg1 = argv[i];
+        }
+        else if (arg2 == NULL)
+        {
+            arg2 = argv[i];
+        }
+        else
+        {
+            fprintf(stderr, "ERROR: Too many argument.\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (arg1 == NULL)
+    {
+        fprintf(stderr, "ERROR: No input file.\n");
+        return EXIT_FAILURE;
+    }
+
+    if (w2w.rifx && w2w.format == PCM_WAVE_FORMAT_IMA_ADPCM)
+    {
+        fprintf(stderr, "ERROR: '--rifx' cannot be used with '--mode ima'.\n");
+        return EXIT_FAILURE;
+    }
+    if (w2w.rifx && w2w.lossless)
+    {
+        fprintf(stderr, "ERROR: '--rifx' cannot be used with '--lossless'.\n");
+        return EXIT_FAILURE;
+    }
+    if (w2w.lossless && w2w.format == PCM_WAVE_FORMAT_IMA_ADPCM)
+    {
+        fprintf(stderr, "ERROR: '--lossless' cannot be used with '--mode ima'.\n");
+        return EXIT_FAILURE;
+    }
+    if (w2w.lossless &&
+        (w2w.format == PCM_WAVE_FORMAT_MULAW || w2w.format == PCM_WAVE_FORMAT_ALAW))
+    {
+        fprintf(stderr, "ERROR: '--lossless' cannot be used with '--mode %s'.\n",
+                (w2w.format == PCM_WAVE_FORMAT_MULAW) ? "ulaw" : "alaw");
+        return EXIT_FAILURE;
+    }
+
+    if (chain)
+    {
+        if (arg2 != NULL || in_place)
+        {
+            fprintf(stderr, "ERROR: '--chain' takes one input file.\n");
+            return EXIT_FAILURE;
+        }
+        return wav2wav_chain(arg1, chain, w2w) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (in_place)
+    {
+        if (arg2 != NULL || strcmp(arg1, "-") == 0)
+        {
+            fprintf(stderr, "ERROR: '--in-place' takes one file.\n");
+            return EXIT_FAILURE;
+        }
+        return wav2wav_in_place(arg1, w2w) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    return wav2wav(arg1, arg2, w2w) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
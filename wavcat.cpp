@@ -0,0 +1,141 @@
+#include "PcmWave.hpp"
+#include "PcmSimd.hpp"
+#include "wav2wav.hpp"
+#include "wavcat.hpp"
+#include <cstdio>
+#include <cstdlib>
+
+bool wavcat_fp(const char *out, FILE *fout, FILE **fins, const WCAT& wcat)
+{
+    const size_t count = wcat.inputs.size();
+    std::vector<PcmWaveReader> readers(count);
+
+    W2W w2w;
+    w2w.channels = wcat.channels;
+    w2w.mode = wcat.mode;
+    uint32_t rate = 0;
+    uint64_t total = 0;     // the output data size if known
+    for (size_t i = 0; i < count; ++i)
+    {
+        const char *name = wcat.inputs[i];
+        if (!readers[i].open(fins[i]))
+        {
+            pcm_wave_message("ERROR: %s: unable to read\n", name);
+            return false;
+        }
+
+        const PcmWave& header = readers[i].header();
+        pcm_wave_show_info(name, header);
+        if ((!header.mode_8bit() && !header.mode_16bit()) || header.num_channels() > 2)
+        {
+            pcm_wave_message("ERROR: %s: Unable to convert.\n", name);
+            return false;
+        }
+        if (rate && rate != header.sample_rate())
+        {
+            pcm_wave_message("ERROR: %s: Sampling rates differ (%lu Hz and %lu Hz).\n",
+                             name, (unsigned long)rate, (unsigned long)header.sample_rate());
+            return false;
+        }
+        rate = header.sample_rate();
+
+        if (!w2w.channels)
+            w2w.channels = header.num_channels();
+        if (!w2w.mode)
+            w2w.mode = header.mode();
+
+        uint64_t units = readers[i].remaining_units();
+        if (units == PCM_WAVE_SIZE_UNKNOWN || total == PCM_WAVE_SIZE_UNKNOWN)
+            total = PCM_WAVE_SIZE_UNKNOWN;
+        else
+            total += units * (w2w.channels * w2w.mode / 8);
+    }
+
+    PcmWaveWriter writer;
+    if (!writer.open(fout, w2w.channels, w2w.mode, rate, total))
+    {
+        pcm_wave_message("ERROR: %s: Unable to write.\n", out);
+        return false;
+    }
+
+    PcmWave wave1, wave2;
+    for (size_t i = 0; i < count; ++i)
+    {
+        const char *name = wcat.inputs[i];
+        PcmWaveReader& reader = readers[i];
+        const PcmWave& header = reader.header();
+
+        if (header.num_channels() == w2w.channels && header.mode() == w2w.mode)
+        {
+            // the same format; the payload is copied as is
+            if (!writer.copy_from(reader))
+            {
+                pcm_wave_message("ERROR: %s: Unable to write.\n", out);
+                return false;
+            }
+            continue;
+        }
+
+        while (reader.read(wave1, WCAT_BLOCK_UNITS) > 0)
+        {
+            if (!convert_wave(wave1, wave2, w2w))
+            {
+                pcm_wave_message("ERROR: %s: Unable to convert.\n", name);
+                return false;
+            }
+            if (!writer.write(wave2))
+            {
+                pcm_wave_message("ERROR: %s: Unable to write.\n", out);
+                return false;
+            }
+        }
+    }
+
+    if (!writer.close())
+    {
+        pcm_wave_message("ERROR: %s: Unable to write.\n", out);
+        return false;
+    }
+
+    pcm_wave_show_info(out, writer.header());
+    return true;
+}
+
+bool wavcat(const char *out_file, const WCAT& wcat)
+{
+    std::vector<FILE *> fins(wcat.inputs.size(), NULL);
+    FILE *fout = NULL;
+    bool ret = false;
+
+    for (size_t i = 0; i < wcat.inputs.size(); ++i)
+    {
+        const char *file = wcat.inputs[i];
+        fins[i] = pcm_wave_fopen(file, "rb");
+        if (!fins[i])
+        {
+            pcm_wave_message("ERROR: Unable to open file '%s'.\n", file);
+            goto cleanup;
+        }
+    }
+
+    fout = pcm_wave_fopen(out_file, "wb");
+    if (!fout)
+    {
+        pcm_wave_message("ERROR: Unable to open file '%s'.\n", out_file);
+        goto cleanup;
+    }
+
+    ret = wavcat_fp(out_file, fout, &fins[0], wcat);
+    if (ret)
+        pcm_wave_message("--> '%s' (OK)\n", out_file);
+
+cleanup:
+    if (fout)
+        pcm_wave_fclose(fout);
+    for (auto fp : fins)
+    {
+        if (fp)
+            pcm_wave_fclose(fp);
+    }
+    return ret;
+}
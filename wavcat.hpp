@@ -0,0 +1,19 @@
+#ifndef WAVCAT_HPP_
+#define WAVCAT_HPP_
+
+#include <cstdio>
+#include <vector>
+
+#define WCAT_BLOCK_UNITS    (64 * 1024)     // frames per block to convert
+
+struct WCAT
+{
+    int channels = 0;       // same as the first input if zero
+    int mode = 0;           // same as the first input if zero
+    std::vector<const char *> inputs;
+};
+
+bool wavcat_fp(const char *out, FILE *fout, FILE **fins, const WCAT& wcat);
+bool wavcat(const char *out_file, const WCAT& wcat);
+
+#endif  // ndef WAVCAT_HPP_
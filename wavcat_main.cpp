@@ -0,0 +1,104 @@
+#include "PcmWave.hpp"
+#include "wavcat.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static void show_help(void)
+{
+    printf("wavcat --- Concatenates wave files\n");
+    printf("Usage: wavcat [options] -o output.wav input.wav ...\n");
+    printf("Use '-' for stdin/stdout.\n");
+    printf("Options:\n");
+    printf("--help          Show this help.\n");
+    printf("--version       Show version info.\n");
+    printf("-o FILE         Specify the output file.\n");
+    printf("--channels XXX  Specify the number of channels.\n");
+    printf("--mode XXX      Specify bits per sample.\n");
+}
+
+static void show_version(void)
+{
+    printf("wavcat version 0.1 by katahiromz\n");
+}
+
+int main(int argc, char **argv)
+{
+    pcm_wave_messages() = stderr;    // the library is quiet otherwise
+
+    WCAT wcat;
+    const char *out_file = NULL;
+
+    if (argc <= 1)
+    {
+        show_help();
+        return EXIT_SUCCESS;
+    }
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (argv[i][0] == '-' && argv[i][1] != 0)
+        {
+            if (strcmp(argv[i], "--help") == 0)
+            {
+                show_help();
+                return EXIT_SUCCESS;
+            }
+            if (strcmp(argv[i], "--version") == 0)
+            {
+                show_version();
+                return EXIT_SUCCESS;
+            }
+            if (i + 1 >= argc)
+            {
+                fprintf(stderr, "ERROR: No parameter for '%s'.\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+            if (strcmp(argv[i], "-o") == 0)
+            {
+                out_file = argv[++i];
+                continue;
+            }
+            if (strcmp(argv[i], "--channels") == 0)
+            {
+                ++i;
+                wcat.channels = (int)strtoul(argv[i], NULL, 0);
+                if (wcat.channels != 1 && wcat.channels != 2)
+                {
+                    fprintf(stderr, "ERROR: Invalid parameter '%s'.\n", argv[i]);
+                    return EXIT_FAILURE;
+                }
+                continue;
+            }
+            if (strcmp(argv[i], "--mode") == 0)
+            {
+                ++i;
+                wcat.mode = (int)strtoul(argv[i], NULL, 0);
+                if (wcat.mode != 8 && wcat.mode != 16)
+                {
+                    fprintf(stderr, "ERROR: Invalid parameter '%s'.\n", argv[i]);
+                    return EXIT_FAILURE;
+                }
+                continue;
+            }
+
+            fprintf(stderr, "ERROR: Invalid argument '%s'.\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+
+        wcat.inputs.push_back(argv[i]);
+    }
+
+    if (wcat.inputs.empty())
+    {
+        fprintf(stderr, "ERROR: No input file.\n");
+        return EXIT_FAILURE;
+    }
+    if (out_file == NULL)
+    {
+        fprintf(stderr, "ERROR: No output file.\n");
+        return EXIT_FAILURE;
+    }
+
+    return wavcat(out_file, wcat) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
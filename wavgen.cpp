@@ -0,0 +1,221 @@
+#include "PcmWave.hpp"
+#include "PcmSimd.hpp"
+#include "PcmParallel.hpp"
+#include "wavgen.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <chrono>
+
+bool WGEN_BURST::parse(const char *str)
+{
+    const char *comma = strchr(str, ',');
+    if (!comma)
+        return false;
+    std::string first(str, comma);
+    return period.parse(first.c_str()) && length.parse(comma + 1) &&
+           period.value > 0;
+}
+
+// The generator. Every sample is a function of its frame index and the
+// seed only, so the blocks can be made in any order on any thread.
+class WavGen
+{
+public:
+    WavGen(const WGEN& wgen, uint64_t total);
+
+    // count frames from the frame begin, in sample units (not saturated)
+    void generate(uint64_t begin, size_t count, float *acc) const;
+
+protected:
+    const WGEN& m_wgen;
+    uint64_t m_total;
+    std::vector<float> m_table;     // one cycle, with a guard entry
+    uint64_t m_inc;                 // sine phase per frame; 2^64 per cycle
+    float m_amplitude;
+    uint64_t m_noise_key;
+    uint64_t m_gap_period, m_gap_length;
+    uint64_t m_clip_period, m_clip_length;
+
+    float lookup(uint32_t phase) const;
+    float sweep(uint64_t n) const;
+    float noise(uint64_t index) const;
+};
+
+// splitmix64: a counter-based PRNG; index --> 64 random bits
+static inline uint64_t gen_mix(uint64_t z)
+{
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+WavGen::WavGen(const WGEN& wgen, uint64_t total) : m_wgen(wgen), m_total(total)
+{
+    const double pi = 3.14159265358979323846;
+    const size_t size = size_t(1) << WGEN_TABLE_BITS;
+    m_table.resize(size + 1);
+    for (size_t i = 0; i <= size; ++i)
+    {
+        m_table[i] = float(std::sin(2 * pi * double(i) / double(size)));
+    }
+
+    const uint32_t rate = wgen.sampling_rate;
+    double cycles = std::fmod(wgen.freq / rate, 1.0);
+    m_inc = (cycles * 18446744073709551616.0 < 18446744073709551615.0)
+          ? uint64_t(cycles * 18446744073709551616.0) : 0;
+
+    double full = (wgen.mode == 8) ? 128.0 : 32768.0;
+    m_amplitude = float(full * std::pow(10.0, wgen.level / 20));
+    m_noise_key = gen_mix(wgen.seed ^ 0x6A09E667F3BCC909ULL);
+
+    m_gap_period = wgen.gaps.empty() ? 0 : wgen.gaps.period.to_units(rate);
+    m_gap_length = wgen.gaps.empty() ? 0 : wgen.gaps.length.to_units(rate);
+    m_clip_period = wgen.clips.empty() ? 0 : wgen.clips.period.to_units(rate);
+    m_clip_length = wgen.clips.empty() ? 0 : wgen.clips.length.to_units(rate);
+}
+
+inline float WavGen::lookup(uint32_t phase) const
+{
+    const int shift = 32 - WGEN_TABLE_BITS;
+    uint32_t i = phase >> shift;
+    float frac = float(phase & ((uint32_t(1) << shift) - 1)) * (1.0f / (uint32_t(1) << shift));
+    return m_table[i] + (m_table[i + 1] - m_table[i]) * frac;
+}
+
+inline float WavGen::sweep(uint64_t n) const
+{
+    // cycles so far: (f1 n + (f2 - f1) n^2 / 2N) / rate
+    double f1 = m_wgen.freq;
+    double f2 = m_wgen.freq2 ? m_wgen.freq2 : m_wgen.sampling_rate / 2.0;
+    double x = double(n);
+    double cycles = x * (f1 + (f2 - f1) * x / (2.0 * double(m_total))) / m_wgen.sampling_rate;
+    cycles -= std::floor(cycles);
+    return lookup(uint32_t(uint64_t(cycles * 4294967296.0)));
+}
+
+inline float WavGen::noise(uint64_t index) const
+{
+    uint64_t bits = gen_mix(m_noise_key + (index + 1) * 0x9E3779B97F4A7C15ULL);
+    // the top 24 bits --> [-1, 1)
+    return float(int32_t(bits >> 40) - (1 << 23)) * (1.0f / (1 << 23));
+}
+
+void WavGen::generate(uint64_t begin, size_t count, float *acc) const
+{
+    const int channels = m_wgen.channels;
+    for (size_t i = 0; i < count; ++i)
+    {
+        const uint64_t n = begin + i;
+        float *frame = acc + i * channels;
+
+        if (m_gap_period && n % m_gap_period < m_gap_length)
+        {
+            for (int ch = 0; ch < channels; ++ch)
+                frame[ch] = 0;
+            continue;
+        }
+
+        float gain = m_amplitude;
+        if (m_clip_period && n % m_clip_period < m_clip_length)
+            gain *= 4;
+
+        switch (m_wgen.signal)
+        {
+        case WGEN_SIGNAL_SINE:
+            frame[0] = gain * lookup(uint32_t((n * m_inc) >> 32));
+            break;
+        case WGEN_SIGNAL_SWEEP:
+            frame[0] = gain * sweep(n);
+            break;
+        case WGEN_SIGNAL_NOISE:
+            for (int ch = 0; ch < channels; ++ch)
+                frame[ch] = gain * noise(n * channels + ch);
+            continue;
+        default:
+            frame[0] = 0;
+            break;
+        }
+        for (int ch = 1; ch < channels; ++ch)
+            frame[ch] = frame[0];
+    }
+}
+
+bool wavgen_fp(const char *out, FILE *fout, const WGEN& wgen)
+{
+    const uint32_t rate = wgen.sampling_rate;
+    const uint64_t total = wgen.duration.to_units(rate);
+    const size_t unit = wgen.channels * wgen.mode / 8;
+
+    PcmWaveWriter writer;
+    if (!writer.open(fout, wgen.channels, wgen.mode, rate, total * unit))
+    {
+        pcm_wave_message("ERROR: %s: Unable to write.\n", out);
+        return false;
+    }
+
+    auto t0 = std::chrono::steady_clock::now();
+
+    WavGen gen(wgen, total);
+    std::vector<uint8_t> batch(size_t(WGEN_BLOCK_UNITS) * WGEN_BATCH * unit);
+    for (uint64_t pos = 0; pos < total; )
+    {
+        uint64_t left = total - pos;
+        size_t units = (left < uint64_t(WGEN_BLOCK_UNITS) * WGEN_BATCH)
+                     ? size_t(left) : size_t(WGEN_BLOCK_UNITS) * WGEN_BATCH;
+
+        // one block per task; the block boundaries are fixed
+        pcm_parallel_for(units, WGEN_BLOCK_UNITS, [&](size_t, size_t begin, size_t end)
+        {
+            size_t count = (end - begin) * wgen.channels;
+            std::vector<float> acc(count);
+            gen.generate(pos + begin, end - begin, &acc[0]);
+            if (wgen.mode == 8)
+                pcm_store_8bit(&batch[begin * unit], &acc[0], count);
+            else
+                pcm_store_16bit(reinterpret_cast<int16_t *>(&batch[begin * unit]), &acc[0], count);
+        });
+
+        if (!writer.write(&batch[0], units * unit))
+        {
+            pcm_wave_message("ERROR: %s: Unable to write.\n", out);
+            return false;
+        }
+        pos += units;
+    }
+
+    if (!writer.close())
+    {
+        pcm_wave_message("ERROR: %s: Unable to write.\n", out);
+        return false;
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - t0;
+    const PcmWave& header = writer.header();
+    pcm_wave_show_info(out, header);
+    if (elapsed.count() > 0)
+    {
+        pcm_wave_message("%s: %.3f seconds (%.1f MB/s)\n", out, elapsed.count(),
+                         double(total * unit) / elapsed.count() / (1024 * 1024));
+    }
+    return true;
+}
+
+bool wavgen(const char *out_file, const WGEN& wgen)
+{
+    FILE *fout = pcm_wave_fopen(out_file, "wb");
+    if (!fout)
+    {
+        pcm_wave_message("ERROR: Unable to open file '%s'.\n", out_file);
+        return false;
+    }
+
+    bool ret = wavgen_fp(out_file, fout, wgen);
+    pcm_wave_fclose(fout);
+
+    if (ret)
+        pcm_wave_message("--> '%s' (OK)\n", out_file);
+    return ret;
+}
@@ -0,0 +1,43 @@
+#ifndef WAVGEN_HPP_
+#define WAVGEN_HPP_
+
+#include <cstdio>
+
+#define WGEN_BLOCK_UNITS    (64 * 1024)     // frames per generated block
+#define WGEN_BATCH          64              // blocks generated in parallel
+#define WGEN_TABLE_BITS     12              // 4096-entry sine table
+
+#define WGEN_SIGNAL_SINE    0
+#define WGEN_SIGNAL_SWEEP   1   // linear from freq to freq2 over the duration
+#define WGEN_SIGNAL_NOISE   2   // white, uniform
+#define WGEN_SIGNAL_SILENCE 3
+
+// An event that repeats every period for length (both in frames if set).
+struct WGEN_BURST
+{
+    PcmWaveTime period;
+    PcmWaveTime length;
+
+    bool parse(const char *str);    // "PERIOD,LENGTH"
+    bool empty() const { return period.empty(); }
+};
+
+struct WGEN
+{
+    int channels = 1;
+    int mode = 16;
+    int sampling_rate = 44100;
+    PcmWaveTime duration;   // required
+    int signal = WGEN_SIGNAL_SINE;
+    double freq = 440;      // in Hz
+    double freq2 = 0;       // end of the sweep; sampling_rate / 2 if zero
+    double level = -6;      // peak in dBFS
+    uint64_t seed = 1;
+    WGEN_BURST gaps;        // silence
+    WGEN_BURST clips;       // +12 dB, saturating
+};
+
+bool wavgen_fp(const char *out, FILE *fout, const WGEN& wgen);
+bool wavgen(const char *out_file, const WGEN& wgen);
+
+#endif  // ndef WAVGEN_HPP_
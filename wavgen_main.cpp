@@ -0,0 +1,160 @@
+#include "PcmWave.hpp"
+#include "wavgen.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static void show_help(void)
+{
+    printf("wavgen --- Generates a synthetic wave file\n");
+    printf("Usage: wavgen [options] --duration TIME output.wav\n");
+    printf("Use '-' for stdout.\n");
+    printf("Options:\n");
+    printf("--help              Show this help.\n");
+    printf("--version           Show version info.\n");
+    printf("--duration TIME     Length in seconds, or frames with 'f' suffix.\n");
+    printf("--channels XXX      Specify the number of channels (default: 1).\n");
+    printf("--rate XXX          Specify sampling rate (default: 44100).\n");
+    printf("--mode XXX          Specify bits per sample (default: 16).\n");
+    printf("--signal XXX        'sine' (default), 'sweep', 'noise' or 'silence'.\n");
+    printf("--freq HZ           Frequency of the sine, or the start of the sweep.\n");
+    printf("--freq2 HZ          End of the sweep (default: the Nyquist frequency).\n");
+    printf("--level DB          Peak level in dBFS (default: -6).\n");
+    printf("--seed XXX          Seed of the noise (default: 1).\n");
+    printf("--gaps P,L          Silence of L every P (times as in --duration).\n");
+    printf("--clips P,L         Overdrive by 12 dB for L every P.\n");
+}
+
+static void show_version(void)
+{
+    printf("wavgen version 0.1 by katahiromz\n");
+}
+
+int main(int argc, char **argv)
+{
+    pcm_wave_messages() = stderr;    // the library is quiet otherwise
+
+    WGEN wgen;
+    const char *out_file = NULL;
+
+    if (argc <= 1)
+    {
+        show_help();
+        return EXIT_SUCCESS;
+    }
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (argv[i][0] == '-' && argv[i][1] != 0)
+        {
+            if (strcmp(argv[i], "--help") == 0)
+            {
+                show_help();
+                return EXIT_SUCCESS;
+            }
+            if (strcmp(argv[i], "--version") == 0)
+            {
+                show_version();
+                return EXIT_SUCCESS;
+            }
+            if (i + 1 >= argc)
+            {
+                fprintf(stderr, "ERROR: No parameter for '%s'.\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+
+            const char *opt = argv[i++];
+            const char *param = argv[i];
+            char *endptr = NULL;
+            bool ok = true;
+            if (strcmp(opt, "--duration") == 0)
+            {
+                ok = wgen.duration.parse(param);
+            }
+            else if (strcmp(opt, "--channels") == 0)
+            {
+                wgen.channels = (int)strtoul(param, NULL, 0);
+                ok = (wgen.channels == 1 || wgen.channels == 2);
+            }
+            else if (strcmp(opt, "--rate") == 0)
+            {
+                wgen.sampling_rate = (int)strtoul(param, NULL, 0);
+                ok = (wgen.sampling_rate > 0);
+            }
+            else if (strcmp(opt, "--mode") == 0)
+            {
+                wgen.mode = (int)strtoul(param, NULL, 0);
+                ok = (wgen.mode == 8 || wgen.mode == 16);
+            }
+            else if (strcmp(opt, "--signal") == 0)
+            {
+                if (strcmp(param, "sine") == 0)
+                    wgen.signal = WGEN_SIGNAL_SINE;
+                else if (strcmp(param, "sweep") == 0)
+                    wgen.signal = WGEN_SIGNAL_SWEEP;
+                else if (strcmp(param, "noise") == 0)
+                    wgen.signal = WGEN_SIGNAL_NOISE;
+                else if (strcmp(param, "silence") == 0)
+                    wgen.signal = WGEN_SIGNAL_SILENCE;
+                else
+                    ok = false;
+            }
+            else if (strcmp(opt, "--freq") == 0 || strcmp(opt, "--freq2") == 0)
+            {
+                double& freq = (opt[6] == '2') ? wgen.freq2 : wgen.freq;
+                freq = strtod(param, &endptr);
+                ok = (*endptr == 0 && freq >= 0);
+            }
+            else if (strcmp(opt, "--level") == 0)
+            {
+                wgen.level = strtod(param, &endptr);
+                ok = (*endptr == 0);
+            }
+            else if (strcmp(opt, "--seed") == 0)
+            {
+                wgen.seed = strtoull(param, &endptr, 0);
+                ok = (*endptr == 0);
+            }
+            else if (strcmp(opt, "--gaps") == 0)
+            {
+                ok = wgen.gaps.parse(param);
+            }
+            else if (strcmp(opt, "--clips") == 0)
+            {
+                ok = wgen.clips.parse(param);
+            }
+            else
+            {
+                fprintf(stderr, "ERROR: Invalid argument '%s'.\n", opt);
+                return EXIT_FAILURE;
+            }
+
+            if (!ok)
+            {
+                fprintf(stderr, "ERROR: Invalid parameter '%s'.\n", param);
+                return EXIT_FAILURE;
+            }
+            continue;
+        }
+
+        if (out_file)
+        {
+            fprintf(stderr, "ERROR: Too many argument.\n");
+            return EXIT_FAILURE;
+        }
+        out_file = argv[i];
+    }
+
+    if (wgen.duration.empty())
+    {
+        fprintf(stderr, "ERROR: No duration.\n");
+        return EXIT_FAILURE;
+    }
+    if (out_file == NULL)
+    {
+        fprintf(stderr, "ERROR: No output file.\n");
+        return EXIT_FAILURE;
+    }
+
+    return wavgen(out_file, wgen) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
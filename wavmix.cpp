@@ -0,0 +1,181 @@
+#include "PcmWave.hpp"
+#include "PcmSimd.hpp"
+#include "wav2wav.hpp"
+#include "wavmix.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+
+struct MixSource
+{
+    const char *name;
+    PcmWaveReader reader;
+    float gain;
+    uint64_t offset;        // in output frames
+    bool done;
+};
+
+bool wavmix_fp(const char *out, FILE *fout, FILE **fins, const WMIX& wmix)
+{
+    const size_t count = wmix.inputs.size();
+    std::vector<MixSource> sources(count);
+
+    // the common format
+    W2W w2w;
+    w2w.channels = wmix.channels;
+    w2w.mode = wmix.mode;
+    uint32_t rate = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        MixSource& src = sources[i];
+        src.name = wmix.inputs[i].file;
+        if (!src.reader.open(fins[i]))
+        {
+            pcm_wave_message("ERROR: %s: unable to read\n", src.name);
+            return false;
+        }
+
+        const PcmWave& header = src.reader.header();
+        pcm_wave_show_info(src.name, header);
+        if ((!header.mode_8bit() && !header.mode_16bit()) || header.num_channels() > 2)
+        {
+            pcm_wave_message("ERROR: %s: Unable to convert.\n", src.name);
+            return false;
+        }
+        if (rate && rate != header.sample_rate())
+        {
+            pcm_wave_message("ERROR: %s: Sampling rates differ (%lu Hz and %lu Hz).\n",
+                             src.name, (unsigned long)rate, (unsigned long)header.sample_rate());
+            return false;
+        }
+        rate = header.sample_rate();
+
+        if (!wmix.channels && w2w.channels < header.num_channels())
+            w2w.channels = header.num_channels();
+        if (!wmix.mode && w2w.mode < header.mode())
+            w2w.mode = header.mode();
+
+        src.gain = float(std::pow(10.0, wmix.inputs[i].gain / 20));
+        src.offset = wmix.inputs[i].offset.empty() ? 0 : wmix.inputs[i].offset.to_units(rate);
+        src.done = false;
+    }
+
+    PcmWaveWriter writer;
+    if (!writer.open(fout, w2w.channels, w2w.mode, rate))
+    {
+        pcm_wave_message("ERROR: %s: Unable to write.\n", out);
+        return false;
+    }
+
+    const size_t channels = w2w.channels;
+    std::vector<float> acc(WMIX_BLOCK_UNITS * channels);
+    PcmWave wave1, wave2, output(w2w.channels, w2w.mode, rate);
+
+    // the output block [pos, pos + WMIX_BLOCK_UNITS)
+    for (uint64_t pos = 0; ; pos += WMIX_BLOCK_UNITS)
+    {
+        size_t length = 0;      // output frames with any input
+        bool pending = false;   // an input starts later
+        std::fill(acc.begin(), acc.end(), 0.0f);
+
+        for (auto& src : sources)
+        {
+            if (src.done)
+                continue;
+            if (src.offset >= pos + WMIX_BLOCK_UNITS)
+            {
+                pending = true;
+                continue;
+            }
+
+            size_t skip = (src.offset > pos) ? size_t(src.offset - pos) : 0;
+            size_t got = src.reader.read(wave1, WMIX_BLOCK_UNITS - skip);
+            if (got < WMIX_BLOCK_UNITS - skip)
+                src.done = true;
+            if (got == 0)
+                continue;
+
+            if (!convert_wave(wave1, wave2, w2w))
+            {
+                pcm_wave_message("ERROR: %s: Unable to convert.\n", src.name);
+                return false;
+            }
+
+            float *dest = &acc[skip * channels];
+            if (wave2.mode_8bit())
+                pcm_mix_8bit(dest, &wave2.data_8bit(0), got * channels, src.gain);
+            else
+                pcm_mix_16bit(dest, &wave2.data_16bit(0), got * channels, src.gain);
+
+            if (length < skip + got)
+                length = skip + got;
+            if (!src.done)
+                pending = true;
+        }
+
+        if (length == 0 && !pending)
+            break;
+        if (length < WMIX_BLOCK_UNITS && pending)
+            length = WMIX_BLOCK_UNITS;  // a gap of silence
+
+        output.resize(length * output.data_unit());
+        if (output.mode_8bit())
+            pcm_store_8bit(&output.data_8bit(0), &acc[0], length * channels);
+        else
+            pcm_store_16bit(&output.data_16bit(0), &acc[0], length * channels);
+
+        if (!writer.write(output))
+        {
+            pcm_wave_message("ERROR: %s: Unable to write.\n", out);
+            return false;
+        }
+    }
+
+    if (!writer.close())
+    {
+        pcm_wave_message("ERROR: %s: Unable to write.\n", out);
+        return false;
+    }
+
+    pcm_wave_show_info(out, writer.header());
+    return true;
+}
+
+bool wavmix(const char *out_file, const WMIX& wmix)
+{
+    std::vector<FILE *> fins(wmix.inputs.size(), NULL);
+    FILE *fout = NULL;
+    bool ret = false;
+
+    for (size_t i = 0; i < wmix.inputs.size(); ++i)
+    {
+        const char *file = wmix.inputs[i].file;
+        fins[i] = pcm_wave_fopen(file, "rb");
+        if (!fins[i])
+        {
+            pcm_wave_message("ERROR: Unable to open file '%s'.\n", file);
+            goto cleanup;
+        }
+    }
+
+    fout = pcm_wave_fopen(out_file, "wb");
+    if (!fout)
+    {
+        pcm_wave_message("ERROR: Unable to open file '%s'.\n", out_file);
+        goto cleanup;
+    }
+
+    ret = wavmix_fp(out_file, fout, &fins[0], wmix);
+    if (ret)
+        pcm_wave_message("--> '%s' (OK)\n", out_file);
+
+cleanup:
+    if (fout)
+        pcm_wave_fclose(fout);
+    for (auto fp : fins)
+    {
+        if (fp)
+            pcm_wave_fclose(fp);
+    }
+    return ret;
+}
@@ -0,0 +1,26 @@
+#ifndef WAVMIX_HPP_
+#define WAVMIX_HPP_
+
+#include <cstdio>
+#include <vector>
+
+#define WMIX_BLOCK_UNITS    (64 * 1024)     // output frames per block
+
+struct WMIX_INPUT
+{
+    const char *file = NULL;
+    double gain = 0;        // in dB
+    PcmWaveTime offset;     // where the input starts in the output
+};
+
+struct WMIX
+{
+    int channels = 0;       // the most channels of the inputs if zero
+    int mode = 0;           // the most bits of the inputs if zero
+    std::vector<WMIX_INPUT> inputs;
+};
+
+bool wavmix_fp(const char *out, FILE *fout, FILE **fins, const WMIX& wmix);
+bool wavmix(const char *out_file, const WMIX& wmix);
+
+#endif  // ndef WAVMIX_HPP_
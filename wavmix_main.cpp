@@ -0,0 +1,132 @@
+#include "PcmWave.hpp"
+#include "wavmix.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static void show_help(void)
+{
+    printf("wavmix --- Mixes wave files into one\n");
+    printf("Usage: wavmix [options] -o output.wav [input options] input.wav ...\n");
+    printf("Use '-' for stdin/stdout.\n");
+    printf("Options:\n");
+    printf("--help          Show this help.\n");
+    printf("--version       Show version info.\n");
+    printf("-o FILE         Specify the output file.\n");
+    printf("--channels XXX  Specify the number of channels.\n");
+    printf("--mode XXX      Specify bits per sample.\n");
+    printf("Input options (apply to the next input):\n");
+    printf("--gain DB       Gain of the input in decibels.\n");
+    printf("--offset TIME   Start of the input in seconds, or frames with 'f' suffix.\n");
+}
+
+static void show_version(void)
+{
+    printf("wavmix version 0.1 by katahiromz\n");
+}
+
+int main(int argc, char **argv)
+{
+    pcm_wave_messages() = stderr;    // the library is quiet otherwise
+
+    WMIX wmix;
+    WMIX_INPUT input;
+    const char *out_file = NULL;
+
+    if (argc <= 1)
+    {
+        show_help();
+        return EXIT_SUCCESS;
+    }
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (argv[i][0] == '-' && argv[i][1] != 0)
+        {
+            if (strcmp(argv[i], "--help") == 0)
+            {
+                show_help();
+                return EXIT_SUCCESS;
+            }
+            if (strcmp(argv[i], "--version") == 0)
+            {
+                show_version();
+                return EXIT_SUCCESS;
+            }
+            if (i + 1 >= argc)
+            {
+                fprintf(stderr, "ERROR: No parameter for '%s'.\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+            if (strcmp(argv[i], "-o") == 0)
+            {
+                out_file = argv[++i];
+                continue;
+            }
+            if (strcmp(argv[i], "--channels") == 0)
+            {
+                ++i;
+                wmix.channels = (int)strtoul(argv[i], NULL, 0);
+                if (wmix.channels != 1 && wmix.channels != 2)
+                {
+                    fprintf(stderr, "ERROR: Invalid parameter '%s'.\n", argv[i]);
+                    return EXIT_FAILURE;
+                }
+                continue;
+            }
+            if (strcmp(argv[i], "--mode") == 0)
+            {
+                ++i;
+                wmix.mode = (int)strtoul(argv[i], NULL, 0);
+                if (wmix.mode != 8 && wmix.mode != 16)
+                {
+                    fprintf(stderr, "ERROR: Invalid parameter '%s'.\n", argv[i]);
+                    return EXIT_FAILURE;
+                }
+                continue;
+            }
+            if (strcmp(argv[i], "--gain") == 0)
+            {
+                ++i;
+                char *endptr;
+                input.gain = strtod(argv[i], &endptr);
+                if (*endptr != 0)
+                {
+                    fprintf(stderr, "ERROR: Invalid parameter '%s'.\n", argv[i]);
+                    return EXIT_FAILURE;
+                }
+                continue;
+            }
+            if (strcmp(argv[i], "--offset") == 0)
+            {
+                ++i;
+                if (!input.offset.parse(argv[i]))
+                {
+                    fprintf(stderr, "ERROR: Invalid parameter '%s'.\n", argv[i]);
+                    return EXIT_FAILURE;
+                }
+                continue;
+            }
+
+            fprintf(stderr, "ERROR: Invalid argument '%s'.\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+
+        input.file = argv[i];
+        wmix.inputs.push_back(input);
+        input = WMIX_INPUT();
+    }
+
+    if (wmix.inputs.empty())
+    {
+        fprintf(stderr, "ERROR: No input file.\n");
+        return EXIT_FAILURE;
+    }
+    if (out_file == NULL)
+    {
+        fprintf(stderr, "ERROR: No output file.\n");
+        return EXIT_FAILURE;
+    }
+
+    return wavmix(out_file, wmix) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,476 @@
+#include "PcmWave.hpp"
+#include "PcmSimd.hpp"
+#include "PcmParallel.hpp"
+#include "wavplot.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <climits>
+#include <chrono>
+
+WavPlotBins::WavPlotBins(int channels, int width, uint64_t frames)
+    : m_channels(channels), m_frames(0)
+{
+    m_limit = size_t(width) * WPLOT_BINS * 2;
+    m_run = 1;
+    if (frames != PCM_WAVE_SIZE_UNKNOWN)
+    {
+        uint64_t bins = uint64_t(width) * WPLOT_BINS;
+        m_run = (frames + bins - 1) / bins;
+        if (m_run == 0)
+            m_run = 1;
+    }
+}
+
+// halves the bins; the runs get twice as long
+void WavPlotBins::merge()
+{
+    size_t count = m_mins.size() / m_channels;
+    size_t half = (count + 1) / 2;
+    for (size_t i = 0; i < half; ++i)
+    {
+        for (int ch = 0; ch < m_channels; ++ch)
+        {
+            int vmin = m_mins[2 * i * m_channels + ch];
+            int vmax = m_maxs[2 * i * m_channels + ch];
+            if (2 * i + 1 < count)
+            {
+                pcm_minmax_sample(m_mins[(2 * i + 1) * m_channels + ch], vmin, vmax);
+                pcm_minmax_sample(m_maxs[(2 * i + 1) * m_channels + ch], vmin, vmax);
+            }
+            m_mins[i * m_channels + ch] = vmin;
+            m_maxs[i * m_channels + ch] = vmax;
+        }
+    }
+    m_mins.resize(half * m_channels);
+    m_maxs.resize(half * m_channels);
+    m_run *= 2;
+}
+
+// Scans a block in parallel over frame ranges. Each range keeps the bins
+// it touches, which are merged afterwards in order.
+bool WavPlotBins::add(const PcmWave& block)
+{
+    if (!block.mode_8bit() && !block.mode_16bit())
+        return false;
+
+    size_t units = size_t(block.num_units());
+    if (units == 0)
+        return true;
+
+    while ((m_frames + units + m_run - 1) / m_run > m_limit)
+        merge();
+    m_mins.resize(size_t((m_frames + units + m_run - 1) / m_run) * m_channels, INT_MAX);
+    m_maxs.resize(m_mins.size(), INT_MIN);
+
+    const int channels = m_channels;
+    const uint64_t first = m_frames, run = m_run;
+    std::vector<std::vector<int> > parts(pcm_parallel_num_chunks(units, WPLOT_GRAIN));
+    pcm_parallel_for(units, WPLOT_GRAIN, [&](size_t chunk, size_t begin, size_t end)
+    {
+        uint64_t bin0 = (first + begin) / run;
+        uint64_t bin1 = (first + end - 1) / run;
+        std::vector<int>& part = parts[chunk];
+        part.resize(size_t(bin1 - bin0 + 1) * channels * 2);
+        for (uint64_t bin = bin0; bin <= bin1; ++bin)
+        {
+            uint64_t a = bin * run, b = a + run;
+            size_t from = (a > first + begin) ? size_t(a - first) : begin;
+            size_t to = (b < first + end) ? size_t(b - first) : end;
+            int *mins = &part[size_t(bin - bin0) * channels * 2];
+            int *maxs = mins + channels;
+            for (int ch = 0; ch < channels; ++ch)
+            {
+                mins[ch] = INT_MAX;
+                maxs[ch] = INT_MIN;
+            }
+            if (block.mode_8bit())
+                pcm_minmax_8bit(&block.data_8bit(from * channels), to - from, channels, mins, maxs);
+            else
+                pcm_minmax_16bit(&block.data_16bit(from * channels), to - from, channels, mins, maxs);
+        }
+    });
+
+    for (size_t chunk = 0; chunk < parts.size(); ++chunk)
+    {
+        size_t bin0 = size_t((first + chunk * WPLOT_GRAIN) / run);
+        const std::vector<int>& part = parts[chunk];
+        for (size_t i = 0; i < part.size() / (channels * 2); ++i)
+        {
+            for (int ch = 0; ch < channels; ++ch)
+            {
+                int& vmin = m_mins[(bin0 + i) * channels + ch];
+                int& vmax = m_maxs[(bin0 + i) * channels + ch];
+                pcm_minmax_sample(part[i * channels * 2 + ch], vmin, vmax);
+                pcm_minmax_sample(part[i * channels * 2 + channels + ch], vmin, vmax);
+            }
+        }
+    }
+
+    m_frames += units;
+    return true;
+}
+
+void WavPlotBins::columns(int width, std::vector<int>& mins, std::vector<int>& maxs) const
+{
+    size_t count = m_mins.size() / m_channels;
+    mins.assign(size_t(width) * m_channels, 0);
+    maxs.assign(size_t(width) * m_channels, 0);
+    if (count == 0)
+        return;
+
+    for (size_t x = 0; x < size_t(width); ++x)
+    {
+        size_t bin0 = x * count / width;
+        size_t bin1 = (x + 1) * count / width;
+        if (bin1 <= bin0)
+            bin1 = bin0 + 1;
+        for (int ch = 0; ch < m_channels; ++ch)
+        {
+            int vmin = INT_MAX, vmax = INT_MIN;
+            for (size_t bin = bin0; bin < bin1; ++bin)
+            {
+                pcm_minmax_sample(m_mins[bin * m_channels + ch], vmin, vmax);
+                pcm_minmax_sample(m_maxs[bin * m_channels + ch], vmin, vmax);
+            }
+            mins[x * m_channels + ch] = vmin;
+            maxs[x * m_channels + ch] = vmax;
+        }
+    }
+}
+
+// the colors of the raster, by index
+#define WPLOT_BACK      0
+#define WPLOT_AXIS      1
+#define WPLOT_WAVE      2
+
+static const uint8_t s_palette[3][3] =
+{
+    { 0xFF, 0xFF, 0xFF },   // WPLOT_BACK
+    { 0xC0, 0xC0, 0xC0 },   // WPLOT_AXIS
+    { 0x30, 0x70, 0xC0 },   // WPLOT_WAVE
+};
+
+// the row of value in a lane of height pixels; full scale is [-full, full)
+static int value_row(int value, int full, int height)
+{
+    return int(int64_t(full - 1 - value) * (height - 1) / (2 * full - 1));
+}
+
+// One lane per channel, top to bottom. A column is a vertical line from
+// its max. to its min., stretched to meet the previous column.
+static void rasterize(const std::vector<int>& mins, const std::vector<int>& maxs,
+                      int channels, int full, const WPLOT& wplot, std::vector<uint8_t>& image)
+{
+    const int width = wplot.width, height = wplot.height;
+    image.assign(size_t(width) * height * channels, WPLOT_BACK);
+    for (int ch = 0; ch < channels; ++ch)
+    {
+        uint8_t *lane = &image[size_t(ch) * height * width];
+        memset(lane + size_t(value_row(0, full, height)) * width, WPLOT_AXIS, width);
+
+        int prev_top = -1, prev_bottom = -1;
+        for (int x = 0; x < width; ++x)
+        {
+            int vmin = mins[size_t(x) * channels + ch];
+            int vmax = maxs[size_t(x) * channels + ch];
+            if (vmin > vmax)
+                continue;
+            int top = value_row(vmax, full, height);
+            int bottom = value_row(vmin, full, height);
+            int y0 = top, y1 = bottom;
+            if (prev_top >= 0)
+            {
+                if (y0 > prev_bottom)
+                    y0 = prev_bottom;
+                if (y1 < prev_top)
+                    y1 = prev_top;
+            }
+            for (int y = y0; y <= y1; ++y)
+                lane[size_t(y) * width + x] = WPLOT_WAVE;
+            prev_top = top;
+            prev_bottom = bottom;
+        }
+    }
+}
+
+static bool write_ppm(FILE *fout, const std::vector<uint8_t>& image, int width, int height)
+{
+    fprintf(fout, "P6\n%d %d\n255\n", width, height);
+    std::vector<uint8_t> row(size_t(width) * 3);
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+            memcpy(&row[size_t(x) * 3], s_palette[image[size_t(y) * width + x]], 3);
+        if (fwrite(&row[0], row.size(), 1, fout) != 1)
+            return false;
+    }
+    return true;
+}
+
+static uint32_t png_crc32(uint32_t crc, const uint8_t *data, size_t size)
+{
+    static uint32_t s_table[256];
+    static bool s_ready = false;
+    if (!s_ready)
+    {
+        for (uint32_t n = 0; n < 256; ++n)
+        {
+            uint32_t c = n;
+            for (int k = 0; k < 8; ++k)
+                c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+            s_table[n] = c;
+        }
+        s_ready = true;
+    }
+
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i)
+        crc = s_table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+static void png_put32(uint8_t *p, uint32_t value)
+{
+    p[0] = uint8_t(value >> 24);
+    p[1] = uint8_t(value >> 16);
+    p[2] = uint8_t(value >> 8);
+    p[3] = uint8_t(value);
+}
+
+static bool write_png_chunk(FILE *fout, const char *type, const std::vector<uint8_t>& data)
+{
+    uint8_t head[8], tail[4];
+    png_put32(head, uint32_t(data.size()));
+    memcpy(head + 4, type, 4);
+    uint32_t crc = png_crc32(0, head + 4, 4);
+    if (!data.empty())
+        crc = png_crc32(crc, &data[0], data.size());
+    png_put32(tail, crc);
+    return fwrite(head, 8, 1, fout) == 1 &&
+           (data.empty() || fwrite(&data[0], data.size(), 1, fout) == 1) &&
+           fwrite(tail, 4, 1, fout) == 1;
+}
+
+// A 2-bit palette PNG. The zlib stream is made of stored deflate blocks;
+// at four pixels per byte the file stays small without compression.
+static bool write_png(FILE *fout, const std::vector<uint8_t>& image, int width, int height)
+{
+    static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    if (fwrite(signature, 8, 1, fout) != 1)
+        return false;
+
+    std::vector<uint8_t> data(13);
+    png_put32(&data[0], width);
+    png_put32(&data[4], height);
+    data[8] = 2;    // bit depth
+    data[9] = 3;    // color type: palette
+    data[10] = data[11] = data[12] = 0;
+    if (!write_png_chunk(fout, "IHDR", data))
+        return false;
+
+    data.assign(&s_palette[0][0], &s_palette[0][0] + sizeof(s_palette));
+    if (!write_png_chunk(fout, "PLTE", data))
+        return false;
+
+    // the rows, each with filter type 0
+    size_t stride = (size_t(width) * 2 + 7) / 8 + 1;
+    std::vector<uint8_t> raw(stride * height, 0);
+    for (int y = 0; y < height; ++y)
+    {
+        uint8_t *row = &raw[stride * y + 1];
+        const uint8_t *pixels = &image[size_t(y) * width];
+        for (int x = 0; x < width; ++x)
+            row[x >> 2] |= uint8_t(pixels[x] << (6 - 2 * (x & 3)));
+    }
+
+    // zlib: header, stored blocks of at most 65535 bytes, Adler-32
+    data.clear();
+    data.reserve(raw.size() + raw.size() / 65535 * 5 + 16);
+    data.push_back(0x78);
+    data.push_back(0x01);
+    size_t pos = 0;
+    do
+    {
+        size_t size = raw.size() - pos;
+        if (size > 65535)
+            size = 65535;
+        data.push_back(pos + size == raw.size() ? 1 : 0);
+        data.push_back(uint8_t(size));
+        data.push_back(uint8_t(size >> 8));
+        data.push_back(uint8_t(~size));
+        data.push_back(uint8_t(~size >> 8));
+        data.insert(data.end(), raw.begin() + pos, raw.begin() + pos + size);
+        pos += size;
+    } while (pos < raw.size());
+
+    uint32_t a = 1, b = 0;
+    for (size_t i = 0; i < raw.size(); ++i)
+    {
+        a = (a + raw[i]) % 65521;
+        b = (b + a) % 65521;
+    }
+    data.resize(data.size() + 4);
+    png_put32(&data[data.size() - 4], (b << 16) | a);
+    if (!write_png_chunk(fout, "IDAT", data))
+        return false;
+
+    data.clear();
+    return write_png_chunk(fout, "IEND", data);
+}
+
+// one filled outline per channel: the max. left to right, the min. back
+static bool write_svg(FILE *fout, const std::vector<int>& mins, const std::vector<int>& maxs,
+                      int channels, int full, const WPLOT& wplot)
+{
+    const int width = wplot.width, height = wplot.height;
+    const double scale = double(height - 1) / (2 * full - 1);
+    fprintf(fout, "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"%d\" height=\"%d\""
+                  " viewBox=\"0 0 %d %d\">\n", width, height * channels, width, height * channels);
+    fprintf(fout, "<rect width=\"%d\" height=\"%d\" fill=\"#FFFFFF\"/>\n", width, height * channels);
+    for (int ch = 0; ch < channels; ++ch)
+    {
+        double top = double(ch) * height + 0.5;
+        fprintf(fout, "<line x1=\"0\" y1=\"%.1f\" x2=\"%d\" y2=\"%.1f\" stroke=\"#C0C0C0\"/>\n",
+                top + value_row(0, full, height), width, top + value_row(0, full, height));
+
+        fprintf(fout, "<path fill=\"#3070C0\" stroke=\"#3070C0\" stroke-width=\"1\" d=\"");
+        char cmd = 'M';
+        for (int x = 0; x < width; ++x)
+        {
+            int vmax = maxs[size_t(x) * channels + ch];
+            if (mins[size_t(x) * channels + ch] > vmax)
+                continue;
+            fprintf(fout, "%c%.1f,%.1f", cmd, x + 0.5, top + (full - 1 - vmax) * scale);
+            cmd = 'L';
+        }
+        for (int x = width - 1; x >= 0; --x)
+        {
+            int vmin = mins[size_t(x) * channels + ch];
+            if (vmin > maxs[size_t(x) * channels + ch])
+                continue;
+            fprintf(fout, "L%.1f,%.1f", x + 0.5, top + (full - 1 - vmin) * scale);
+        }
+        fprintf(fout, "%s\"/>\n", (cmd == 'L') ? "Z" : "");
+    }
+    fprintf(fout, "</svg>\n");
+    return !ferror(fout);
+}
+
+static int format_of(const char *file)
+{
+    const char *dot = strrchr(file, '.');
+    if (dot)
+    {
+        char ext[8] = { 0 };
+        for (int i = 0; i < 7 && dot[i + 1]; ++i)
+            ext[i] = char(tolower((unsigned char)dot[i + 1]));
+        if (strcmp(ext, "ppm") == 0 || strcmp(ext, "pnm") == 0)
+            return WPLOT_FORMAT_PPM;
+        if (strcmp(ext, "svg") == 0)
+            return WPLOT_FORMAT_SVG;
+    }
+    return WPLOT_FORMAT_PNG;
+}
+
+bool wavplot_fp(const char *in, FILE *fin, const char *out, FILE *fout, const WPLOT& wplot)
+{
+    PcmWaveReader reader;
+    if (!reader.open(fin))
+    {
+        pcm_wave_message("ERROR: %s: unable to read\n", in);
+        return false;
+    }
+
+    const PcmWave& header = reader.header();
+    pcm_wave_show_info(in, header);
+    if (!header.mode_8bit() && !header.mode_16bit())
+    {
+        pcm_wave_message("ERROR: %s: %d-bit is not supported.\n", in, header.mode());
+        return false;
+    }
+
+    if (!wplot.start.empty() || !wplot.end.empty())
+    {
+        uint32_t rate = header.sample_rate();
+        uint64_t begin = wplot.start.empty() ? 0 : wplot.start.to_units(rate);
+        if (!reader.seek_range(begin, wplot.end.to_units(rate)))
+        {
+            pcm_wave_message("ERROR: %s: Invalid range.\n", in);
+            return false;
+        }
+    }
+
+    auto t0 = std::chrono::steady_clock::now();
+
+    const int channels = header.num_channels();
+    WavPlotBins bins(channels, wplot.width, reader.remaining_units());
+    PcmWave block;
+    while (reader.read(block, WPLOT_BLOCK_UNITS) > 0)
+    {
+        bins.add(block);
+    }
+
+    std::vector<int> mins, maxs;
+    bins.columns(wplot.width, mins, maxs);
+
+    const int full = header.mode_8bit() ? 128 : 32768;
+    int format = (wplot.format >= 0) ? wplot.format : format_of(out);
+    bool ok;
+    if (format == WPLOT_FORMAT_SVG)
+    {
+        ok = write_svg(fout, mins, maxs, channels, full, wplot);
+    }
+    else
+    {
+        std::vector<uint8_t> image;
+        rasterize(mins, maxs, channels, full, wplot, image);
+        if (format == WPLOT_FORMAT_PPM)
+            ok = write_ppm(fout, image, wplot.width, wplot.height * channels);
+        else
+            ok = write_png(fout, image, wplot.width, wplot.height * channels);
+    }
+    if (!ok || fflush(fout) != 0)
+    {
+        pcm_wave_message("ERROR: %s: Unable to write.\n", out);
+        return false;
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - t0;
+    if (elapsed.count() > 0)
+    {
+        pcm_wave_message("%s: %.3f seconds (%.0fx real time)\n", in, elapsed.count(),
+                         double(bins.frames()) / header.sample_rate() / elapsed.count());
+    }
+    return true;
+}
+
+bool wavplot(const char *wav_file, const char *out_file, const WPLOT& wplot)
+{
+    FILE *fin, *fout;
+
+    assert(wav_file);
+    assert(out_file);
+    fin = pcm_wave_fopen(wav_file, "rb");
+    if (!fin)
+    {
+        pcm_wave_message("ERROR: Unable to open file '%s'.\n", wav_file);
+        return false;
+    }
+
+    fout = pcm_wave_fopen(out_file, "wb");
+    if (!fout)
+    {
+        pcm_wave_message("ERROR: Unable to open file '%s'.\n", out_file);
+        pcm_wave_fclose(fin);
+        return false;
+    }
+
+    bool ret = wavplot_fp(wav_file, fin, out_file, fout, wplot);
+
+    pcm_wave_fclose(fout);
+    pcm_wave_fclose(fin);
+
+    return ret;
+}
@@ -0,0 +1,60 @@
+#ifndef WAVPLOT_HPP_
+#define WAVPLOT_HPP_
+
+#include <cstdio>
+#include <vector>
+
+#define WPLOT_BLOCK_UNITS   (1024 * 1024)   // frames per read
+#define WPLOT_GRAIN         (64 * 1024)     // frames per thread task
+#define WPLOT_BINS          4               // bins per column at least
+#define WPLOT_WIDTH         1000            // default pixels
+#define WPLOT_HEIGHT        200             // default pixels per channel
+
+#define WPLOT_FORMAT_PNG    0
+#define WPLOT_FORMAT_PPM    1
+#define WPLOT_FORMAT_SVG    2
+
+struct WPLOT
+{
+    int width = WPLOT_WIDTH;
+    int height = WPLOT_HEIGHT;  // of each channel
+    int format = -1;            // from the output file name if negative
+    PcmWaveTime start;          // from the beginning if empty
+    PcmWaveTime end;            // to the end if empty
+};
+
+// The min. and the max. of each channel over runs of frames of the same
+// length, in one pass. Values are centered (8-bit minus 128). If the
+// length of the input is not known, the runs are doubled and their bins
+// merged in pairs whenever there are too many of them.
+class WavPlotBins
+{
+public:
+    // frames: the total frames or PCM_WAVE_SIZE_UNKNOWN
+    WavPlotBins(int channels, int width, uint64_t frames);
+
+    bool add(const PcmWave& block);
+
+    // min. and max. of each channel for each of width columns
+    void columns(int width, std::vector<int>& mins, std::vector<int>& maxs) const;
+
+    uint64_t frames() const
+    {
+        return m_frames;
+    }
+
+protected:
+    int m_channels;
+    size_t m_limit;             // max. number of bins
+    uint64_t m_run;             // frames per bin
+    uint64_t m_frames;          // frames so far
+    std::vector<int> m_mins;    // [bin * channels + channel]
+    std::vector<int> m_maxs;
+
+    void merge();
+};
+
+bool wavplot_fp(const char *in, FILE *fin, const char *out, FILE *fout, const WPLOT& wplot);
+bool wavplot(const char *wav_file, const char *out_file, const WPLOT& wplot);
+
+#endif  // ndef WAVPLOT_HPP_
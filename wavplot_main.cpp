@@ -0,0 +1,141 @@
+#include "PcmWave.hpp"
+#include "wavplot.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static void show_help(void)
+{
+    printf("wavplot --- Draws the waveform of a wave file\n");
+    printf("Usage: wavplot [options] sound-file.wav output.png\n");
+    printf("Use '-' for stdin/stdout. The format is taken from the extension of\n");
+    printf("the output file (.png, .ppm or .svg); PNG by default.\n");
+    printf("Options:\n");
+    printf("--help          Show this help.\n");
+    printf("--version       Show version info.\n");
+    printf("--width XXX     Width in pixels (default: 1000).\n");
+    printf("--height XXX    Height of each channel in pixels (default: 200).\n");
+    printf("--format XXX    'png', 'ppm' or 'svg'.\n");
+    printf("--start TIME    Start position in seconds, or frames with 'f' suffix.\n");
+    printf("--end TIME      End position in seconds, or frames with 'f' suffix.\n");
+}
+
+static void show_version(void)
+{
+    printf("wavplot version 0.1 by katahiromz\n");
+}
+
+int main(int argc, char **argv)
+{
+    pcm_wave_messages() = stderr;    // the library is quiet otherwise
+
+    WPLOT wplot;
+
+    if (argc <= 1)
+    {
+        show_help();
+        return EXIT_SUCCESS;
+    }
+
+    const char *arg1 = NULL;
+    const char *arg2 = NULL;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (argv[i][0] == '-' && argv[i][1] != 0)
+        {
+            if (strcmp(argv[i], "--help") == 0)
+            {
+                show_help();
+                return EXIT_SUCCESS;
+            }
+            if (strcmp(argv[i], "--version") == 0)
+            {
+                show_version();
+                return EXIT_SUCCESS;
+            }
+            if (strcmp(argv[i], "--width") == 0 || strcmp(argv[i], "--height") == 0)
+            {
+                if (i + 1 >= argc)
+                {
+                    fprintf(stderr, "ERROR: No parameter for '%s'.\n", argv[i]);
+                    return EXIT_FAILURE;
+                }
+                int& value = (argv[i][2] == 'w') ? wplot.width : wplot.height;
+                ++i;
+                value = (int)strtoul(argv[i], NULL, 0);
+                if (value < 1 || value > 65536)
+                {
+                    fprintf(stderr, "ERROR: Invalid parameter '%s'.\n", argv[i]);
+                    return EXIT_FAILURE;
+                }
+                continue;
+            }
+            if (strcmp(argv[i], "--format") == 0)
+            {
+                if (i + 1 >= argc)
+                {
+                    fprintf(stderr, "ERROR: No parameter for '%s'.\n", argv[i]);
+                    return EXIT_FAILURE;
+                }
+                ++i;
+                if (strcmp(argv[i], "png") == 0)
+                    wplot.format = WPLOT_FORMAT_PNG;
+                else if (strcmp(argv[i], "ppm") == 0)
+                    wplot.format = WPLOT_FORMAT_PPM;
+                else if (strcmp(argv[i], "svg") == 0)
+                    wplot.format = WPLOT_FORMAT_SVG;
+                else
+                {
+                    fprintf(stderr, "ERROR: Invalid parameter '%s'.\n", argv[i]);
+                    return EXIT_FAILURE;
+                }
+                continue;
+            }
+            if (strcmp(argv[i], "--start") == 0 || strcmp(argv[i], "--end") == 0)
+            {
+                if (i + 1 >= argc)
+                {
+                    fprintf(stderr, "ERROR: No parameter for '%s'.\n", argv[i]);
+                    return EXIT_FAILURE;
+                }
+                PcmWaveTime& time = (argv[i][2] == 's') ? wplot.start : wplot.end;
+                ++i;
+                if (!time.parse(argv[i]))
+                {
+                    fprintf(stderr, "ERROR: Invalid parameter '%s'.\n", argv[i]);
+                    return EXIT_FAILURE;
+                }
+                continue;
+            }
+
+            fprintf(stderr, "ERROR: Invalid argument '%s'.\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+        if (arg1 == NULL)
+        {
+            arg1 = argv[i];
+        }
+        else if (arg2 == NULL)
+        {
+            arg2 = argv[i];
+        }
+        else
+        {
+            fprintf(stderr, "ERROR: Too many argument.\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (arg1 == NULL)
+    {
+        fprintf(stderr, "ERROR: No input file.\n");
+        return EXIT_FAILURE;
+    }
+    if (arg2 == NULL)
+    {
+        fprintf(stderr, "ERROR: No output file.\n");
+        return EXIT_FAILURE;
+    }
+
+    return wavplot(arg1, arg2, wplot) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,289 @@
+#include "PcmWave.hpp"
+#include "PcmFft.hpp"
+#include "PcmParallel.hpp"
+#include "wavspec.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <chrono>
+
+#define NPY_HEADER_SIZE     128
+
+bool wavspec_window(int window, size_t size, std::vector<float>& w)
+{
+    const double pi = 3.14159265358979323846;
+    w.resize(size);
+    for (size_t i = 0; i < size; ++i)
+    {
+        double x = 2 * pi * double(i) / double(size);  // periodic
+        switch (window)
+        {
+        case WSPEC_WINDOW_RECT:
+            w[i] = 1.0f;
+            break;
+        case WSPEC_WINDOW_HANN:
+            w[i] = float(0.5 - 0.5 * std::cos(x));
+            break;
+        case WSPEC_WINDOW_HAMMING:
+            w[i] = float(0.54 - 0.46 * std::cos(x));
+            break;
+        case WSPEC_WINDOW_BLACKMAN:
+            w[i] = float(0.42 - 0.5 * std::cos(x) + 0.08 * std::cos(2 * x));
+            break;
+        default:
+            return false;
+        }
+    }
+    return true;
+}
+
+// a fixed-size header, so that the shape can be patched afterwards
+static bool write_npy_header(FILE *fout, uint64_t rows, uint64_t cols)
+{
+    char dict[NPY_HEADER_SIZE];
+    int len = snprintf(dict, sizeof(dict),
+                       "{'descr': '<f4', 'fortran_order': False, 'shape': (%llu, %llu), }",
+                       (unsigned long long)rows, (unsigned long long)cols);
+    const int room = NPY_HEADER_SIZE - 10;
+    if (len < 0 || len >= room)
+        return false;
+    memset(dict + len, ' ', room - len - 1);
+    dict[room - 1] = '\n';
+
+    const uint8_t magic[8] = { 0x93, 'N', 'U', 'M', 'P', 'Y', 1, 0 };
+    uint16_t header_len = room;
+    return fwrite(magic, sizeof(magic), 1, fout) &&
+           fwrite(&header_len, sizeof(header_len), 1, fout) &&
+           fwrite(dict, room, 1, fout);
+}
+
+// appends the block as mono float samples in [-1, 1)
+static void append_samples(const PcmWave& block, int channel, std::vector<float>& samples)
+{
+    const int channels = block.num_channels();
+    const size_t units = size_t(block.num_units());
+    const bool is8 = block.mode_8bit();
+    const float scale = is8 ? 1.0f / 128 : 1.0f / 32768;
+
+    size_t base = samples.size();
+    samples.resize(base + units);
+    for (size_t i = 0; i < units; ++i)
+    {
+        float value = 0;
+        for (int ch = 0; ch < channels; ++ch)
+        {
+            if (channel >= 0 && ch != channel)
+                continue;
+            size_t index = i * channels + ch;
+            value += is8 ? float(int(block.data_8bit(index)) - 128) : float(block.data_16bit(index));
+        }
+        if (channel < 0)
+            value /= channels;
+        samples[base + i] = value * scale;
+    }
+}
+
+// computes the rows of count STFT frames starting at samples[0]
+static void compute_rows(const PcmRealFft& fft, const std::vector<float>& window,
+                         const float *samples, size_t count, size_t hop, bool db,
+                         std::vector<float>& rows)
+{
+    const size_t n = fft.size();
+    const size_t bins = fft.num_bins();
+    rows.resize(count * bins);
+
+    pcm_parallel_for(count, WSPEC_GRAIN, [&](size_t, size_t begin, size_t end)
+    {
+        std::vector<float> frame(n);
+        std::vector<PcmRealFft::complex_type> spectrum(bins);
+        for (size_t f = begin; f < end; ++f)
+        {
+            const float *src = samples + f * hop;
+            for (size_t i = 0; i < n; ++i)
+            {
+                frame[i] = src[i] * window[i];
+            }
+
+            fft.forward(&frame[0], &spectrum[0]);
+
+            float *row = &rows[f * bins];
+            for (size_t k = 0; k < bins; ++k)
+            {
+                float re = spectrum[k].real(), im = spectrum[k].imag();
+                float mag = std::sqrt(re * re + im * im);
+                row[k] = db ? 20 * std::log10(mag + 1e-10f) : mag;
+            }
+        }
+    });
+}
+
+bool wavspec_fp(const char *in, const char *out, FILE *fin, FILE *fout, const WSPEC& wspec)
+{
+    PcmWaveReader reader;
+    if (!reader.open(fin))
+    {
+        pcm_wave_message("ERROR: %s: unable to read\n", in);
+        return false;
+    }
+
+    const PcmWave& header = reader.header();
+    if (!header.mode_8bit() && !header.mode_16bit())
+    {
+        pcm_wave_message("ERROR: %s: %d-bit is not supported.\n", in, header.mode());
+        return false;
+    }
+    if (wspec.channel >= header.num_channels())
+    {
+        pcm_wave_message("ERROR: %s: No channel %d.\n", in, wspec.channel);
+        return false;
+    }
+
+    if (!wspec.start.empty() || !wspec.end.empty())
+    {
+        uint32_t rate = header.sample_rate();
+        uint64_t begin = wspec.start.empty() ? 0 : wspec.start.to_units(rate);
+        if (!reader.seek_range(begin, wspec.end.to_units(rate)))
+        {
+            pcm_wave_message("ERROR: %s: Invalid range.\n", in);
+            return false;
+        }
+    }
+
+    const size_t n = wspec.fft_size;
+    const size_t hop = wspec.hop ? wspec.hop : n / 4;
+    PcmRealFft fft(n);
+    std::vector<float> window;
+    wavspec_window(wspec.window, n, window);
+
+    // the number of rows, if known in advance
+    uint64_t units = reader.remaining_units();
+    uint64_t expected = 0;
+    if (units != PCM_WAVE_SIZE_UNKNOWN && units >= n)
+        expected = (units - n) / hop + 1;
+
+    int64_t header_pos = -1;
+    if (wspec.format == WSPEC_FORMAT_NPY)
+    {
+        if (units == PCM_WAVE_SIZE_UNKNOWN)
+        {
+            if (!pcm_wave_is_seekable(fout))
+            {
+                pcm_wave_message("ERROR: %s: .npy needs the length or a seekable output.\n", out);
+                return false;
+            }
+            header_pos = pcm_wave_ftell(fout);
+        }
+        if (!write_npy_header(fout, expected, fft.num_bins()))
+        {
+            pcm_wave_message("ERROR: %s: Unable to write.\n", out);
+            return false;
+        }
+    }
+
+    auto t0 = std::chrono::steady_clock::now();
+
+    std::vector<float> samples, rows;
+    PcmWave block;
+    uint64_t total = 0, read_units = 0;
+    size_t skip = 0;    // samples to drop before the next frame, if hop > n
+    bool flag = true;
+    while (flag && reader.read(block, WSPEC_BLOCK_UNITS) > 0)
+    {
+        read_units += block.num_units();
+        append_samples(block, wspec.channel, samples);
+        if (skip)
+        {
+            size_t count = (skip < samples.size()) ? skip : samples.size();
+            samples.erase(samples.begin(), samples.begin() + count);
+            skip -= count;
+        }
+
+        size_t avail = (samples.size() >= n) ? (samples.size() - n) / hop + 1 : 0;
+        size_t done = 0;
+        while (done < avail)
+        {
+            size_t count = avail - done;
+            if (count > WSPEC_BATCH)
+                count = WSPEC_BATCH;
+
+            compute_rows(fft, window, &samples[done * hop], count, hop, wspec.db, rows);
+            if (!fwrite(&rows[0], rows.size() * sizeof(float), 1, fout))
+            {
+                flag = false;
+                break;
+            }
+            done += count;
+        }
+
+        // keep the samples that later frames still need
+        total += done;
+        skip = done * hop;
+        size_t count = (skip < samples.size()) ? skip : samples.size();
+        samples.erase(samples.begin(), samples.begin() + count);
+        skip -= count;
+    }
+
+    if (flag && header_pos >= 0)
+    {
+        int64_t end = pcm_wave_ftell(fout);
+        flag = pcm_wave_fseek(fout, header_pos, SEEK_SET) == 0 &&
+               write_npy_header(fout, total, fft.num_bins()) &&
+               pcm_wave_fseek(fout, end, SEEK_SET) == 0;
+    }
+    if (!flag)
+    {
+        pcm_wave_message("ERROR: %s: Unable to write.\n", out);
+        return false;
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - t0;
+    double seconds = double(read_units) / header.sample_rate();
+    pcm_wave_message("%s: %llu x %lu float32 (%.3f seconds, %.0fx real time)\n", out,
+                     (unsigned long long)total, (unsigned long)fft.num_bins(), elapsed.count(),
+                     elapsed.count() > 0 ? seconds / elapsed.count() : 0.0);
+    pcm_wave_message("'%s' --> '%s' (OK)\n", in, out);
+    return true;
+}
+
+bool wavspec(const char *wav_file, const char *out_file, const WSPEC& wspec)
+{
+    FILE *fin, *fout;
+
+    assert(wav_file);
+    fin = pcm_wave_fopen(wav_file, "rb");
+    if (!fin)
+    {
+        pcm_wave_message("ERROR: Unable to open file '%s'.\n", wav_file);
+        return false;
+    }
+
+    char out_name[256];
+    if (!out_file)
+    {
+        if (strcmp(wav_file, "-") == 0)
+        {
+            out_file = "-";
+        }
+        else
+        {
+            strcpy(out_name, wav_file);
+            strcat(out_name, (wspec.format == WSPEC_FORMAT_NPY) ? ".npy" : ".f32");
+            out_file = out_name;
+        }
+    }
+
+    fout = pcm_wave_fopen(out_file, "wb");
+    if (!fout)
+    {
+        pcm_wave_message("ERROR: Unable to open file '%s'.\n", out_file);
+        pcm_wave_fclose(fin);
+        return false;
+    }
+
+    bool ret = wavspec_fp(wav_file, out_file, fin, fout, wspec);
+
+    pcm_wave_fclose(fout);
+    pcm_wave_fclose(fin);
+
+    return ret;
+}
@@ -0,0 +1,35 @@
+#ifndef WAVSPEC_HPP_
+#define WAVSPEC_HPP_
+
+#include <cstdio>
+#include <vector>
+
+#define WSPEC_BLOCK_UNITS   (256 * 1024)    // frames per read
+#define WSPEC_BATCH         1024            // STFT frames per parallel batch
+#define WSPEC_GRAIN         16              // STFT frames per thread task
+
+#define WSPEC_WINDOW_RECT       0
+#define WSPEC_WINDOW_HANN       1
+#define WSPEC_WINDOW_HAMMING    2
+#define WSPEC_WINDOW_BLACKMAN   3
+
+#define WSPEC_FORMAT_RAW    0   // float32 rows, no header
+#define WSPEC_FORMAT_NPY    1   // NumPy .npy, float32 (frames, bins)
+
+struct WSPEC
+{
+    int fft_size = 1024;    // power of two
+    int hop = 0;            // fft_size / 4 if zero
+    int window = WSPEC_WINDOW_HANN;
+    int channel = -1;       // mix all channels if negative
+    int format = WSPEC_FORMAT_NPY;
+    bool db = false;        // 20 * log10(magnitude)
+    PcmWaveTime start;      // from the beginning if empty
+    PcmWaveTime end;        // to the end if empty
+};
+
+bool wavspec_window(int window, size_t size, std::vector<float>& w);
+bool wavspec_fp(const char *in, const char *out, FILE *fin, FILE *fout, const WSPEC& wspec);
+bool wavspec(const char *wav_file, const char *out_file, const WSPEC& wspec);
+
+#endif  // ndef WAVSPEC_HPP_
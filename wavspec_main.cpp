@@ -0,0 +1,182 @@
+#include "PcmWave.hpp"
+#include "PcmFft.hpp"
+#include "wavspec.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static void show_help(void)
+{
+    printf("wavspec --- Computes the spectrogram (STFT magnitudes) of a wave file\n");
+    printf("Usage: wavspec [options] sound-file.wav [output.npy]\n");
+    printf("Use '-' for stdin/stdout.\n");
+    printf("Options:\n");
+    printf("--help          Show this help.\n");
+    printf("--version       Show version info.\n");
+    printf("--fft XXX       FFT size, a power of two (default: 1024).\n");
+    printf("--hop XXX       Hop size in samples (default: FFT size / 4).\n");
+    printf("--window XXX    rect, hann, hamming or blackman (default: hann).\n");
+    printf("--channel XXX   Use one channel (default: mix all channels).\n");
+    printf("--format XXX    npy or raw (float32 rows) (default: npy).\n");
+    printf("--db            Output 20 * log10(magnitude).\n");
+    printf("--start TIME    Start position in seconds, or frames with 'f' suffix.\n");
+    printf("--end TIME      End position in seconds, or frames with 'f' suffix.\n");
+}
+
+static void show_version(void)
+{
+    printf("wavspec version 0.1 by katahiromz\n");
+}
+
+int main(int argc, char **argv)
+{
+    pcm_wave_messages() = stderr;    // the library is quiet otherwise
+
+    WSPEC wspec;
+
+    if (argc <= 1)
+    {
+        show_help();
+        return EXIT_SUCCESS;
+    }
+
+    const char *arg1 = NULL;
+    const char *arg2 = NULL;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (argv[i][0] == '-' && argv[i][1] != 0)
+        {
+            if (strcmp(argv[i], "--help") == 0)
+            {
+                show_help();
+                return EXIT_SUCCESS;
+            }
+            if (strcmp(argv[i], "--version") == 0)
+            {
+                show_version();
+                return EXIT_SUCCESS;
+            }
+            if (strcmp(argv[i], "--db") == 0)
+            {
+                wspec.db = true;
+                continue;
+            }
+            if (strcmp(argv[i], "--fft") == 0 || strcmp(argv[i], "--hop") == 0 ||
+                strcmp(argv[i], "--channel") == 0)
+            {
+                if (i + 1 >= argc)
+                {
+                    fprintf(stderr, "ERROR: No parameter for '%s'.\n", argv[i]);
+                    return EXIT_FAILURE;
+                }
+                const char *name = argv[i];
+                ++i;
+                int value = (int)strtoul(argv[i], NULL, 0);
+                bool ok;
+                if (strcmp(name, "--fft") == 0)
+                {
+                    wspec.fft_size = value;
+                    ok = PcmRealFft::is_valid_size(value) && value <= (1 << 24);
+                }
+                else if (strcmp(name, "--hop") == 0)
+                {
+                    wspec.hop = value;
+                    ok = value > 0 && value <= (1 << 24);
+                }
+                else
+                {
+                    wspec.channel = value;
+                    ok = value >= 0;
+                }
+                if (!ok)
+                {
+                    fprintf(stderr, "ERROR: Invalid parameter '%s'.\n", argv[i]);
+                    return EXIT_FAILURE;
+                }
+                continue;
+            }
+            if (strcmp(argv[i], "--window") == 0)
+            {
+                if (i + 1 >= argc)
+                {
+                    fprintf(stderr, "ERROR: No parameter for '%s'.\n", argv[i]);
+                    return EXIT_FAILURE;
+                }
+                ++i;
+                if (strcmp(argv[i], "rect") == 0)
+                    wspec.window = WSPEC_WINDOW_RECT;
+                else if (strcmp(argv[i], "hann") == 0)
+                    wspec.window = WSPEC_WINDOW_HANN;
+                else if (strcmp(argv[i], "hamming") == 0)
+                    wspec.window = WSPEC_WINDOW_HAMMING;
+                else if (strcmp(argv[i], "blackman") == 0)
+                    wspec.window = WSPEC_WINDOW_BLACKMAN;
+                else
+                {
+                    fprintf(stderr, "ERROR: Invalid parameter '%s'.\n", argv[i]);
+                    return EXIT_FAILURE;
+                }
+                continue;
+            }
+            if (strcmp(argv[i], "--format") == 0)
+            {
+                if (i + 1 >= argc)
+                {
+                    fprintf(stderr, "ERROR: No parameter for '%s'.\n", argv[i]);
+                    return EXIT_FAILURE;
+                }
+                ++i;
+                if (strcmp(argv[i], "npy") == 0)
+                    wspec.format = WSPEC_FORMAT_NPY;
+                else if (strcmp(argv[i], "raw") == 0)
+                    wspec.format = WSPEC_FORMAT_RAW;
+                else
+                {
+                    fprintf(stderr, "ERROR: Invalid parameter '%s'.\n", argv[i]);
+                    return EXIT_FAILURE;
+                }
+                continue;
+            }
+            if (strcmp(argv[i], "--start") == 0 || strcmp(argv[i], "--end") == 0)
+            {
+                if (i + 1 >= argc)
+                {
+                    fprintf(stderr, "ERROR: No parameter for '%s'.\n", argv[i]);
+                    return EXIT_FAILURE;
+                }
+                PcmWaveTime& time = (argv[i][2] == 's') ? wspec.start : wspec.end;
+                ++i;
+                if (!time.parse(argv[i]))
+                {
+                    fprintf(stderr, "ERROR: Invalid parameter '%s'.\n", argv[i]);
+                    return EXIT_FAILURE;
+                }
+                continue;
+            }
+
+            fprintf(stderr, "ERROR: Invalid argument '%s'.\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+        if (arg1 == NULL)
+        {
+            arg1 = argv[i];
+        }
+        else if (arg2 == NULL)
+        {
+            arg2 = argv[i];
+        }
+        else
+        {
+            fprintf(stderr, "ERROR: Too many argument.\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (arg1 == NULL)
+    {
+        fprintf(stderr, "ERROR: No input file.\n");
+        return EXIT_FAILURE;
+    }
+
+    return wavspec(arg1, arg2, wspec) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,420 @@
+#include "PcmWave.hpp"
+#include "PcmSimd.hpp"
+#include "PcmParallel.hpp"
+#include "wavstat.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <chrono>
+
+void WavStatChannel::add(const WavStatChannel& other)
+{
+    if (min > other.min)
+        min = other.min;
+    if (max < other.max)
+        max = other.max;
+    clips += other.clips;
+    sum += other.sum;
+    sum2 += other.sum2;
+    count += other.count;
+    if (histogram.size() < other.histogram.size())
+        histogram.resize(other.histogram.size());
+    for (size_t i = 0; i < other.histogram.size(); ++i)
+    {
+        histogram[i] += other.histogram[i];
+    }
+}
+
+static inline void
+stat_sample(WavStatChannel& st, int value, int lo, int hi)
+{
+    if (st.min > value)
+        st.min = value;
+    if (st.max < value)
+        st.max = value;
+    if (value == lo || value == hi)
+        ++st.clips;
+    st.sum += value;
+    st.sum2 += uint32_t(value * value);
+    ++st.count;
+}
+
+#ifdef PCM_SIMD_SSE2
+    // Lane accumulators for interleaved mono or stereo. Lane k of every
+    // register belongs to channel (k % channels).
+    struct StatLanes
+    {
+        __m128i vmin, vmax;     // 8 x int16
+        __m128i sum32;          // 4 x int32, flushed before overflow
+        __m128i sum64;          // 2 x uint64 sum of squares
+        __m128i clip16;         // 8 x uint16, flushed before overflow
+        __m128i lo, hi;         // the lowest and highest codes
+        int64_t sum[4];
+        uint64_t clips[8];
+        int pending;
+
+        StatLanes(int lo_, int hi_)
+        {
+            vmin = _mm_set1_epi16(32767);
+            vmax = _mm_set1_epi16(-32768);
+            sum32 = sum64 = clip16 = _mm_setzero_si128();
+            lo = _mm_set1_epi16(int16_t(lo_));
+            hi = _mm_set1_epi16(int16_t(hi_));
+            memset(sum, 0, sizeof(sum));
+            memset(clips, 0, sizeof(clips));
+            pending = 0;
+        }
+
+        void flush()
+        {
+            int32_t s[4];
+            uint16_t c[8];
+            _mm_storeu_si128((__m128i *)s, sum32);
+            _mm_storeu_si128((__m128i *)c, clip16);
+            for (int k = 0; k < 4; ++k)
+                sum[k] += s[k];
+            for (int k = 0; k < 8; ++k)
+                clips[k] += c[k];
+            sum32 = clip16 = _mm_setzero_si128();
+            pending = 0;
+        }
+
+        void add(__m128i v)
+        {
+            const __m128i zero = _mm_setzero_si128();
+            vmin = _mm_min_epi16(vmin, v);
+            vmax = _mm_max_epi16(vmax, v);
+
+            // lanes k and k + 4 belong to the same channel
+            __m128i a = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+            __m128i b = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+            sum32 = _mm_add_epi32(sum32, _mm_add_epi32(a, b));
+
+            // squares; lanes k and k + 2 of 32-bit lanes belong to the same channel
+            __m128i ml = _mm_mullo_epi16(v, v);
+            __m128i mh = _mm_mulhi_epi16(v, v);
+            __m128i sq = _mm_add_epi32(_mm_unpacklo_epi16(ml, mh), _mm_unpackhi_epi16(ml, mh));
+            sum64 = _mm_add_epi64(sum64, _mm_unpacklo_epi32(sq, zero));
+            sum64 = _mm_add_epi64(sum64, _mm_unpackhi_epi32(sq, zero));
+
+            __m128i clip = _mm_or_si128(_mm_cmpeq_epi16(v, lo), _mm_cmpeq_epi16(v, hi));
+            clip16 = _mm_sub_epi16(clip16, clip);
+
+            if (++pending == 16384)
+                flush();
+        }
+
+        void finish(std::vector<WavStatChannel>& stats, int channels, size_t samples)
+        {
+            flush();
+
+            int16_t mins[8], maxs[8];
+            uint64_t sums2[2];
+            _mm_storeu_si128((__m128i *)mins, vmin);
+            _mm_storeu_si128((__m128i *)maxs, vmax);
+            _mm_storeu_si128((__m128i *)sums2, sum64);
+            for (int k = 0; k < 8; ++k)
+            {
+                WavStatChannel& st = stats[k % channels];
+                if (st.min > mins[k])
+                    st.min = mins[k];
+                if (st.max < maxs[k])
+                    st.max = maxs[k];
+                st.clips += clips[k];
+                if (k < 4)
+                    st.sum += sum[k];
+                if (k < 2)
+                    st.sum2 += sums2[k];
+            }
+            for (int ch = 0; ch < channels; ++ch)
+            {
+                stats[ch].count += samples / channels;
+            }
+        }
+    };
+#endif
+
+// the statistics of the frames [begin, end) of block
+static void
+scan_range(const PcmWave& block, size_t begin, size_t end,
+           std::vector<WavStatChannel>& stats, int bins)
+{
+    const int channels = block.num_channels();
+    const bool is8 = block.mode_8bit();
+    const int lo = is8 ? -128 : -32768;
+    const int hi = is8 ? 127 : 32767;
+    const size_t count = (end - begin) * channels;
+    const size_t first = begin * channels;
+
+    size_t i = 0;
+#ifdef PCM_SIMD_SSE2
+    if (channels == 1 || channels == 2)
+    {
+        StatLanes lanes(lo, hi);
+        if (is8)
+        {
+            const uint8_t *data = &block.data_8bit(first);
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i bias = _mm_set1_epi16(128);
+            for (; i + 16 <= count; i += 16)
+            {
+                __m128i v = _mm_loadu_si128((const __m128i *)(data + i));
+                lanes.add(_mm_sub_epi16(_mm_unpacklo_epi8(v, zero), bias));
+                lanes.add(_mm_sub_epi16(_mm_unpackhi_epi8(v, zero), bias));
+            }
+        }
+        else
+        {
+            const int16_t *data = &block.data_16bit(first);
+            for (; i + 8 <= count; i += 8)
+            {
+                lanes.add(_mm_loadu_si128((const __m128i *)(data + i)));
+            }
+        }
+        lanes.finish(stats, channels, i);
+    }
+#endif
+
+    for (; i < count; ++i)
+    {
+        int value = is8 ? int(block.data_8bit(first + i)) - 128 : block.data_16bit(first + i);
+        stat_sample(stats[i % channels], value, lo, hi);
+    }
+
+    if (bins > 0)
+    {
+        // bins are equal slices of [lo, hi]
+        const int64_t range = int64_t(hi) - lo + 1;
+        for (int ch = 0; ch < channels; ++ch)
+        {
+            stats[ch].histogram.resize(bins);
+        }
+        for (i = 0; i < count; ++i)
+        {
+            int value = is8 ? int(block.data_8bit(first + i)) - 128 : block.data_16bit(first + i);
+            ++stats[i % channels].histogram[size_t((int64_t(value) - lo) * bins / range)];
+        }
+    }
+}
+
+// accumulates the statistics of a block, in parallel over frame ranges
+bool wavstat_scan(const PcmWave& block, std::vector<WavStatChannel>& stats, int bins)
+{
+    if (!block.mode_8bit() && !block.mode_16bit())
+        return false;
+
+    const int channels = block.num_channels();
+    if (stats.size() < size_t(channels))
+        stats.resize(channels);
+
+    size_t units = size_t(block.num_units());
+    std::vector<std::vector<WavStatChannel> > parts(pcm_parallel_num_chunks(units, WSTAT_GRAIN));
+    pcm_parallel_for(units, WSTAT_GRAIN, [&](size_t chunk, size_t begin, size_t end)
+    {
+        parts[chunk].resize(channels);
+        scan_range(block, begin, end, parts[chunk], bins);
+    });
+
+    // in chunk order, so the result does not depend on the threads
+    for (auto& part : parts)
+    {
+        for (int ch = 0; ch < channels; ++ch)
+        {
+            stats[ch].add(part[ch]);
+        }
+    }
+    return true;
+}
+
+static double to_dbfs(double ratio)
+{
+    if (ratio <= 0)
+        return -INFINITY;
+    return 20 * std::log10(ratio);
+}
+
+static void print_text(FILE *fout, const char *in, const PcmWave& header,
+                       const std::vector<WavStatChannel>& stats, const WSTAT& wstat)
+{
+    const bool is8 = header.mode_8bit();
+    const double full = is8 ? 128 : 32768;
+    const int bias = is8 ? 128 : 0;
+
+    uint64_t frames = stats.empty() ? 0 : stats[0].count;
+    fprintf(fout, "%s: %lu Hz sampling, %d-bit, %d channel, %llu frames (%.2f seconds)\n",
+            in, (unsigned long)header.sample_rate(), header.mode(), header.num_channels(),
+            (unsigned long long)frames, double(frames) / header.sample_rate());
+
+    for (size_t ch = 0; ch < stats.size(); ++ch)
+    {
+        const WavStatChannel& st = stats[ch];
+        if (st.count == 0)
+            continue;
+        double dc = double(st.sum) / st.count;
+        double rms = std::sqrt(double(st.sum2) / st.count);
+        int peak = (-st.min > st.max) ? -st.min : st.max;
+
+        fprintf(fout, "channel %d:\n", int(ch));
+        fprintf(fout, "  min:        %d\n", st.min + bias);
+        fprintf(fout, "  max:        %d\n", st.max + bias);
+        fprintf(fout, "  peak:       %.2f dBFS\n", to_dbfs(peak / full));
+        fprintf(fout, "  rms:        %.2f dBFS\n", to_dbfs(rms / full));
+        fprintf(fout, "  dc offset:  %.3f (%.4f%%)\n", dc, 100 * dc / full);
+        fprintf(fout, "  clips:      %llu\n", (unsigned long long)st.clips);
+        if (wstat.bins > 0)
+        {
+            fprintf(fout, "  histogram:");
+            for (size_t i = 0; i < st.histogram.size(); ++i)
+            {
+                fprintf(fout, " %llu", (unsigned long long)st.histogram[i]);
+            }
+            fprintf(fout, "\n");
+        }
+    }
+}
+
+static void print_json_number(FILE *fout, double value)
+{
+    // JSON has no infinity
+    if (std::isfinite(value))
+        fprintf(fout, "%.4f", value);
+    else
+        fprintf(fout, "null");
+}
+
+static void print_json(FILE *fout, const char *in, const PcmWave& header,
+                       const std::vector<WavStatChannel>& stats, const WSTAT& wstat)
+{
+    const bool is8 = header.mode_8bit();
+    const double full = is8 ? 128 : 32768;
+    const int bias = is8 ? 128 : 0;
+
+    uint64_t frames = stats.empty() ? 0 : stats[0].count;
+    fprintf(fout, "{\n");
+    fprintf(fout, "  \"file\": \"");
+    for (const char *pch = in; *pch; ++pch)
+    {
+        if (*pch == '"' || *pch == '\\')
+            fputc('\\', fout);
+        fputc(*pch, fout);
+    }
+    fprintf(fout, "\",\n");
+    fprintf(fout, "  \"sample_rate\": %lu,\n", (unsigned long)header.sample_rate());
+    fprintf(fout, "  \"bits_per_sample\": %d,\n", header.mode());
+    fprintf(fout, "  \"frames\": %llu,\n", (unsigned long long)frames);
+    fprintf(fout, "  \"seconds\": %.6f,\n", double(frames) / header.sample_rate());
+    fprintf(fout, "  \"channels\": [\n");
+    for (size_t ch = 0; ch < stats.size(); ++ch)
+    {
+        const WavStatChannel& st = stats[ch];
+        double dc = st.count ? double(st.sum) / st.count : 0;
+        double rms = st.count ? std::sqrt(double(st.sum2) / st.count) : 0;
+        int peak = st.count ? ((-st.min > st.max) ? -st.min : st.max) : 0;
+
+        fprintf(fout, "    {\n");
+        fprintf(fout, "      \"min\": %d,\n", st.count ? st.min + bias : 0);
+        fprintf(fout, "      \"max\": %d,\n", st.count ? st.max + bias : 0);
+        fprintf(fout, "      \"peak_dbfs\": ");
+        print_json_number(fout, to_dbfs(peak / full));
+        fprintf(fout, ",\n      \"rms_dbfs\": ");
+        print_json_number(fout, to_dbfs(rms / full));
+        fprintf(fout, ",\n      \"dc_offset\": ");
+        print_json_number(fout, dc);
+        fprintf(fout, ",\n      \"clips\": %llu", (unsigned long long)st.clips);
+        if (wstat.bins > 0)
+        {
+            fprintf(fout, ",\n      \"histogram\": [");
+            for (size_t i = 0; i < st.histogram.size(); ++i)
+            {
+                fprintf(fout, "%s%llu", (i ? ", " : ""), (unsigned long long)st.histogram[i]);
+            }
+            fprintf(fout, "]");
+        }
+        fprintf(fout, "\n    }%s\n", (ch + 1 < stats.size()) ? "," : "");
+    }
+    fprintf(fout, "  ]\n");
+    fprintf(fout, "}\n");
+}
+
+bool wavstat_fp(const char *in, FILE *fin, FILE *fout, const WSTAT& wstat)
+{
+    PcmWaveReader reader;
+    if (!reader.open(fin))
+    {
+        pcm_wave_message("ERROR: %s: unable to read\n", in);
+        return false;
+    }
+
+    const PcmWave& header = reader.header();
+    if (!header.mode_8bit() && !header.mode_16bit())
+    {
+        pcm_wave_message("ERROR: %s: %d-bit is not supported.\n", in, header.mode());
+        return false;
+    }
+
+    if (!wstat.start.empty() || !wstat.end.empty())
+    {
+        uint32_t rate = header.sample_rate();
+        uint64_t begin = wstat.start.empty() ? 0 : wstat.start.to_units(rate);
+        if (!reader.seek_range(begin, wstat.end.to_units(rate)))
+        {
+            pcm_wave_message("ERROR: %s: Invalid range.\n", in);
+            return false;
+        }
+    }
+
+    auto t0 = std::chrono::steady_clock::now();
+
+    std::vector<WavStatChannel> stats(header.num_channels());
+    PcmWave block;
+    while (reader.read(block, WSTAT_BLOCK_UNITS) > 0)
+    {
+        wavstat_scan(block, stats, wstat.bins);
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - t0;
+    double seconds = double(stats[0].count) / header.sample_rate();
+    if (elapsed.count() > 0)
+    {
+        pcm_wave_message("%s: %.3f seconds (%.0fx real time)\n", in,
+                         elapsed.count(), seconds / elapsed.count());
+    }
+
+    if (wstat.json)
+        print_json(fout, in, header, stats, wstat);
+    else
+        print_text(fout, in, header, stats, wstat);
+
+    return true;
+}
+
+bool wavstat(const char *wav_file, const char *out_file, const WSTAT& wstat)
+{
+    FILE *fin, *fout;
+
+    assert(wav_file);
+    fin = pcm_wave_fopen(wav_file, "rb");
+    if (!fin)
+    {
+        pcm_wave_message("ERROR: Unable to open file '%s'.\n", wav_file);
+        return false;
+    }
+
+    if (!out_file)
+        out_file = "-";
+
+    fout = pcm_wave_fopen(out_file, "w");
+    if (!fout)
+    {
+        pcm_wave_message("ERROR: Unable to open file '%s'.\n", out_file);
+        pcm_wave_fclose(fin);
+        return false;
+    }
+
+    bool ret = wavstat_fp(wav_file, fin, fout, wstat);
+
+    pcm_wave_fclose(fout);
+    pcm_wave_fclose(fin);
+
+    return ret;
+}
@@ -0,0 +1,38 @@
+#ifndef WAVSTAT_HPP_
+#define WAVSTAT_HPP_
+
+#include <cstdio>
+#include <vector>
+#include <climits>
+
+#define WSTAT_BLOCK_UNITS   (1024 * 1024)   // frames per read
+#define WSTAT_GRAIN         (64 * 1024)     // frames per thread task
+#define WSTAT_BINS          16              // default histogram bins
+
+// statistics of one channel. Values are centered (8-bit minus 128).
+struct WavStatChannel
+{
+    int min = INT_MAX;
+    int max = INT_MIN;
+    uint64_t clips = 0;     // samples at the lowest or highest code
+    int64_t sum = 0;
+    uint64_t sum2 = 0;
+    uint64_t count = 0;
+    std::vector<uint64_t> histogram;
+
+    void add(const WavStatChannel& other);
+};
+
+struct WSTAT
+{
+    bool json = false;
+    int bins = WSTAT_BINS;  // no histogram if zero
+    PcmWaveTime start;      // from the beginning if empty
+    PcmWaveTime end;        // to the end if empty
+};
+
+bool wavstat_scan(const PcmWave& block, std::vector<WavStatChannel>& stats, int bins);
+bool wavstat_fp(const char *in, FILE *fin, FILE *fout, const WSTAT& wstat);
+bool wavstat(const char *wav_file, const char *out_file, const WSTAT& wstat);
+
+#endif  // ndef WAVSTAT_HPP_
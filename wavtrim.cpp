@@ -0,0 +1,418 @@
+#include "PcmWave.hpp"
+#include "PcmSimd.hpp"
+#include "PcmParallel.hpp"
+#include "wavtrim.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <chrono>
+#include <string>
+
+// The level of each window of block relative to full scale: the peak or
+// the RMS of all its samples. The windows are scanned in parallel.
+bool wavtrim_levels(const PcmWave& block, size_t window, int detect, std::vector<float>& levels)
+{
+    if (!block.mode_8bit() && !block.mode_16bit())
+        return false;
+    if (window == 0)
+        window = 1;
+
+    const size_t units = size_t(block.num_units());
+    const size_t channels = block.num_channels();
+    const uint16_t bits = block.mode();
+    levels.resize((units + window - 1) / window);
+    pcm_parallel_for(levels.size(), WTRIM_GRAIN, [&](size_t, size_t begin, size_t end)
+    {
+        for (size_t w = begin; w < end; ++w)
+        {
+            size_t first = w * window;
+            size_t count = ((units - first < window) ? units - first : window) * channels;
+            PcmLevel level;
+            if (bits == 8)
+                pcm_scan_8bit(&block.data_8bit(first * channels), count, level);
+            else
+                pcm_scan_16bit(&block.data_16bit(first * channels), count, level);
+            double ratio = (detect == WTRIM_DETECT_RMS) ? level.rms_ratio(bits)
+                                                        : level.peak_ratio(bits);
+            levels[w] = float(ratio);
+        }
+    });
+    return true;
+}
+
+// Silence inside a segment, held until the sound resumes or the segment
+// ends. Above WTRIM_HOLD_BYTES it spills to a temporary file.
+class WavTrimHold
+{
+public:
+    WavTrimHold() : m_spill(NULL), m_spilled(0)
+    {
+    }
+
+    ~WavTrimHold()
+    {
+        if (m_spill)
+            fclose(m_spill);
+    }
+
+    bool add(const uint8_t *data, size_t size)
+    {
+        if (m_memory.size() + size <= WTRIM_HOLD_BYTES)
+        {
+            m_memory.insert(m_memory.end(), data, data + size);
+            return true;
+        }
+
+        if (!m_spill && !(m_spill = tmpfile()))
+            return false;
+        if (!m_memory.empty() &&
+            fwrite(&m_memory[0], 1, m_memory.size(), m_spill) != m_memory.size())
+        {
+            return false;
+        }
+        m_spilled += m_memory.size();
+        m_memory.clear();
+        if (size && fwrite(data, 1, size, m_spill) != size)
+            return false;
+        m_spilled += size;
+        return true;
+    }
+
+    bool flush(PcmWaveWriter& writer)
+    {
+        bool ok = true;
+        if (m_spilled)
+        {
+            ok = (fseek(m_spill, 0, SEEK_SET) == 0);
+            std::vector<uint8_t> buffer(1024 * 1024);
+            for (uint64_t left = m_spilled; ok && left > 0; )
+            {
+                size_t n = (left < buffer.size()) ? size_t(left) : buffer.size();
+                ok = fread(&buffer[0], 1, n, m_spill) == n && writer.write(&buffer[0], n);
+                left -= n;
+            }
+        }
+        if (ok && !m_memory.empty())
+            ok = writer.write(&m_memory[0], m_memory.size());
+        clear();
+        return ok;
+    }
+
+    void clear()
+    {
+        m_memory.clear();
+        if (m_spilled)
+            fseek(m_spill, 0, SEEK_SET);
+        m_spilled = 0;
+    }
+
+protected:
+    std::vector<uint8_t> m_memory;
+    FILE *m_spill;
+    uint64_t m_spilled;     // bytes in m_spill, before m_memory
+};
+
+// "out.wav" --> "out-001.wav"
+static std::string segment_name(const char *out, int index)
+{
+    std::string name = out;
+    size_t slash = name.find_last_of("/\\");
+    size_t dot = name.rfind('.');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+        dot = name.size();
+
+    char number[32];
+    sprintf(number, "-%03d", index);
+    return name.substr(0, dot) + number + name.substr(dot);
+}
+
+// The detector, window by window. Outside a segment, a window at or above
+// the threshold starts one. Inside it, only windows below the threshold
+// minus the hysteresis count as quiet, and min_silence of them end it
+// (--split) or they are held until the sound resumes. pad frames are kept
+// before and after each segment.
+class WavTrimmer
+{
+public:
+    WavTrimmer(const char *in, const char *out, const WTRIM& wtrim, const PcmWave& header,
+               std::vector<WavTrimSegment>& segments)
+        : m_in(in), m_out(out), m_split(wtrim.split), m_header(header),
+          m_unit(header.data_unit()), m_segments(segments), m_fp(NULL), m_index(0),
+          m_in_segment(false), m_pos(0), m_quiet(0), m_padded(0), m_loud_end(0)
+    {
+        uint32_t rate = header.sample_rate();
+        m_pad = wtrim.pad.empty() ? uint64_t(WTRIM_PAD * rate) : wtrim.pad.to_units(rate);
+        m_min_silence = wtrim.min_silence.empty() ? uint64_t(WTRIM_MIN_SILENCE * rate)
+                                                  : wtrim.min_silence.to_units(rate);
+        m_open = float(std::pow(10.0, wtrim.threshold / 20));
+        m_close = float(std::pow(10.0, (wtrim.threshold - wtrim.hysteresis) / 20));
+    }
+
+    ~WavTrimmer()
+    {
+        if (m_fp)
+            pcm_wave_fclose(m_fp);
+    }
+
+    // opens the one output without --split
+    bool start()
+    {
+        if (!m_out || m_split)
+            return true;
+        return open_output(m_out);
+    }
+
+    bool window(const uint8_t *data, size_t frames, float level)
+    {
+        bool ok = true;
+        if (!m_in_segment)
+        {
+            if (level >= m_open)
+            {
+                ok = begin_segment() && write(data, frames);
+                m_loud_end = m_pos + frames;
+            }
+            else
+            {
+                keep_preroll(data, frames);
+            }
+        }
+        else if (level >= m_close)
+        {
+            if (m_quiet)
+            {
+                ok = !m_out || m_hold.flush(m_writer);
+                m_quiet = m_padded = 0;
+            }
+            ok = ok && write(data, frames);
+            m_loud_end = m_pos + frames;
+        }
+        else
+        {
+            // the first pad frames of a silence are kept in any case
+            m_quiet += frames;
+            size_t padding = (m_pad - m_padded < frames) ? size_t(m_pad - m_padded) : frames;
+            ok = write(data, padding);
+            m_padded += padding;
+            if (m_out && ok)
+                ok = m_hold.add(data + padding * m_unit, (frames - padding) * m_unit);
+
+            if (ok && m_split && m_quiet >= m_min_silence)
+            {
+                ok = end_segment();
+                keep_preroll(data, frames);
+            }
+        }
+
+        m_pos += frames;
+        if (!ok)
+            pcm_wave_message("ERROR: %s: Unable to write.\n", m_name.c_str());
+        return ok;
+    }
+
+    bool finish()
+    {
+        bool ok = true;
+        if (m_in_segment)
+            ok = end_segment();
+        if (ok && m_fp)
+            ok = close_output();
+        return ok;
+    }
+
+protected:
+    const char *m_in;
+    const char *m_out;      // NULL if only listing
+    bool m_split;
+    const PcmWave& m_header;
+    const uint16_t m_unit;
+    std::vector<WavTrimSegment>& m_segments;
+    uint64_t m_pad;
+    uint64_t m_min_silence;
+    float m_open;
+    float m_close;
+
+    PcmWaveWriter m_writer;
+    FILE *m_fp;
+    std::string m_name;
+    int m_index;            // of the last segment file
+
+    bool m_in_segment;
+    uint64_t m_pos;         // the first frame of the window
+    uint64_t m_begin;       // the first frame of the segment
+    std::vector<uint8_t> m_preroll;     // the last pad frames outside a segment
+    uint64_t m_quiet;       // frames of the current silence in the segment
+    uint64_t m_padded;      // frames of it written as pad
+    uint64_t m_loud_end;    // the frame after the last loud window
+    WavTrimHold m_hold;
+
+    bool open_output(const std::string& name)
+    {
+        m_name = name;
+        m_fp = pcm_wave_fopen(name.c_str(), "wb");
+        if (!m_fp)
+        {
+            pcm_wave_message("ERROR: Unable to open file '%s'.\n", name.c_str());
+            return false;
+        }
+        if (!m_writer.open(m_fp, m_header.num_channels(), m_header.mode(), m_header.sample_rate()))
+        {
+            pcm_wave_message("ERROR: %s: Unable to write.\n", name.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    bool close_output()
+    {
+        bool ok = m_writer.close();
+        pcm_wave_fclose(m_fp);
+        m_fp = NULL;
+        if (!ok)
+        {
+            pcm_wave_message("ERROR: %s: Unable to write.\n", m_name.c_str());
+            return false;
+        }
+        pcm_wave_show_info(m_name.c_str(), m_writer.header());
+        pcm_wave_message("'%s' --> '%s' (OK)\n", m_in, m_name.c_str());
+        return true;
+    }
+
+    bool write(const uint8_t *data, size_t frames)
+    {
+        if (!m_out || frames == 0)
+            return true;
+        return m_writer.write(data, frames * m_unit);
+    }
+
+    void keep_preroll(const uint8_t *data, size_t frames)
+    {
+        size_t limit = size_t(m_pad) * m_unit;
+        size_t size = frames * m_unit;
+        if (size >= limit)
+        {
+            m_preroll.assign(data + size - limit, data + size);
+            return;
+        }
+        m_preroll.insert(m_preroll.end(), data, data + size);
+        if (m_preroll.size() > limit)
+            m_preroll.erase(m_preroll.begin(), m_preroll.end() - limit);
+    }
+
+    bool begin_segment()
+    {
+        uint64_t preroll = m_preroll.size() / m_unit;
+        m_begin = m_pos - preroll;
+        m_in_segment = true;
+        m_quiet = m_padded = 0;
+
+        if (m_out && m_split && !open_output(segment_name(m_out, m_index + 1)))
+            return false;
+        ++m_index;
+        bool ok = preroll == 0 || write(&m_preroll[0], size_t(preroll));
+        m_preroll.clear();
+        return ok;
+    }
+
+    bool end_segment()
+    {
+        WavTrimSegment segment;
+        segment.begin = m_begin;
+        segment.end = m_loud_end + m_padded;
+        m_segments.push_back(segment);
+
+        m_hold.clear();
+        m_in_segment = false;
+        if (m_out && m_split)
+            return close_output();
+        return true;
+    }
+};
+
+bool wavtrim_fp(const char *in, FILE *fin, const char *out, const WTRIM& wtrim,
+                std::vector<WavTrimSegment>& segments)
+{
+    PcmWaveReader reader;
+    if (!reader.open(fin))
+    {
+        pcm_wave_message("ERROR: %s: unable to read\n", in);
+        return false;
+    }
+
+    const PcmWave& header = reader.header();
+    pcm_wave_show_info(in, header);
+    if (!header.mode_8bit() && !header.mode_16bit())
+    {
+        pcm_wave_message("ERROR: %s: %d-bit is not supported.\n", in, header.mode());
+        return false;
+    }
+
+    uint32_t rate = header.sample_rate();
+    size_t window = size_t(wtrim.window.empty() ? WTRIM_WINDOW * rate : wtrim.window.to_units(rate));
+    if (window == 0)
+        window = 1;
+    size_t block_units = window * ((WTRIM_BLOCK_UNITS > window) ? WTRIM_BLOCK_UNITS / window : 1);
+
+    auto t0 = std::chrono::steady_clock::now();
+
+    WavTrimmer trimmer(in, out, wtrim, header, segments);
+    if (!trimmer.start())
+        return false;
+
+    PcmWave block;
+    std::vector<float> levels;
+    uint64_t total = 0;
+    while (size_t units = reader.read(block, block_units))
+    {
+        wavtrim_levels(block, window, wtrim.detect, levels);
+        for (size_t w = 0; w < levels.size(); ++w)
+        {
+            size_t first = w * window;
+            size_t frames = (units - first < window) ? units - first : window;
+            if (!trimmer.window(&block.data_8bit(first * header.data_unit()), frames, levels[w]))
+                return false;
+        }
+        total += units;
+    }
+    if (!trimmer.finish())
+        return false;
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - t0;
+    if (elapsed.count() > 0)
+    {
+        pcm_wave_message("%s: %.3f seconds (%.0fx real time)\n", in,
+                         elapsed.count(), double(total) / rate / elapsed.count());
+    }
+
+    // without an output, list the segments: start, end and length in seconds
+    if (!out)
+    {
+        for (auto& segment : segments)
+        {
+            printf("%.3f\t%.3f\t%.3f\n", double(segment.begin) / rate,
+                   double(segment.end) / rate, double(segment.end - segment.begin) / rate);
+        }
+    }
+    return true;
+}
+
+bool wavtrim(const char *wav_file, const char *out_file, const WTRIM& wtrim)
+{
+    if (wtrim.split && out_file && strcmp(out_file, "-") == 0)
+    {
+        pcm_wave_message("ERROR: '--split' needs an output file name.\n");
+        return false;
+    }
+
+    FILE *fin = pcm_wave_fopen(wav_file, "rb");
+    if (!fin)
+    {
+        pcm_wave_message("ERROR: Unable to open file '%s'.\n", wav_file);
+        return false;
+    }
+
+    std::vector<WavTrimSegment> segments;
+    bool ret = wavtrim_fp(wav_file, fin, out_file, wtrim, segments);
+    pcm_wave_fclose(fin);
+    return ret;
+}
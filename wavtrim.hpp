@@ -0,0 +1,41 @@
+#ifndef WAVTRIM_HPP_
+#define WAVTRIM_HPP_
+
+#include <cstdio>
+#include <vector>
+
+#define WTRIM_BLOCK_UNITS   (1024 * 1024)       // frames per read
+#define WTRIM_GRAIN         256                 // windows per thread task
+#define WTRIM_HOLD_BYTES    (16 * 1024 * 1024)  // held silence kept in memory
+
+#define WTRIM_WINDOW        0.01    // default seconds per detection window
+#define WTRIM_PAD           0.1     // default seconds of silence kept at the ends
+#define WTRIM_MIN_SILENCE   0.5     // default seconds of silence that splits
+
+#define WTRIM_DETECT_PEAK   0
+#define WTRIM_DETECT_RMS    1
+
+struct WTRIM
+{
+    double threshold = -50;     // dBFS where sound starts
+    double hysteresis = 6;      // dB below threshold where silence starts
+    int detect = WTRIM_DETECT_PEAK;
+    PcmWaveTime window;         // WTRIM_WINDOW if empty
+    PcmWaveTime pad;            // WTRIM_PAD if empty
+    PcmWaveTime min_silence;    // WTRIM_MIN_SILENCE if empty
+    bool split = false;         // a file per segment
+};
+
+// a span of sound with its pads, in frames
+struct WavTrimSegment
+{
+    uint64_t begin;
+    uint64_t end;
+};
+
+bool wavtrim_levels(const PcmWave& block, size_t window, int detect, std::vector<float>& levels);
+bool wavtrim_fp(const char *in, FILE *fin, const char *out, const WTRIM& wtrim,
+                std::vector<WavTrimSegment>& segments);
+bool wavtrim(const char *wav_file, const char *out_file, const WTRIM& wtrim);
+
+#endif  // ndef WAVTRIM_HPP_
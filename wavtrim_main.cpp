@@ -0,0 +1,145 @@
+#include "PcmWave.hpp"
+#include "wavtrim.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static void show_help(void)
+{
+    printf("wavtrim --- Trims the silence of a wave file, or splits it at silences\n");
+    printf("Usage: wavtrim [options] sound-file.wav [output.wav]\n");
+    printf("Use '-' for stdin/stdout. Without output.wav, lists the segments of sound\n");
+    printf("(start, end and length in seconds).\n");
+    printf("Options:\n");
+    printf("--help              Show this help.\n");
+    printf("--version           Show version info.\n");
+    printf("--threshold DB      Level in dBFS where sound starts (default: -50).\n");
+    printf("--hysteresis DB     Sound stops this far below the threshold (default: 6).\n");
+    printf("--detect XXX        'peak' (default) or 'rms' level of each window.\n");
+    printf("--window TIME       Detection window (default: 0.01).\n");
+    printf("--pad TIME          Silence kept before and after sound (default: 0.1).\n");
+    printf("--split             Write each segment to output-NNN.wav.\n");
+    printf("--min-silence TIME  Silence that ends a segment with --split (default: 0.5).\n");
+    printf("TIME is in seconds, or frames with 'f' suffix.\n");
+}
+
+static void show_version(void)
+{
+    printf("wavtrim version 0.1 by katahiromz\n");
+}
+
+int main(int argc, char **argv)
+{
+    pcm_wave_messages() = stderr;    // the library is quiet otherwise
+
+    WTRIM wtrim;
+
+    if (argc <= 1)
+    {
+        show_help();
+        return EXIT_SUCCESS;
+    }
+
+    const char *arg1 = NULL;
+    const char *arg2 = NULL;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (argv[i][0] == '-' && argv[i][1] != 0)
+        {
+            if (strcmp(argv[i], "--help") == 0)
+            {
+                show_help();
+                return EXIT_SUCCESS;
+            }
+            if (strcmp(argv[i], "--version") == 0)
+            {
+                show_version();
+                return EXIT_SUCCESS;
+            }
+            if (strcmp(argv[i], "--split") == 0)
+            {
+                wtrim.split = true;
+                continue;
+            }
+            if (strcmp(argv[i], "--threshold") == 0 || strcmp(argv[i], "--hysteresis") == 0)
+            {
+                if (i + 1 >= argc)
+                {
+                    fprintf(stderr, "ERROR: No parameter for '%s'.\n", argv[i]);
+                    return EXIT_FAILURE;
+                }
+                double& value = (argv[i][2] == 't') ? wtrim.threshold : wtrim.hysteresis;
+                ++i;
+                char *endptr;
+                value = strtod(argv[i], &endptr);
+                if (*endptr != 0 || (&value == &wtrim.hysteresis && value < 0))
+                {
+                    fprintf(stderr, "ERROR: Invalid parameter '%s'.\n", argv[i]);
+                    return EXIT_FAILURE;
+                }
+                continue;
+            }
+            if (strcmp(argv[i], "--detect") == 0)
+            {
+                if (i + 1 >= argc)
+                {
+                    fprintf(stderr, "ERROR: No parameter for '%s'.\n", argv[i]);
+                    return EXIT_FAILURE;
+                }
+                ++i;
+                if (strcmp(argv[i], "peak") == 0)
+                    wtrim.detect = WTRIM_DETECT_PEAK;
+                else if (strcmp(argv[i], "rms") == 0)
+                    wtrim.detect = WTRIM_DETECT_RMS;
+                else
+                {
+                    fprintf(stderr, "ERROR: Invalid parameter '%s'.\n", argv[i]);
+                    return EXIT_FAILURE;
+                }
+                continue;
+            }
+            if (strcmp(argv[i], "--window") == 0 || strcmp(argv[i], "--pad") == 0 ||
+                strcmp(argv[i], "--min-silence") == 0)
+            {
+                if (i + 1 >= argc)
+                {
+                    fprintf(stderr, "ERROR: No parameter for '%s'.\n", argv[i]);
+                    return EXIT_FAILURE;
+                }
+                PcmWaveTime& time = (argv[i][2] == 'w') ? wtrim.window :
+                                    (argv[i][2] == 'p') ? wtrim.pad : wtrim.min_silence;
+                ++i;
+                if (!time.parse(argv[i]))
+                {
+                    fprintf(stderr, "ERROR: Invalid parameter '%s'.\n", argv[i]);
+                    return EXIT_FAILURE;
+                }
+                continue;
+            }
+
+            fprintf(stderr, "ERROR: Invalid argument '%s'.\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+        if (arg1 == NULL)
+        {
+            arg1 = argv[i];
+        }
+        else if (arg2 == NULL)
+        {
+            arg2 = argv[i];
+        }
+        else
+        {
+            fprintf(stderr, "ERROR: Too many argument.\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (arg1 == NULL)
+    {
+        fprintf(stderr, "ERROR: No input file.\n");
+        return EXIT_FAILURE;
+    }
+
+    return wavtrim(arg1, arg2, wtrim) ? EXIT_SUCCESS : EXIT_FAILURE;
+}